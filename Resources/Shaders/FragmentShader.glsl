@@ -19,49 +19,95 @@ layout(location = 0) out vec4 colorResponse;
 
 #define M_PI 3.1415926535897932384626433832795
 
+// Options of the variant, defined after the #version line by ShaderVariants (see ShaderVariantKey) so that
+// each variant only contains the code it runs. The defaults build the PBR variant. NUMBER_LIGHT_USED
+// is the number of three-point lights of the toon modes; PBR shades the lights binned in clusters.
+#ifndef SHADER_MODE
+#define SHADER_MODE GLSL_SHADER_MODE_PBR
+#endif
+#ifndef NUMBER_LIGHT_USED
+#define NUMBER_LIGHT_USED 1
+#endif
+#ifndef TEXTURE_USING
+#define TEXTURE_USING 0
+#endif
+#ifndef NORMAL_MAP_USED
+#define NORMAL_MAP_USED 0
+#endif
+#ifndef SUBSURFACE_SCATTERING
+#define SUBSURFACE_SCATTERING 0
+#endif
+#ifndef REFERENCE_SHADING
+#define REFERENCE_SHADING 0
+#endif
+
+// Uniform blocks shared by every program, mirrored by UniformBlocks.h and identical in VertexShader.glsl
+layout(std140, binding = 0) uniform Frame {
+	mat4 projectionMat;
+	mat4 modelViewMat;
+	mat4 normalMat;
+	mat4 modelViewMatFromLight;
+	mat4 normalMatFromLight;
+	vec4 meshCenterFromLight;
+	vec3 meshCenter;
+	float fov;
+	float aspectRatio;
+	float clusterDepthScale; // The cluster slice of a view space depth d is log(d)*clusterDepthScale+clusterDepthBias
+	float clusterDepthBias;
+	uvec4 clusterCount; // Tiles along X and Y, then slices
+	vec2 viewportSize;
+	vec3 environmentRadiance; // Uniform radiance lighting the PBR mode from every direction
+};
+
 struct LightSource {
 	vec3 color;
 	float intensity;
+	vec3 distanceAttenuation;
 	float coneAngle;
+	vec3 position;
 	float radialAttenuation;
-	vec3 distanceAttenuation;
 };
 
-uniform LightSource keyLight;
-uniform LightSource fillLight;
-uniform LightSource backLight;
+// Every light of the scene, the three-point lights first, in world space
+layout(std430, binding = 0) readonly buffer Lights {
+	LightSource lights[];
+};
 
-struct Material {
+#define KEY_LIGHT 0
+#define FILL_LIGHT 1
+#define BACK_LIGHT 2
+
+// Lights of each cluster of the view frustum, binned by LightClusters: offset and count of its indices
+layout(std430, binding = 1) readonly buffer Clusters {
+	uvec2 clusters[];
+};
+
+layout(std430, binding = 2) readonly buffer ClusterLightIndices {
+	uint clusterLightIndices[];
+};
+
+// Position of every light in view space, transformed once per frame on the CPU rather than per fragment
+layout(std430, binding = 3) readonly buffer LightPositions {
+	vec4 lightPositions[];
+};
+
+layout(std140, binding = 1) uniform MaterialBlock {
+	vec3 albedo;
 	float kd;
-	sampler2D metallicTex;
-	sampler2D roughnessTex;
-	sampler2D albedoTex;
-	sampler2D ambientTex;
-	sampler2D toneTex;
-	sampler2D normalTex;
 	float metallic;
 	float roughness;
-	vec3 albedo;
-};
+} material;
 
-uniform Material material;
+// Texture units of the maps of the material, bound by initTextures
+layout(binding = 1) uniform sampler2D albedoTex;
+layout(binding = 2) uniform sampler2D ormTex; // Ambient occlusion, roughness and metallic in R, G and B
+layout(binding = 3) uniform sampler2D normalTex; // Tangent-space X and Y in R and G
+layout(binding = 4) uniform sampler2D toneTex;
+layout(binding = 5) uniform sampler2D brdfLookupTable; // Split-sum scale and bias in R and G, see BRDFLookupTable.h
 
-uniform int numberLightUsed;
-uniform int shaderMode;
 uniform float zMax;
 uniform float zMin;
-uniform int normalMapUsed;
-uniform int textureUsing;
-uniform float fov;
-uniform float aspectRatio;
-uniform vec3 meshCenter;
-uniform vec4 meshCenterFromLight;
-uniform mat4 modelViewMat;
-uniform mat4 projectionMat;
-uniform mat4 modelViewMatFromLight;
 uniform sampler2D renderedTexture;
-uniform int subsurfaceScattering;
-uniform mat4 normalMatFromLight;
 uniform int windowHeight;
 uniform float windowRatio;
 
@@ -70,15 +116,30 @@ float sssSkinDistance = 0.01;
 in vec3 fPosition; // Shader input, linearly interpolated by default from the previous stage (here the vertex shader)
 in vec3 fNormal;
 in vec2 fTexCoord;
-in vec3 fKeyLightPosition;
-in vec3 fFillLightPosition;
-in vec3 fBackLightPosition;
 in float fDFocal;
 in float fDEye;
 in vec3 fTangent, fBitangent;
 in vec3 fPositionInWorld;
 in vec3 fNormalInWorld;
 
+// Position of a light in view space
+vec3 lightPosition(int index)
+{
+#if REFERENCE_SHADING == 1
+	return (modelViewMat * vec4(lights[index].position, 1.0)).xyz;
+#else
+	return lightPositions[index].xyz;
+#endif
+}
+
+// Cluster of the fragment, see LightClusters
+uint computeClusterIndex()
+{
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / viewportSize * vec2(clusterCount.xy)), clusterCount.xy - 1u);
+	float slice = clamp(floor(log(max(-fPosition.z, 1e-6)) * clusterDepthScale + clusterDepthBias), 0.0, float(clusterCount.z - 1u));
+	return (uint(slice) * clusterCount.y + tile.y) * clusterCount.x + tile.x;
+}
+
 float computeDistanceTraveledByLight()
 {
 	float fovInRad = fov/180.0*M_PI;
@@ -105,27 +166,89 @@ vec3 computeEnergyFromSubsurfaceScattering(float distance)
 	return vec3(energy);
 }
 
-vec3 computeLiFromLight(LightSource lightSource, vec3 fLightPosition, vec3 n){
+// Terms of the BRDF that only depend on the fragment, computed once for all its lights
+struct Surface {
+	vec3 n;
+	vec3 wo;
+	float NdotV;
+	float F0; // The metallic value is used as the reflectance at normal incidence
+	float alpha2; // Roughness is the GGX alpha
+	float visibilityV; // Factor of the Smith visibility term depending on the view direction
+	float ambient;
+#if SUBSURFACE_SCATTERING != 0
+	vec3 energyFromSSS; // The depth map is read once, whatever the number of lights
+#endif
+};
+
+// metallic, roughness and ambient come from fetchOcclusionRoughnessMetallic, sampled once for all the lights
+Surface computeSurface(vec3 n, float metallic, float roughness, float ambient)
+{
+	Surface surface;
+	surface.n = n;
+	surface.wo = normalize(-fPosition);
+	surface.NdotV = max(dot(n, surface.wo), 1e-4);
+	surface.F0 = metallic;
+	surface.alpha2 = roughness*roughness;
+	surface.visibilityV = 1.0/(surface.NdotV + sqrt(surface.alpha2 + (1.0-surface.alpha2)*surface.NdotV*surface.NdotV));
+	surface.ambient = ambient;
+#if SUBSURFACE_SCATTERING != 0
+	surface.energyFromSSS = computeEnergyFromSubsurfaceScattering(computeDistanceTraveledByLight());
+#endif
+	return surface;
+}
+
+// Same BRDF as the reference below, with a single channel of roughness and metallic: the Smith term
+// G1(wi)*G1(wo)/(4*NdotL*NdotV) is folded into two visibility factors, without any division by the cosines.
+// Only the members of the light in use are read from the storage buffer.
+vec3 computeLiFromLight(uint index, Surface surface){
+	vec3 toLight = lightPositions[index].xyz - fPosition;
+	float d = length(toLight);
+	vec3 wi = toLight/d;
+	vec3 wh = normalize(wi+surface.wo);
+	float NdotL = dot(surface.n,wi);
+#if SUBSURFACE_SCATTERING == 0 // Subsurface scattering also lights the back of the surface
+	if (NdotL <= 0.0)
+		return vec3(0.0);
+#endif
+	float cosL = max(NdotL,0.0);
+	float NdotH = dot(surface.n,wh);
+
+	float x = 1.0-max(0.0,dot(wi,wh));
+	float x2 = x*x;
+	float F = surface.F0 + (1.0-surface.F0)*x2*x2*x;
+	float k = 1.0 + (surface.alpha2-1.0)*NdotH*NdotH;
+	float D = surface.alpha2/(M_PI*k*k);
+	float visibilityL = 1.0/(cosL + sqrt(surface.alpha2 + (1.0-surface.alpha2)*cosL*cosL));
+	float fs = D*F*visibilityL*surface.visibilityV;
+	float fd = material.kd/M_PI;
+
+	vec3 Li = lights[index].color * (lights[index].intensity * (fs+fd) * cosL);
+	vec3 distanceAttenuation = lights[index].distanceAttenuation;
+	float att = 1.0/(distanceAttenuation[0]+distanceAttenuation[1]*d+distanceAttenuation[2]*d*d);
+
+#if SUBSURFACE_SCATTERING != 0
+	vec3 contributionFromSSS = abs(NdotL)*surface.energyFromSSS;
+
+#if SUBSURFACE_SCATTERING == 1
+	Li = Li + contributionFromSSS;
+#else
+	Li = contributionFromSSS;
+#endif
+#endif
+
+	return Li*(att*surface.ambient);
+}
+
+#if REFERENCE_SHADING == 1
+// Reference evaluation of the BRDF, every term computed per channel and per light, kept with the light
+// transform of lightPosition to check and benchmark the fast path against them (see --benchmark-brdf in Main.cpp)
+vec3 computeLiFromLightReference(LightSource lightSource, vec3 fLightPosition, vec3 n, vec3 metallic, vec3 roughness, float ambient){
 	vec3 wi = normalize(fLightPosition - fPosition);
 	vec3 wo = normalize(-fPosition);
 	vec3 wh = normalize(wi+wo);
 
 	vec3 fd = vec3(material.kd/M_PI);
 
-	vec3 metallic;
-	vec3 roughness;
-	if(textureUsing ==1)
-	{
-		metallic = texture(material.metallicTex,fTexCoord).xyz;
-		roughness = texture(material.roughnessTex,fTexCoord).xyz;
-	} 
-	else 
-	{
-		metallic = vec3(material.metallic);
-		roughness = vec3(material.roughness);
-	}
-	
-	float ambient = texture(material.ambientTex,fTexCoord).r;
 	vec3 F = vec3(metallic.r + (1-metallic.r)*pow(1-max(0,dot(wi,wh)),5), metallic.g + (1-metallic.g)*pow(1-max(0,dot(wi,wh)),5), metallic.b + (1-metallic.b)*pow(1-max(0,dot(wi,wh)),5));
 	vec3 D = vec3(pow(roughness.r,2)/(M_PI*pow((1+(pow(roughness.r,2)-1)*pow(dot(n,wh),2)),2)),pow(roughness.g,2)/(M_PI*pow((1+(pow(roughness.g,2)-1)*pow(dot(n,wh),2)),2)),pow(roughness.b,2)/(M_PI*pow((1+(pow(roughness.b,2)-1)*pow(dot(n,wh),2)),2)));
 	vec3 Gi = vec3(2*dot(n,wi)/(dot(n,wi)+sqrt(pow(roughness.r,2)+(1-pow(roughness.r,2))*pow(dot(n,wi),2))), 2*dot(n,wi)/(dot(n,wi)+sqrt(pow(roughness.g,2)+(1-pow(roughness.g,2))*pow(dot(n,wi),2))), 2*dot(n,wi)/(dot(n,wi)+sqrt(pow(roughness.b,2)+(1-pow(roughness.b,2))*pow(dot(n,wi),2))));
@@ -138,26 +261,41 @@ vec3 computeLiFromLight(LightSource lightSource, vec3 fLightPosition, vec3 n){
 	float d = distance(fLightPosition, fPosition);
 	float att = 1/(lightSource.distanceAttenuation[0]+lightSource.distanceAttenuation[1]*d+lightSource.distanceAttenuation[2]*pow(d,2));
 
+#if SUBSURFACE_SCATTERING != 0 // The depth map is only read by the variants using it
 	float distanceTraveled = computeDistanceTraveledByLight();
 	vec3 contributionFromSSS =  vec3(abs(dot(n,wi))*computeEnergyFromSubsurfaceScattering(distanceTraveled));
 
-	if (subsurfaceScattering == 1)
-	{
-		Li = Li + contributionFromSSS;
-	}
-	else if (subsurfaceScattering == 2)
-	{
-		Li = contributionFromSSS;
-	}
+#if SUBSURFACE_SCATTERING == 1
+	Li = Li + contributionFromSSS;
+#else
+	Li = contributionFromSSS;
+#endif
+#endif
 
-	if(textureUsing==1)
-	{
-		return Li*att*ambient;
-	} 
-	else 
-	{
-		return Li*att;
-	}
+	return Li*att*ambient;
+}
+#endif
+
+// Single fetch of the packed occlusion, roughness and metallic maps, or the untextured material values
+void fetchOcclusionRoughnessMetallic(out float metallic, out float roughness, out float ambient)
+{
+#if TEXTURE_USING == 1
+	vec3 orm = texture(ormTex,fTexCoord).rgb;
+	ambient = orm.r;
+	roughness = orm.g;
+	metallic = orm.b;
+#else
+	ambient = 1.0;
+	roughness = material.roughness;
+	metallic = material.metallic;
+#endif
+}
+
+// Tangent-space normal from its two stored components, Z being positive in tangent space
+vec3 fetchNormalMap()
+{
+	vec2 xy = texture(normalTex,fTexCoord).rg*2.0-1.0;
+	return vec3(xy, sqrt(max(1.0-dot(xy,xy),0.0)));
 }
 
 bool criteriaSpecular(vec3 wi, vec3 wo,vec3 n, float limit)
@@ -172,24 +310,20 @@ bool criteriaSpecular(vec3 wi, vec3 wo,vec3 n, float limit)
 
 vec3 computeNPR(vec3 n,vec3 fr)
 {
-	vec3 wiKey = normalize(fKeyLightPosition - fPosition);
-	vec3 wiFill = normalize(fFillLightPosition - fPosition);
-	vec3 wiBack = normalize(fBackLightPosition - fPosition);
+	vec3 wiKey = normalize(lightPosition(KEY_LIGHT) - fPosition);
+	vec3 wiFill = normalize(lightPosition(FILL_LIGHT) - fPosition);
+	vec3 wiBack = normalize(lightPosition(BACK_LIGHT) - fPosition);
 	vec3 wo = normalize(-fPosition);
 	bool criteria;
 	float limit = 0.8;
 
-	if(numberLightUsed==1)
-	{
-		criteria = criteriaSpecular(wiKey,wo,n,limit);
-	} else if (numberLightUsed==2)
-	{
-		criteria = criteriaSpecular(wiFill,wo,n,limit)||criteriaSpecular(wiKey,wo,n,limit);
-	} 
-	else 
-	{
-		criteria = criteriaSpecular(wiKey,wo,n,limit)||criteriaSpecular(wiFill,wo,n,limit)||criteriaSpecular(wiBack,wo,n,limit);
-	}
+#if NUMBER_LIGHT_USED == 1
+	criteria = criteriaSpecular(wiKey,wo,n,limit);
+#elif NUMBER_LIGHT_USED == 2
+	criteria = criteriaSpecular(wiFill,wo,n,limit)||criteriaSpecular(wiKey,wo,n,limit);
+#else
+	criteria = criteriaSpecular(wiKey,wo,n,limit)||criteriaSpecular(wiFill,wo,n,limit)||criteriaSpecular(wiBack,wo,n,limit);
+#endif
 	if(abs(n[2])<0.4)
 	{
 		return vec3(0,0,0);
@@ -208,105 +342,80 @@ float computeOrientationCriteria(vec3 n, vec3 wi, vec3 wo)
 vec3 computeOrientationTone(vec3 n, vec3 wi, vec3 wo)
 {
 	float D = computeOrientationCriteria(n, wi, wo);
-	return texture(material.toneTex,vec2(max(dot(n,wi),0)/3,D)).rgb;
+	return texture(toneTex,vec2(max(dot(n,wi),0)/3,D)).rgb;
 }
 
 void main() 
 {
 	vec3 fr ;
-	if (shaderMode == GLSL_SHADER_MODE_PBR)
-	{
-		if(textureUsing == 1)
-		{
-			fr = texture(material.albedoTex,fTexCoord).rgb;
-		} 
-		else 
-		{
-			fr = material.albedo;
-		}
-	} 
-	else if (shaderMode == 1) 
-	{
-		fr = vec3(0.1,0.6,0.3);
-	}
+#if SHADER_MODE == GLSL_SHADER_MODE_PBR
+#if TEXTURE_USING == 1
+	fr = texture(albedoTex,fTexCoord).rgb;
+#else
+	fr = material.albedo;
+#endif
+#elif SHADER_MODE == GLSL_SHADER_BASIC_TOON
+	fr = vec3(0.1,0.6,0.3);
+#endif
 
-	vec3 normalMap = normalize(texture(material.normalTex, fTexCoord).rgb);
 	vec3 tangent = normalize(fTangent);
 	vec3 bitangent = normalize(fBitangent);
 	vec3 n = normalize(fNormal);
 
-	if(normalMapUsed==1)
-	{
-		n = normalize(mat3(tangent,bitangent,n)*normalMap);
-	}
-
-	if(shaderMode == GLSL_SHADER_MODE_PBR)
-	{
-		vec3 LiKey = computeLiFromLight(keyLight, fKeyLightPosition, n);
-		vec3 radiance =  fr;
-		if(numberLightUsed == 1){
-			radiance = radiance * LiKey;
-		} else if (numberLightUsed == 2){
-			vec3 LiFill = computeLiFromLight(fillLight, fFillLightPosition,n);
-			radiance = radiance * (LiKey + LiFill);
-		} else if (numberLightUsed == 3){
-			vec3 LiFill = computeLiFromLight(fillLight, fFillLightPosition,n);
-			vec3 LiBack = computeLiFromLight(backLight, fBackLightPosition,n);
-			radiance = radiance * (LiKey+LiFill+LiBack) ;
-		}
-	    colorResponse = vec4 (radiance, 1.0); // Building an RGBA value from an RGB one.
-	} 
-	else if (shaderMode == GLSL_SHADER_BASIC_TOON)
-	{
-			colorResponse = vec4(computeNPR(n,fr),1.0);
-	} 
-	else if (shaderMode == GLSL_SHADER_DEPTH_X_TOON)
-	{
-		vec3 wiKey = normalize(fKeyLightPosition - fPosition);
-		vec3 wiFill = normalize(fFillLightPosition - fPosition);
-		vec3 wiBack = normalize(fBackLightPosition - fPosition);
-		colorResponse = vec4(texture(material.toneTex,vec2(max(dot(n,wiKey)/3, 0.0),clamp(fDFocal,0.1,0.9))).rgb,1.0);
-	} 
-	else if (shaderMode == GLSL_SHADER_PERSEPECTIVE_X_TOON)
-	{
-		vec3 wiKey = normalize(fKeyLightPosition - fPosition);
-		vec3 wiFill = normalize(fFillLightPosition - fPosition);
-		vec3 wiBack = normalize(fBackLightPosition - fPosition);
-		colorResponse = vec4(texture(material.toneTex,vec2(max(dot(n,wiKey)/3,0.0),clamp(fDEye,0.1,0.9))).rgb,1.0);
-	} 
-	else if (shaderMode == GLSL_SHADER_ORIENTATION)
+#if NORMAL_MAP_USED == 1
+	n = normalize(mat3(tangent,bitangent,n)*fetchNormalMap());
+#endif
+
+#if SHADER_MODE == GLSL_SHADER_MODE_PBR
+	float metallic, roughness, ambient;
+	fetchOcclusionRoughnessMetallic(metallic, roughness, ambient);
+	Surface surface = computeSurface(n, metallic, roughness, ambient);
+	// Only the lights reaching the cluster of the fragment, among the three-point lights in use and the additional ones
+	vec3 Li = vec3(0.0);
+	uvec2 cluster = clusters[computeClusterIndex()];
+	for (uint i = cluster.x; i < cluster.x + cluster.y; i++)
 	{
-		vec3 wiKey = normalize(fKeyLightPosition - fPosition);
-		vec3 wiFill = normalize(fFillLightPosition - fPosition);
-		vec3 wiBack = normalize(fBackLightPosition - fPosition);
-		vec3 wo = normalize(-fPosition);
-		if(numberLightUsed == 1)
-		{
-			vec3 tone = computeOrientationTone(n,wiKey,wo);
-			colorResponse = vec4(tone,1.0);
-		} 
-		else if (numberLightUsed == 2)
-		{
-			float intensityTot = keyLight.intensity+fillLight.intensity;
-			vec3 tone = (keyLight.intensity*computeOrientationTone(n,wiKey,wo) + fillLight.intensity*computeOrientationTone(n,wiFill,wo))/intensityTot;
-			colorResponse = vec4(tone,1.0);
-		} 
-		else if (numberLightUsed == 3)
-		{
-			float intensityTot = keyLight.intensity+fillLight.intensity+backLight.intensity;
-			vec3 tone = (keyLight.intensity*computeOrientationTone(n,wiKey,wo) + fillLight.intensity*computeOrientationTone(n,wiFill,wo)+ backLight.intensity*computeOrientationTone(n,wiBack,wo))/intensityTot;
-			colorResponse = vec4(tone,1.0);
-		}
+		uint index = clusterLightIndices[i];
+#if REFERENCE_SHADING == 1
+		Li += computeLiFromLightReference(lights[index], lightPosition(int(index)), n, vec3(metallic), vec3(roughness), ambient);
+#else
+		Li += computeLiFromLight(index, surface);
+#endif
 	}
-	else if (shaderMode == GLSL_SHADER_DEPTH_MAPPING)
-	{
-		float distanceToLight = abs(length((modelViewMatFromLight * vec4(fPositionInWorld, 1.0)).xyz));
-		float distanceToCenter = abs(length((modelViewMatFromLight * vec4(meshCenter, 1.0)).xyz));
+	// Uniform environment: diffuse albedo kd, and the specular albedo F0*scale+bias from the split-sum table
+	vec2 brdfScaleBias = texture(brdfLookupTable, vec2(surface.NdotV, roughness)).rg;
+	Li += environmentRadiance * (ambient * (material.kd + metallic*brdfScaleBias.x + brdfScaleBias.y));
+	vec3 radiance = fr * Li;
+	colorResponse = vec4 (radiance, 1.0); // Building an RGBA value from an RGB one.
+#elif SHADER_MODE == GLSL_SHADER_BASIC_TOON
+	colorResponse = vec4(computeNPR(n,fr),1.0);
+#elif SHADER_MODE == GLSL_SHADER_DEPTH_X_TOON
+	vec3 wiKey = normalize(lightPosition(KEY_LIGHT) - fPosition);
+	colorResponse = vec4(texture(toneTex,vec2(max(dot(n,wiKey)/3, 0.0),clamp(fDFocal,0.1,0.9))).rgb,1.0);
+#elif SHADER_MODE == GLSL_SHADER_PERSEPECTIVE_X_TOON
+	vec3 wiKey = normalize(lightPosition(KEY_LIGHT) - fPosition);
+	colorResponse = vec4(texture(toneTex,vec2(max(dot(n,wiKey)/3,0.0),clamp(fDEye,0.1,0.9))).rgb,1.0);
+#elif SHADER_MODE == GLSL_SHADER_ORIENTATION
+	vec3 wiKey = normalize(lightPosition(KEY_LIGHT) - fPosition);
+	vec3 wiFill = normalize(lightPosition(FILL_LIGHT) - fPosition);
+	vec3 wiBack = normalize(lightPosition(BACK_LIGHT) - fPosition);
+	vec3 wo = normalize(-fPosition);
+#if NUMBER_LIGHT_USED == 1
+	vec3 tone = computeOrientationTone(n,wiKey,wo);
+#elif NUMBER_LIGHT_USED == 2
+	float intensityTot = lights[KEY_LIGHT].intensity+lights[FILL_LIGHT].intensity;
+	vec3 tone = (lights[KEY_LIGHT].intensity*computeOrientationTone(n,wiKey,wo) + lights[FILL_LIGHT].intensity*computeOrientationTone(n,wiFill,wo))/intensityTot;
+#else
+	float intensityTot = lights[KEY_LIGHT].intensity+lights[FILL_LIGHT].intensity+lights[BACK_LIGHT].intensity;
+	vec3 tone = (lights[KEY_LIGHT].intensity*computeOrientationTone(n,wiKey,wo) + lights[FILL_LIGHT].intensity*computeOrientationTone(n,wiFill,wo)+ lights[BACK_LIGHT].intensity*computeOrientationTone(n,wiBack,wo))/intensityTot;
+#endif
+	colorResponse = vec4(tone,1.0);
+#elif SHADER_MODE == GLSL_SHADER_DEPTH_MAPPING
+	float distanceToLight = abs(length((modelViewMatFromLight * vec4(fPositionInWorld, 1.0)).xyz));
+	float distanceToCenter = abs(length((modelViewMatFromLight * vec4(meshCenter, 1.0)).xyz));
 
-		colorResponse = vec4((distanceToLight-distanceToCenter/2.0)/distanceToCenter);
-	}
-	else if (shaderMode == GLSL_SHADER_DISTANCE_TRAVELED)
-	{
-		colorResponse = vec4(computeDistanceTraveledByLight());
-	}
-}
+	colorResponse = vec4((distanceToLight-distanceToCenter/2.0)/distanceToCenter);
+#elif SHADER_MODE == GLSL_SHADER_DISTANCE_TRAVELED
+	colorResponse = vec4(computeDistanceTraveledByLight());
+#endif
+}
\ No newline at end of file
@@ -6,16 +6,29 @@ layout(location=2) in vec2 vTexCoord;
 layout(location=3) in vec3 vTangent;
 layout(location=4) in vec3 vBitangent;
 
-uniform mat4 projectionMat, modelViewMat, normalMat;
-uniform vec3 keyLightPosition, fillLightPosition, backLightPosition;
+// Uniform blocks shared by every program, mirrored by UniformBlocks.h and identical in FragmentShader.glsl
+layout(std140, binding = 0) uniform Frame {
+	mat4 projectionMat;
+	mat4 modelViewMat;
+	mat4 normalMat;
+	mat4 modelViewMatFromLight;
+	mat4 normalMatFromLight;
+	vec4 meshCenterFromLight;
+	vec3 meshCenter;
+	float fov;
+	float aspectRatio;
+	float clusterDepthScale; // The cluster slice of a view space depth d is log(d)*clusterDepthScale+clusterDepthBias
+	float clusterDepthBias;
+	uvec4 clusterCount; // Tiles along X and Y, then slices
+	vec2 viewportSize;
+	vec3 environmentRadiance; // Uniform radiance lighting the PBR mode from every direction
+};
+
 uniform float zMin, r, zFocus;
 
 out vec3 fPosition;
 out vec3 fNormal;
 out vec2 fTexCoord;
-out vec3 fKeyLightPosition;
-out vec3 fFillLightPosition;
-out vec3 fBackLightPosition;
 out float fDFocal;
 out float fDEye;
 out vec3 fTangent, fBitangent;
@@ -34,9 +47,6 @@ void main() {
 	fBitangent = (normalMat* vec4(normalize(cross(fNormal,fTangent)),0.0)).xyz;
     fPosition = p.xyz;
     fTexCoord = vec2(3.0*vTexCoord.x, 3.0*vTexCoord.y);
-	fKeyLightPosition = vec3(modelViewMat * vec4(keyLightPosition,1));
-	fFillLightPosition = vec3(modelViewMat * vec4(fillLightPosition,1));
-	fBackLightPosition = vec3(modelViewMat * vec4(backLightPosition,1));
 	fDFocal = clamp(1 - log(p.z/zMin)/log(r),0.0,1.0);
 	fPositionInWorld = vPosition;
 	fNormalInWorld = vNormal;
@@ -0,0 +1,45 @@
+#include "AsyncMeshLoader.h"
+#include "MeshLoader.h"
+#include "Profiler.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+AsyncMeshLoader::AsyncMeshLoader (const std::string & filename)
+	: m_filename (filename), m_meshPtr (std::make_shared<GLMesh> ()), m_progress (0.f), m_ready (false)
+{
+	// Started last: every member the worker touches is constructed at this point
+	m_thread = std::thread ([this] () {
+		Profiler::setThreadName ("Mesh loader");
+		try
+		{
+			MeshLoader::setProgressCallback ([this] (float fraction) { m_progress.store (fraction, std::memory_order_relaxed); });
+			MeshLoader::loadCached (m_filename, m_meshPtr);
+		}
+		catch (...)
+		{
+			m_error = std::current_exception ();
+		}
+		MeshLoader::setProgressCallback (nullptr);
+		m_progress.store (1.f, std::memory_order_relaxed);
+		m_ready.store (true, std::memory_order_release);
+	});
+}
+
+AsyncMeshLoader::~AsyncMeshLoader ()
+{
+	if (m_thread.joinable ())
+		m_thread.join ();
+}
+
+std::shared_ptr<GLMesh> AsyncMeshLoader::takeMesh ()
+{
+	if (!isReady ())
+		throw std::runtime_error ("[Async Mesh Loader][takeMesh] Loading of " + m_filename + " is not finished");
+	if (m_thread.joinable ())
+		m_thread.join ();
+	if (m_error)
+		std::rethrow_exception (m_error);
+	return std::move (m_meshPtr);
+}
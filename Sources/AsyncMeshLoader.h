@@ -0,0 +1,46 @@
+#ifndef ASYNC_MESH_LOADER_H
+#define ASYNC_MESH_LOADER_H
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <exception>
+
+#include "GLMesh.h"
+
+/// Loads a mesh (see MeshLoader::loadCached) on a worker thread. The worker only fills the
+/// CPU-side attributes of a new GLMesh: the GPU upload stays on the thread owning the GL context,
+/// which keeps rendering the current mesh in the meantime.
+class AsyncMeshLoader {
+public:
+	/// Starts loading filename in the background
+	AsyncMeshLoader (const std::string & filename);
+
+	/// Waits for the worker, the result is discarded if it was not taken
+	virtual ~AsyncMeshLoader ();
+
+	AsyncMeshLoader (const AsyncMeshLoader &) = delete;
+	AsyncMeshLoader & operator= (const AsyncMeshLoader &) = delete;
+
+	inline const std::string & filename () const { return m_filename; }
+
+	/// Progress of the load, from 0 to 1, as reported by the loader
+	inline float progress () const { return m_progress.load (std::memory_order_relaxed); }
+
+	/// True once the worker is done, successfully or not
+	inline bool isReady () const { return m_ready.load (std::memory_order_acquire); }
+
+	/// Returns the loaded mesh, ready to upload, or rethrows the error of the load. Only valid once isReady.
+	std::shared_ptr<GLMesh> takeMesh ();
+
+private:
+	std::string m_filename;
+	std::shared_ptr<GLMesh> m_meshPtr;
+	std::exception_ptr m_error;
+	std::atomic<float> m_progress;
+	std::atomic<bool> m_ready;
+	std::thread m_thread;
+};
+
+#endif // ASYNC_MESH_LOADER_H
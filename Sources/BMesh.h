@@ -0,0 +1,34 @@
+#ifndef BMESH_H
+#define BMESH_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Layout of the binary mesh cache (.bmesh) written and read by MeshLoader::saveBMesh/loadBMesh.
+
+// Bump whenever the layout below or the attribute computation in Mesh changes
+const uint32_t BMESH_VERSION = 1;
+const uint32_t BMESH_BYTE_ORDER = 0x01020304;
+const size_t BMESH_ALIGNMENT = 16;
+
+// The texture coordinates were read from the source file rather than computed (see Mesh::hasTexCoords)
+const uint32_t BMESH_FLAG_FILE_TEXCOORDS = 1;
+
+enum BMeshArray { BMESH_POSITIONS = 0, BMESH_NORMALS, BMESH_TEXCOORDS, BMESH_TANGENTS, BMESH_BITANGENTS, BMESH_INDICES, BMESH_ARRAY_COUNT };
+
+/// File header. Every array starts at an aligned offset and is tightly packed, exactly as
+/// glNamedBufferSubData expects it.
+struct BMeshHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t numVertices;
+	uint32_t numTriangles;
+	uint32_t flags;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t sourceHash;
+	uint64_t offsets[BMESH_ARRAY_COUNT];
+};
+
+#endif // BMESH_H
@@ -0,0 +1,150 @@
+#include "BRDFLookupTable.h"
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <ios>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+const char LOOKUP_TABLE_MAGIC[8] = { 'B', 'R', 'D', 'F', 'L', 'U', 'T', '1' };
+
+struct LookupTableHeader {
+	char magic[8];
+	uint32_t size;
+	uint32_t numSamples;
+};
+
+/// i-th point of the Hammersley set of n points
+glm::vec2 hammersley (uint32_t i, uint32_t n)
+{
+	uint32_t bits = i;
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return glm::vec2 (float (i) / float (n), float (bits) * 2.3283064365386963e-10f);
+}
+
+/// Half vector distributed as the GGX normal distribution times its cosine, around +Z
+glm::vec3 sampleGGX (const glm::vec2 & xi, float alpha)
+{
+	float phi = 2.f * float (M_PI) * xi.x;
+	float cosTheta = std::sqrt ((1.f - xi.y) / (1.f + (alpha * alpha - 1.f) * xi.y));
+	float sinTheta = std::sqrt (1.f - cosTheta * cosTheta);
+	return glm::vec3 (sinTheta * std::cos (phi), sinTheta * std::sin (phi), cosTheta);
+}
+
+/// Smith masking of one direction, as computed by the shader
+float smithG1 (float cosine, float alpha)
+{
+	return 2.f * cosine / (cosine + std::sqrt (alpha * alpha + (1.f - alpha * alpha) * cosine * cosine));
+}
+
+glm::vec2 integrate (float NdotV, float alpha, unsigned int numSamples)
+{
+	glm::vec3 v (std::sqrt (1.f - NdotV * NdotV), 0.f, NdotV);
+	glm::vec2 sum (0.f);
+	for (unsigned int i = 0; i < numSamples; i++)
+	{
+		glm::vec3 h = sampleGGX (hammersley (i, numSamples), alpha);
+		float VdotH = glm::dot (v, h);
+		glm::vec3 l = 2.f * VdotH * h - v;
+		if (l.z <= 0.f || VdotH <= 0.f)
+			continue;
+		// BRDF times cosine over the sampling density, the Fresnel term split in F0 * (1 - Fc) + Fc
+		float visibility = smithG1 (l.z, alpha) * smithG1 (NdotV, alpha) * VdotH / (h.z * NdotV);
+		float x = 1.f - VdotH;
+		float fc = x * x * x * x * x;
+		sum += glm::vec2 ((1.f - fc) * visibility, fc * visibility);
+	}
+	return sum / float (numSamples);
+}
+
+}
+
+namespace BRDFLookupTable {
+
+std::vector<glm::vec2> compute (unsigned int size, unsigned int numSamples)
+{
+	std::vector<glm::vec2> table (size_t (size) * size);
+	unsigned int numThreads = std::max (1u, std::thread::hardware_concurrency ());
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < numThreads; t++)
+		threads.emplace_back ([&, t] () {
+			for (unsigned int y = t; y < size; y += numThreads)
+				for (unsigned int x = 0; x < size; x++)
+					table[size_t (y) * size + x] = integrate ((x + 0.5f) / size, (y + 0.5f) / size, numSamples);
+		});
+	for (std::thread & thread : threads)
+		thread.join ();
+	return table;
+}
+
+std::vector<glm::vec2> load (const std::string & cacheDirectory, unsigned int size, unsigned int numSamples)
+{
+	auto start = std::chrono::high_resolution_clock::now ();
+	std::string filename = cacheDirectory + "/BRDFLookupTable.bin";
+	std::vector<glm::vec2> table (size_t (size) * size);
+	{
+		std::ifstream input (filename.c_str (), std::ios::binary);
+		LookupTableHeader header;
+		if (input && input.read (reinterpret_cast<char *> (&header), sizeof (header))
+			&& std::memcmp (header.magic, LOOKUP_TABLE_MAGIC, sizeof (header.magic)) == 0
+			&& header.size == size && header.numSamples == numSamples
+			&& input.read (reinterpret_cast<char *> (table.data ()), table.size () * sizeof (glm::vec2)))
+		{
+			double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+			std::cout << " > BRDF lookup table loaded from its cache in " << seconds * 1000.0 << " ms" << std::endl;
+			return table;
+		}
+	}
+
+	table = compute (size, numSamples);
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	std::cout << " > BRDF lookup table computed in " << seconds * 1000.0 << " ms" << std::endl;
+
+	// Written to a temporary file first so that an interrupted write never leaves a truncated table
+	try
+	{
+		std::error_code ec;
+		std::filesystem::create_directories (cacheDirectory, ec);
+		std::string tmpFilename = filename + ".tmp";
+		{
+			LookupTableHeader header;
+			std::memcpy (header.magic, LOOKUP_TABLE_MAGIC, sizeof (header.magic));
+			header.size = size;
+			header.numSamples = numSamples;
+			std::ofstream out (tmpFilename.c_str (), std::ios::binary | std::ios::trunc);
+			if (!out)
+				throw std::ios_base::failure ("[BRDF Lookup Table][load] Cannot open " + tmpFilename);
+			out.write (reinterpret_cast<const char *> (&header), sizeof (header));
+			out.write (reinterpret_cast<const char *> (table.data ()), table.size () * sizeof (glm::vec2));
+			if (!out)
+				throw std::ios_base::failure ("[BRDF Lookup Table][load] Cannot write " + tmpFilename);
+		}
+		std::filesystem::rename (tmpFilename, filename, ec);
+		if (ec)
+		{
+			std::filesystem::remove (tmpFilename, ec);
+			throw std::ios_base::failure ("[BRDF Lookup Table][load] Cannot write " + filename);
+		}
+	}
+	catch (std::exception & e) // Computed again next time
+	{
+		std::cerr << "> [Error caching BRDF lookup table]" << e.what () << std::endl;
+	}
+	return table;
+}
+
+}
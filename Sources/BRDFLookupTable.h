@@ -0,0 +1,24 @@
+#ifndef BRDF_LOOKUP_TABLE_H
+#define BRDF_LOOKUP_TABLE_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/// Split-sum table of the GGX specular BRDF of FragmentShader.glsl: for a cosine NdotV between the
+/// normal and the view direction and a roughness, both in [0, 1], the integral over the hemisphere
+/// of the BRDF times the cosine of the incident direction, lit by a uniform unit radiance, is
+/// F0 * scale + bias. The table holds (scale, bias) row by row, NdotV along X and roughness along
+/// Y, sampled at texel centers. Roughness is the GGX alpha, as in the shader.
+namespace BRDFLookupTable {
+
+/// Integrates the table by importance sampling the GGX distribution, the rows in parallel
+std::vector<glm::vec2> compute (unsigned int size, unsigned int numSamples);
+
+/// Reads the table from cacheDirectory, or computes it and writes it there
+std::vector<glm::vec2> load (const std::string & cacheDirectory, unsigned int size = 128, unsigned int numSamples = 1024);
+
+}
+
+#endif // BRDF_LOOKUP_TABLE_H
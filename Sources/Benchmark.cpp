@@ -0,0 +1,433 @@
+// Micro-benchmarks of the geometry processing of Mesh, on the bundled models and on synthetic spheres
+// of growing size: each operation runs on a fresh copy of the mesh, and its time per vertex and the
+// peak resident memory are written as JSON, to compare the numbers of two builds or two commits.
+
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <ios>
+#include <filesystem>
+#include <limits>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif !defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "CommandLine.h"
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Geometry operation to time, with the parameter it is run with
+struct Operation {
+	enum Type { NORMALS, LAPLACIAN, SIMPLIFY, ADAPTIVE_SIMPLIFY, SUBDIVIDE, BOUNDING_SPHERE } type;
+	const char * name;
+	float parameter;
+	size_t maxVertices; // Larger meshes are skipped, 0 for no limit
+};
+
+// adaptiveSimplify tests every vertex against every octree leaf: quadratic, hence its limit
+const Operation OPERATIONS[] = {
+	{ Operation::NORMALS, "recomputePerVertexNormals", 0.f, 0 },
+	{ Operation::LAPLACIAN, "laplacianFilter", 0.5f, 0 },
+	{ Operation::SIMPLIFY, "simplify", 64.f, 0 },
+	{ Operation::ADAPTIVE_SIMPLIFY, "adaptiveSimplify", 16.f, 50000 },
+	{ Operation::SUBDIVIDE, "subdivide", 0.f, 0 },
+	{ Operation::BOUNDING_SPHERE, "computeBoundingSphere", 0.f, 0 }
+};
+
+const size_t SPHERE_TRIANGLES[] = { 10000, 100000, 1000000, 10000000 };
+
+struct BenchmarkMesh {
+	std::string name;
+	std::string source; // "model" or "sphere"
+	size_t numVertices;
+	size_t numTriangles;
+	double loadMilliseconds; // Loading or generation
+};
+
+struct Result {
+	const Operation * operation;
+	bool skipped = false;
+	std::vector<double> nanoseconds; // One per repetition
+	uint64_t rssBeforeBytes = 0;
+	uint64_t peakRSSBytes = 0;
+};
+
+void usage (const char * command)
+{
+	std::cerr << "Usage : " << command << " [--models <directory>] [--max-triangles <n>] [--repetitions <n>] [--no-limits] <results.json>" << std::endl
+			  << "  Times the geometry operations of Mesh on every model of <directory> (Resources/Models by default)" << std::endl
+			  << "  and on UV spheres of 10k, 100k, 1M and 10M triangles, the ones above --max-triangles being left out." << std::endl
+			  << "  Each operation runs <n> times (3 by default) on a fresh copy of the mesh; the median and the best time" << std::endl
+			  << "  per vertex, and the peak resident memory, are written to <results.json>." << std::endl
+			  << "  adaptiveSimplify is quadratic and skipped above 50k vertices, unless --no-limits." << std::endl;
+	std::exit (EXIT_FAILURE);
+}
+
+#if defined(__linux__)
+/// Value of a field of /proc/self/status, in bytes
+uint64_t readProcStatus (const std::string & field)
+{
+	std::ifstream status ("/proc/self/status");
+	std::string line;
+	while (std::getline (status, line))
+		if (line.compare (0, field.size (), field) == 0 && line.size () > field.size () && line[field.size ()] == ':')
+			return std::stoull (line.substr (field.size () + 1)) * 1024; // kB
+	return 0;
+}
+#endif
+
+/// Resident memory of the process, in bytes
+uint64_t currentRSS ()
+{
+#if defined(__linux__)
+	return readProcStatus ("VmRSS");
+#elif defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo (GetCurrentProcess (), &counters, sizeof (counters)) ? counters.WorkingSetSize : 0;
+#else
+	return 0;
+#endif
+}
+
+/// Highest resident memory of the process since the last resetPeakRSS, in bytes
+uint64_t peakRSS ()
+{
+#if defined(__linux__)
+	return readProcStatus ("VmHWM");
+#elif defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo (GetCurrentProcess (), &counters, sizeof (counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+	struct rusage usage;
+	getrusage (RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return static_cast<uint64_t> (usage.ru_maxrss); // Bytes
+#else
+	return static_cast<uint64_t> (usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+/// Restarts the peak from the current resident memory. Only Linux can: elsewhere the peak is the one
+/// of the whole process, returns false.
+bool resetPeakRSS ()
+{
+#if defined(__linux__)
+	std::ofstream clearRefs ("/proc/self/clear_refs");
+	clearRefs << "5";
+	clearRefs.close ();
+	return static_cast<bool> (clearRefs);
+#else
+	return false;
+#endif
+}
+
+/// UV sphere of at least numTriangles triangles, without seam: the planar texture coordinates are
+/// computed as for the models, which have none
+std::shared_ptr<Mesh> makeSphere (size_t numTriangles)
+{
+	// stacks rings of 2 * stacks vertices between the poles: 4 * stacks * (stacks - 1) triangles
+	unsigned int stacks = std::max (3u, static_cast<unsigned int> (std::ceil (0.5 + std::sqrt (0.25 + numTriangles / 4.0))));
+	unsigned int slices = 2 * stacks;
+	auto meshPtr = std::make_shared<Mesh> ();
+	std::vector<glm::vec3> & positions = meshPtr->vertexPositions ();
+	std::vector<glm::uvec3> & triangles = meshPtr->triangleIndices ();
+	positions.reserve (2 + size_t (stacks - 1) * slices);
+	triangles.reserve (size_t (4) * stacks * (stacks - 1));
+	positions.push_back (glm::vec3 (0.f, 1.f, 0.f));
+	for (unsigned int i = 1; i < stacks; i++)
+	{
+		float theta = glm::pi<float> () * i / stacks;
+		for (unsigned int j = 0; j < slices; j++)
+		{
+			float phi = 2.f * glm::pi<float> () * j / slices;
+			positions.push_back (glm::vec3 (std::sin (theta) * std::cos (phi), std::cos (theta), std::sin (theta) * std::sin (phi)));
+		}
+	}
+	unsigned int south = static_cast<unsigned int> (positions.size ());
+	positions.push_back (glm::vec3 (0.f, -1.f, 0.f));
+
+	auto ring = [slices] (unsigned int i, unsigned int j) { return 1 + (i - 1) * slices + j % slices; };
+	for (unsigned int j = 0; j < slices; j++)
+	{
+		triangles.push_back (glm::uvec3 (0, ring (1, j + 1), ring (1, j)));
+		triangles.push_back (glm::uvec3 (south, ring (stacks - 1, j), ring (stacks - 1, j + 1)));
+	}
+	for (unsigned int i = 1; i + 1 < stacks; i++)
+		for (unsigned int j = 0; j < slices; j++)
+		{
+			triangles.push_back (glm::uvec3 (ring (i, j), ring (i, j + 1), ring (i + 1, j)));
+			triangles.push_back (glm::uvec3 (ring (i, j + 1), ring (i + 1, j + 1), ring (i + 1, j)));
+		}
+	meshPtr->recomputePerVertexNormals (true); // As MeshLoader does
+	return meshPtr;
+}
+
+void runOperation (const Operation & operation, Mesh & mesh)
+{
+	switch (operation.type)
+	{
+	case Operation::NORMALS: mesh.recomputePerVertexNormals (true); break;
+	case Operation::LAPLACIAN: mesh.laplacianFilter (operation.parameter, true); break;
+	case Operation::SIMPLIFY: mesh.simplify (static_cast<unsigned int> (operation.parameter)); break;
+	case Operation::ADAPTIVE_SIMPLIFY: mesh.adaptiveSimplify (static_cast<unsigned int> (operation.parameter)); break;
+	case Operation::SUBDIVIDE: mesh.subdivide (); break;
+	case Operation::BOUNDING_SPHERE:
+		{
+			glm::vec3 center;
+			float radius;
+			mesh.computeBoundingSphere (center, radius);
+			break;
+		}
+	}
+}
+
+/// Times operation repetitions times, each on a copy of the mesh made beforehand, which counts in the peak memory
+Result benchmark (const Operation & operation, const Mesh & mesh, size_t repetitions, bool noLimits)
+{
+	Result result;
+	result.operation = &operation;
+	if (!noLimits && operation.maxVertices && mesh.vertexPositions ().size () > operation.maxVertices)
+	{
+		result.skipped = true;
+		return result;
+	}
+	for (size_t k = 0; k < repetitions; k++)
+	{
+		Mesh copy (mesh);
+		uint64_t before = currentRSS ();
+		resetPeakRSS ();
+		auto start = std::chrono::steady_clock::now ();
+		runOperation (operation, copy);
+		auto end = std::chrono::steady_clock::now ();
+		result.nanoseconds.push_back (std::chrono::duration<double, std::nano> (end - start).count ());
+		result.rssBeforeBytes = std::max (result.rssBeforeBytes, before);
+		result.peakRSSBytes = std::max (result.peakRSSBytes, peakRSS ());
+	}
+	return result;
+}
+
+double median (std::vector<double> values)
+{
+	std::sort (values.begin (), values.end ());
+	size_t n = values.size ();
+	return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+void writeJSONString (std::ostream & out, const std::string & text)
+{
+	out << '"';
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (static_cast<unsigned char> (c) < 0x20)
+			out << ' ';
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+std::string timestamp ()
+{
+	std::time_t now = std::time (nullptr);
+	char text[32];
+	std::strftime (text, sizeof (text), "%Y-%m-%dT%H:%M:%SZ", std::gmtime (&now));
+	return text;
+}
+
+std::string compilerName ()
+{
+	std::ostringstream name;
+#if defined(__clang__)
+	name << "clang " << __clang_major__ << "." << __clang_minor__ << "." << __clang_patchlevel__;
+#elif defined(__GNUC__)
+	name << "gcc " << __GNUC__ << "." << __GNUC_MINOR__ << "." << __GNUC_PATCHLEVEL__;
+#elif defined(_MSC_VER)
+	name << "msvc " << _MSC_VER;
+#else
+	name << "unknown";
+#endif
+#if defined(NDEBUG)
+	name << ", optimized";
+#else
+	name << ", assertions enabled";
+#endif
+	return name.str ();
+}
+
+void writeResults (const std::string & filename, const std::vector<BenchmarkMesh> & meshes, const std::vector<std::vector<Result>> & results,
+				   size_t repetitions, bool isPeakPerOperation)
+{
+	std::ofstream out (filename.c_str (), std::ios::trunc);
+	if (!out)
+		throw std::ios_base::failure ("[Benchmark][writeResults] Cannot open " + filename);
+	uint64_t runPeakRSSBytes = peakRSS (); // The peak being reset before each operation
+	for (const std::vector<Result> & meshResults : results)
+		for (const Result & result : meshResults)
+			runPeakRSSBytes = std::max (runPeakRSSBytes, result.peakRSSBytes);
+	out.setf (std::ios::fixed);
+	out.precision (3);
+	out << "{\n\"timestamp\": ";
+	writeJSONString (out, timestamp ());
+	out << ",\n\"compiler\": ";
+	writeJSONString (out, compilerName ());
+	out << ",\n\"repetitions\": " << repetitions
+		<< ",\n\"peakRSSPerOperation\": " << (isPeakPerOperation ? "true" : "false")
+		<< ",\n\"peakRSSBytes\": " << runPeakRSSBytes
+		<< ",\n\"meshes\": [";
+	for (size_t i = 0; i < meshes.size (); i++)
+	{
+		double numVertices = static_cast<double> (meshes[i].numVertices);
+		out << (i ? ",\n" : "\n") << "{\"name\": ";
+		writeJSONString (out, meshes[i].name);
+		out << ", \"source\": ";
+		writeJSONString (out, meshes[i].source);
+		out << ", \"vertices\": " << meshes[i].numVertices << ", \"triangles\": " << meshes[i].numTriangles
+			<< ", \"loadMs\": " << meshes[i].loadMilliseconds << ", \"operations\": [";
+		for (size_t j = 0; j < results[i].size (); j++)
+		{
+			const Result & result = results[i][j];
+			out << (j ? ",\n" : "\n") << "  {\"name\": ";
+			writeJSONString (out, result.operation->name);
+			out << ", \"parameter\": " << result.operation->parameter;
+			if (result.skipped)
+			{
+				out << ", \"skipped\": true}";
+				continue;
+			}
+			double medianNanoseconds = median (result.nanoseconds);
+			double minNanoseconds = *std::min_element (result.nanoseconds.begin (), result.nanoseconds.end ());
+			out << ", \"skipped\": false, \"medianMs\": " << medianNanoseconds * 1e-6 << ", \"nsPerVertex\": " << medianNanoseconds / numVertices
+				<< ", \"minNsPerVertex\": " << minNanoseconds / numVertices << ", \"rssBeforeBytes\": " << result.rssBeforeBytes
+				<< ", \"peakRSSBytes\": " << result.peakRSSBytes << "}";
+		}
+		out << "\n]}";
+	}
+	out << "\n]\n}\n";
+	if (!out)
+		throw std::ios_base::failure ("[Benchmark][writeResults] Cannot write " + filename);
+}
+
+bool isMeshFile (const fs::path & path)
+{
+	std::string extension = path.extension ().string ();
+	std::transform (extension.begin (), extension.end (), extension.begin (), [] (unsigned char c) { return std::tolower (c); });
+	return extension == ".off" || extension == ".ply" || extension == ".obj" || extension == ".qmesh";
+}
+
+}
+
+int main (int argc, char ** argv)
+{
+	std::string modelDirectory = "Resources/Models";
+	size_t maxTriangles = SPHERE_TRIANGLES[std::size (SPHERE_TRIANGLES) - 1];
+	size_t repetitions = 3;
+	bool noLimits = false;
+	std::vector<std::string> arguments;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		try
+		{
+			if (argument == "--models" && i + 1 < argc)
+				modelDirectory = argv[++i];
+			else if (argument == "--max-triangles" && i + 1 < argc)
+				maxTriangles = parsePositive (argv[++i], "maximum number of triangles", std::numeric_limits<size_t>::max ());
+			else if (argument == "--repetitions" && i + 1 < argc)
+				repetitions = parsePositive (argv[++i], "number of repetitions");
+			else if (argument == "--no-limits")
+				noLimits = true;
+			else
+				arguments.push_back (argument);
+		}
+		catch (std::invalid_argument & e)
+		{
+			std::cerr << "> [Error]" << e.what () << std::endl;
+			usage (argv[0]);
+		}
+	}
+	if (arguments.size () != 1)
+		usage (argv[0]);
+
+	try
+	{
+		std::vector<fs::path> models;
+		for (const auto & entry : fs::directory_iterator (modelDirectory))
+			if (entry.is_regular_file () && isMeshFile (entry.path ()))
+				models.push_back (entry.path ());
+		std::sort (models.begin (), models.end ());
+
+		bool isPeakPerOperation = resetPeakRSS ();
+		if (!isPeakPerOperation)
+			std::cout << " > The peak resident memory cannot be reset on this system: the one reported is the peak of the whole run so far" << std::endl;
+
+		std::vector<BenchmarkMesh> meshes;
+		std::vector<std::vector<Result>> results;
+		auto run = [&] (const std::string & name, const std::string & source, std::shared_ptr<Mesh> meshPtr, double loadMilliseconds) {
+			size_t numVertices = meshPtr->vertexPositions ().size ();
+			std::cout << " > " << name << ": " << numVertices << " vertices, " << meshPtr->triangleIndices ().size () << " triangles" << std::endl;
+			std::vector<Result> meshResults;
+			for (const Operation & operation : OPERATIONS)
+			{
+				meshResults.push_back (benchmark (operation, *meshPtr, repetitions, noLimits));
+				const Result & result = meshResults.back ();
+				if (result.skipped)
+					std::cout << "   " << operation.name << ": skipped above " << operation.maxVertices << " vertices" << std::endl;
+				else
+					std::cout << "   " << operation.name << ": " << median (result.nanoseconds) / numVertices
+							  << " ns/vertex, peak " << result.peakRSSBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+			}
+			results.push_back (std::move (meshResults));
+			meshes.push_back ({ name, source, numVertices, meshPtr->triangleIndices ().size (), loadMilliseconds });
+		};
+
+		for (const fs::path & model : models)
+		{
+			auto start = std::chrono::steady_clock::now ();
+			auto meshPtr = std::make_shared<Mesh> ();
+			MeshLoader::load (model.string (), meshPtr);
+			double milliseconds = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+			run (model.filename ().string (), "model", meshPtr, milliseconds);
+		}
+		for (size_t numTriangles : SPHERE_TRIANGLES)
+		{
+			if (numTriangles > maxTriangles)
+				continue;
+			auto start = std::chrono::steady_clock::now ();
+			auto meshPtr = makeSphere (numTriangles);
+			double milliseconds = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+			run ("sphere-" + std::to_string (numTriangles), "sphere", meshPtr, milliseconds);
+		}
+		writeResults (arguments[0], meshes, results, repetitions, isPeakPerOperation);
+		std::cout << " > Results written to " << arguments[0] << std::endl;
+		return EXIT_SUCCESS;
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "> [Critical error]" << e.what () << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <string>
+#include <stdexcept>
+#include <charconv>
+#include <system_error>
+#include <limits>
+
+/// Parses a numeric command line argument, which must be a positive integer written in full ("12x"
+/// and "-3" are rejected) and at most max. Throws std::invalid_argument naming the value otherwise.
+inline unsigned long long parsePositive (const std::string & argument, const std::string & name,
+										 unsigned long long max = std::numeric_limits<int>::max ())
+{
+	unsigned long long value = 0;
+	std::from_chars_result result = std::from_chars (argument.data (), argument.data () + argument.size (), value);
+	if (result.ec != std::errc () || result.ptr != argument.data () + argument.size () || value == 0 || value > max)
+		throw std::invalid_argument ("[Command Line][parsePositive] The " + name + " must be a positive integer up to "
+									 + std::to_string (max) + ", not " + argument);
+	return value;
+}
+
+#endif // COMMAND_LINE_H
@@ -0,0 +1,161 @@
+#include "GLMesh.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+GLMesh::~GLMesh () 
+{
+	releaseBuffers ();
+}
+
+void GLMesh::init () 
+{
+	upload (std::numeric_limits<size_t>::max ());
+}
+
+bool GLMesh::upload (size_t maxBytes) 
+{
+	if (m_vao)
+		return true;
+	PROFILE_ZONE ("GLMesh::upload");
+	size_t vertexBufferSize = sizeof (glm::vec3) * vertexPositions ().size (); // Gather the size of the buffer from the CPU-side vector
+	size_t texCoordBufferSize = sizeof (glm::vec2) * vertexTexCoords ().size ();
+	size_t indexBufferSize = sizeof (glm::uvec3) * triangleIndices ().size ();
+	if (m_posVbo == 0)
+	{
+		computeMinMaxCoordinates(); // Attributes may come precomputed from a cache, only the bounds are needed here
+		glCreateBuffers (1, &m_posVbo); // Generate a GPU buffer to store the positions of the vertices
+		glNamedBufferStorage (m_posVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT); // Create a data store on the GPU, filled below
+		glCreateBuffers (1, &m_normalVbo); // Same for normal
+		glNamedBufferStorage (m_normalVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers (1, &m_texCoordVbo); // Same for texture coordinates
+		glNamedBufferStorage (m_texCoordVbo, texCoordBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers (1, &m_ibo); // Same for the index buffer, that stores the list of indices of the triangles forming the mesh
+		glNamedBufferStorage (m_ibo, indexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers (1, &m_tanVbo); // Same for the tangent buffer
+		glNamedBufferStorage (m_tanVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers (1, &m_biVbo); // Same for the bitangent buffer
+		glNamedBufferStorage (m_biVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
+		m_uploadedBytes = 0;
+		m_bufferVertices = vertexPositions ().size ();
+		m_bufferTriangles = triangleIndices ().size ();
+	}
+
+	// Fill the data stores from the CPU arrays, resuming where the previous call stopped
+	struct { GLuint buffer; const void * data; size_t size; } arrays[] = {
+		{ m_posVbo, vertexPositions ().data (), vertexBufferSize },
+		{ m_normalVbo, vertexNormals ().data (), vertexBufferSize },
+		{ m_texCoordVbo, vertexTexCoords ().data (), texCoordBufferSize },
+		{ m_ibo, triangleIndices ().data (), indexBufferSize },
+		{ m_tanVbo, vertexTangents ().data (), vertexBufferSize },
+		{ m_biVbo, vertexBitangents ().data (), vertexBufferSize }
+	};
+	size_t arrayStart = 0;
+	for (const auto & array : arrays)
+	{
+		if (maxBytes > 0 && m_uploadedBytes < arrayStart + array.size)
+		{
+			size_t offset = m_uploadedBytes - arrayStart;
+			size_t size = std::min (array.size - offset, maxBytes);
+			glNamedBufferSubData (array.buffer, offset, size, static_cast<const char *> (array.data) + offset);
+			m_uploadedBytes += size;
+			maxBytes -= size;
+		}
+		arrayStart += array.size;
+	}
+	if (m_uploadedBytes < arrayStart)
+		return false;
+
+	glCreateVertexArrays (1, &m_vao); // Create a single handle that joins together attributes (vertex positions, normals) and connectivity (triangles indices)
+	glBindVertexArray (m_vao);
+	glEnableVertexAttribArray (0);
+	glBindBuffer (GL_ARRAY_BUFFER, m_posVbo);
+	glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
+	glEnableVertexAttribArray (1);
+	glBindBuffer (GL_ARRAY_BUFFER, m_normalVbo);
+	glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
+	glEnableVertexAttribArray (2);
+	glBindBuffer (GL_ARRAY_BUFFER, m_texCoordVbo);
+	glVertexAttribPointer (2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof (GLfloat), 0);
+	glEnableVertexAttribArray (3);
+	glBindBuffer (GL_ARRAY_BUFFER, m_tanVbo);
+	glVertexAttribPointer (3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
+	glEnableVertexAttribArray (4);
+	glBindBuffer (GL_ARRAY_BUFFER, m_biVbo);
+	glVertexAttribPointer (4, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
+	glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glBindVertexArray (0); // Desactive the VAO just created. Will be activated at rendering time.
+	return true;
+}
+
+float GLMesh::uploadProgress () const
+{
+	if (m_vao)
+		return 1.f;
+	size_t total = 4 * sizeof (glm::vec3) * vertexPositions ().size () + sizeof (glm::vec2) * vertexTexCoords ().size ()
+				   + sizeof (glm::uvec3) * triangleIndices ().size ();
+	return total ? static_cast<float> (m_uploadedBytes) / total : 0.f;
+}
+
+void GLMesh::render () 
+{
+	glBindVertexArray (m_vao); // Activate the VAO storing geometry data
+	glDrawElements (GL_TRIANGLES, static_cast<GLsizei> (triangleIndices ().size () * 3), GL_UNSIGNED_INT, 0); // Call for rendering: stream the current GPU geometry through the current GPU program
+}
+
+void GLMesh::clear () 
+{
+	Mesh::clear ();
+	releaseBuffers ();
+}
+
+void GLMesh::geometryChanged ()
+{
+	if (!m_vao)
+		return; // Not uploaded yet, the upload will read the current attributes
+	if (vertexPositions ().size () == m_bufferVertices && triangleIndices ().size () == m_bufferTriangles)
+		push_buffers ();
+	else
+	{
+		releaseBuffers (); // Immutable storage: a new size needs new buffers
+		init ();
+	}
+}
+
+void GLMesh::push_buffers()
+{
+	size_t vertexBufferSize = sizeof (glm::vec3) * vertexPositions ().size (); // Gather the size of the buffer from the CPU-side vector
+	size_t texCoordBufferSize = sizeof (glm::vec2) * vertexTexCoords ().size ();
+	size_t indexBufferSize = sizeof (glm::uvec3) * triangleIndices ().size ();
+
+	glNamedBufferSubData (m_ibo, 0, indexBufferSize, triangleIndices ().data ());
+	glNamedBufferSubData (m_normalVbo, 0, vertexBufferSize, vertexNormals ().data ());
+	glNamedBufferSubData (m_texCoordVbo, 0, texCoordBufferSize, vertexTexCoords ().data ());
+	glNamedBufferSubData (m_posVbo, 0, vertexBufferSize, vertexPositions ().data ());
+	glNamedBufferSubData (m_tanVbo, 0, vertexBufferSize, vertexTangents ().data ());
+	glNamedBufferSubData (m_biVbo, 0, vertexBufferSize, vertexBitangents ().data ());
+}
+
+void GLMesh::releaseBuffers ()
+{
+	m_uploadedBytes = 0;
+
+	if (m_vao) 
+	{
+		glDeleteVertexArrays (1, &m_vao);
+		m_vao = 0;
+	}
+
+	GLuint * buffers[] = { &m_posVbo, &m_normalVbo, &m_texCoordVbo, &m_ibo, &m_tanVbo, &m_biVbo };
+	for (GLuint * buffer : buffers)
+	{
+		if (*buffer)
+		{
+			glDeleteBuffers (1, buffer);
+			*buffer = 0;
+		}
+	}
+}
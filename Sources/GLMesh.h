@@ -0,0 +1,50 @@
+#ifndef GL_MESH_H
+#define GL_MESH_H
+
+#include <glad/glad.h>
+
+#include "Mesh.h"
+
+/// Mesh mirrored in GPU buffers, rendered as indexed triangles. The GL objects are created by the
+/// first upload and refreshed whenever a processing algorithm modifies the geometry.
+class GLMesh : public Mesh {
+public:
+	virtual ~GLMesh ();
+
+	/// Uploads the CPU-side attributes to the GPU. Normals, tangents and texture coordinates
+	/// must already be up to date (see recomputePerVertexNormals), they are not recomputed here.
+	void init ();
+
+	/// Incremental version of init: uploads at most maxBytes more of the attributes, creating the
+	/// buffers on the first call, so that a large mesh can be uploaded over several frames.
+	/// Returns true once the mesh is entirely on the GPU and can be rendered.
+	bool upload (size_t maxBytes);
+
+	/// Fraction (from 0 to 1) of the attributes already uploaded by upload
+	float uploadProgress () const;
+
+	void render ();
+
+	virtual void clear ();
+
+protected:
+	/// Updates the GPU buffers in place, or recreates them if the number of vertices or triangles changed
+	virtual void geometryChanged ();
+
+private:
+	void push_buffers();
+	void releaseBuffers ();
+
+	GLuint m_vao = 0;
+	GLuint m_posVbo = 0;
+	GLuint m_normalVbo = 0;
+	GLuint m_texCoordVbo = 0;
+	GLuint m_ibo = 0;
+	GLuint m_tanVbo = 0;
+	GLuint m_biVbo = 0;
+	size_t m_uploadedBytes = 0;
+	size_t m_bufferVertices = 0; // Sizes the buffers were created with
+	size_t m_bufferTriangles = 0;
+};
+
+#endif // GL_MESH_H
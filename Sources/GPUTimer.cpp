@@ -0,0 +1,155 @@
+#include "GPUTimer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+/// Nearest-rank percentile of sorted values
+double percentile (const std::vector<double> & sorted, double fraction)
+{
+	size_t rank = static_cast<size_t> (std::ceil (fraction * sorted.size ()));
+	return sorted[std::min (sorted.size (), std::max<size_t> (rank, 1)) - 1];
+}
+
+}
+
+GPUTimer::GPUTimer (size_t numPasses, size_t historySize, size_t ringSize)
+	: m_numPasses (numPasses), m_historySize (std::max<size_t> (historySize, 1)), m_queries (numPasses * std::max<size_t> (ringSize, 1)),
+	  m_slots (std::max<size_t> (ringSize, 1)), m_history (numPasses, std::vector<double> (m_historySize)), m_historyNext (numPasses, 0),
+	  m_historyCount (numPasses, 0)
+{
+	if (numPasses == 0)
+		throw std::runtime_error ("[GPU Timer][GPUTimer] No pass to measure");
+	glCreateQueries (GL_TIME_ELAPSED, static_cast<GLsizei> (m_queries.size ()), m_queries.data ());
+	for (Slot & slot : m_slots)
+		slot.issued.assign (numPasses, false);
+}
+
+GPUTimer::~GPUTimer ()
+{
+	glDeleteQueries (static_cast<GLsizei> (m_queries.size ()), m_queries.data ());
+}
+
+void GPUTimer::beginFrame (int tag)
+{
+	m_isMeasuring = m_numPending < m_slots.size ();
+	if (m_isMeasuring)
+	{
+		Slot & slot = m_slots[m_writeSlot];
+		slot.index = m_numFrames;
+		slot.tag = tag;
+		std::fill (slot.issued.begin (), slot.issued.end (), false);
+	}
+	else
+		m_numSkippedFrames++;
+	m_numFrames++;
+}
+
+void GPUTimer::beginPass (size_t pass)
+{
+	if (!m_isMeasuring || pass >= m_numPasses || m_activePass != SIZE_MAX)
+		return;
+	glBeginQuery (GL_TIME_ELAPSED, m_queries[m_writeSlot * m_numPasses + pass]);
+	m_slots[m_writeSlot].issued[pass] = true;
+	m_activePass = pass;
+}
+
+void GPUTimer::endPass ()
+{
+	if (m_activePass == SIZE_MAX)
+		return;
+	glEndQuery (GL_TIME_ELAPSED);
+	m_activePass = SIZE_MAX;
+}
+
+void GPUTimer::endFrame ()
+{
+	endPass ();
+	if (m_isMeasuring)
+	{
+		m_writeSlot = (m_writeSlot + 1) % m_slots.size ();
+		m_numPending++;
+		m_isMeasuring = false;
+	}
+	collect ();
+}
+
+void GPUTimer::collect ()
+{
+	// Queries complete in the order they were issued
+	while (m_numPending > 0 && isAvailable (m_slots[m_readSlot], m_readSlot))
+	{
+		readBack (m_slots[m_readSlot], m_readSlot);
+		m_readSlot = (m_readSlot + 1) % m_slots.size ();
+		m_numPending--;
+	}
+}
+
+bool GPUTimer::isAvailable (const Slot & slot, size_t slotIndex) const
+{
+	for (size_t pass = m_numPasses; pass-- > 0; )
+		if (slot.issued[pass])
+		{
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv (m_queries[slotIndex * m_numPasses + pass], GL_QUERY_RESULT_AVAILABLE, &available);
+			return available == GL_TRUE;
+		}
+	return true;
+}
+
+void GPUTimer::readBack (Slot & slot, size_t slotIndex)
+{
+	Frame frame { slot.index, slot.tag, std::vector<double> (m_numPasses, std::numeric_limits<double>::quiet_NaN ()) };
+	for (size_t pass = 0; pass < m_numPasses; pass++)
+	{
+		if (!slot.issued[pass])
+			continue;
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v (m_queries[slotIndex * m_numPasses + pass], GL_QUERY_RESULT, &nanoseconds);
+		double milliseconds = nanoseconds * 1e-6;
+		frame.passMilliseconds[pass] = milliseconds;
+		if (slot.index < m_historyFirstFrame) // Rendered before clearHistory
+			continue;
+		m_history[pass][m_historyNext[pass]] = milliseconds;
+		m_historyNext[pass] = (m_historyNext[pass] + 1) % m_historySize;
+		m_historyCount[pass] = std::min (m_historyCount[pass] + 1, m_historySize);
+	}
+	m_frames.push_back (std::move (frame));
+}
+
+std::vector<GPUTimer::Frame> GPUTimer::takeFrames ()
+{
+	std::vector<Frame> frames;
+	frames.swap (m_frames);
+	return frames;
+}
+
+GPUTimer::Statistics GPUTimer::statistics (size_t pass) const
+{
+	Statistics statistics;
+	if (pass >= m_numPasses || m_historyCount[pass] == 0)
+		return statistics;
+	std::vector<double> sorted (m_history[pass].begin (), m_history[pass].begin () + m_historyCount[pass]);
+	std::sort (sorted.begin (), sorted.end ());
+	statistics.count = sorted.size ();
+	for (double milliseconds : sorted)
+		statistics.mean += milliseconds;
+	statistics.mean /= sorted.size ();
+	statistics.median = percentile (sorted, 0.5);
+	statistics.p95 = percentile (sorted, 0.95);
+	statistics.p99 = percentile (sorted, 0.99);
+	statistics.max = sorted.back ();
+	return statistics;
+}
+
+void GPUTimer::clearHistory ()
+{
+	m_historyFirstFrame = m_numFrames;
+	std::fill (m_historyNext.begin (), m_historyNext.end (), 0);
+	std::fill (m_historyCount.begin (), m_historyCount.end (), 0);
+}
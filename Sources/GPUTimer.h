@@ -0,0 +1,102 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/// Durations of the passes of each frame measured on the GPU with GL_TIME_ELAPSED queries. Each
+/// frame uses its own queries, taken from a ring of them, and reads them back a few frames later
+/// once the GPU has completed them: measuring never waits for the GPU. If the GPU is so late that
+/// every query of the ring is still pending, frames are not measured until one is free again.
+/// Passes must not overlap, as a single time elapsed query can be active at once.
+/// Must be used from the thread owning the GL context.
+class GPUTimer {
+public:
+	/// Durations of the passes of a frame, NaN for passes not measured in this frame
+	struct Frame {
+		uint64_t index; // Counted from the first frame given to beginFrame, measured or not
+		int tag; // Given to beginFrame, e.g. the shader mode of the frame
+		std::vector<double> passMilliseconds;
+	};
+
+	/// Of the last durations of a pass, in milliseconds
+	struct Statistics {
+		size_t count = 0;
+		double mean = 0.0;
+		double median = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	/// Statistics are computed on the last historySize frames read back; ringSize frames can wait
+	/// for their results at once.
+	GPUTimer (size_t numPasses, size_t historySize = 240, size_t ringSize = 4);
+
+	virtual ~GPUTimer ();
+
+	GPUTimer (const GPUTimer &) = delete;
+	GPUTimer & operator= (const GPUTimer &) = delete;
+
+	/// Starts a frame, measured if queries are free
+	void beginFrame (int tag = 0);
+
+	void beginPass (size_t pass);
+
+	void endPass ();
+
+	/// Ends the frame, then collects the frames the GPU has completed
+	void endFrame ();
+
+	/// Reads back the frames the GPU has completed, without waiting for the others
+	void collect ();
+
+	/// Frames read back since the last call, oldest first
+	std::vector<Frame> takeFrames ();
+
+	Statistics statistics (size_t pass) const;
+
+	/// Forgets the durations used by statistics, e.g. when the rendering options change. Frames begun
+	/// before, even those still waiting for their results, are left out of the statistics, but are
+	/// still returned by takeFrames.
+	void clearHistory ();
+
+	/// Frames not measured since the ring was full
+	inline uint64_t numSkippedFrames () const { return m_numSkippedFrames; }
+
+	inline size_t numPasses () const { return m_numPasses; }
+
+private:
+	/// Queries of a frame of the ring
+	struct Slot {
+		uint64_t index = 0;
+		int tag = 0;
+		std::vector<bool> issued;
+	};
+
+	bool isAvailable (const Slot & slot, size_t slotIndex) const;
+
+	void readBack (Slot & slot, size_t slotIndex);
+
+	size_t m_numPasses;
+	size_t m_historySize;
+	std::vector<GLuint> m_queries; // numPasses per slot
+	std::vector<Slot> m_slots;
+	size_t m_writeSlot = 0;
+	size_t m_readSlot = 0;
+	size_t m_numPending = 0;
+	bool m_isMeasuring = false; // The current frame has a slot
+	size_t m_activePass = SIZE_MAX;
+	uint64_t m_numFrames = 0;
+	uint64_t m_numSkippedFrames = 0;
+	uint64_t m_historyFirstFrame = 0; // Index of the first frame kept by statistics
+	std::vector<std::vector<double>> m_history; // Ring of the last durations, per pass
+	std::vector<size_t> m_historyNext;
+	std::vector<size_t> m_historyCount;
+	std::vector<Frame> m_frames;
+};
+
+#endif // GPU_TIMER_H
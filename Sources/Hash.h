@@ -0,0 +1,37 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/// Fast non-cryptographic 64-bit hash, used to key on-disk caches by content.
+/// Consumes 8 bytes per step so that hashing a file costs far less than parsing it.
+inline uint64_t hashBytes (const void * data, size_t size, uint64_t seed = 0x9E3779B97F4A7C15ull)
+{
+	const uint64_t prime = 0x100000001B3ull;
+	const unsigned char * bytes = static_cast<const unsigned char *> (data);
+	uint64_t h = seed ^ (size * prime);
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		std::memcpy (&word, bytes + i, 8);
+		h = (h ^ word) * prime;
+		h ^= h >> 29;
+	}
+	for (; i < size; i++)
+		h = (h ^ bytes[i]) * prime;
+	h ^= h >> 32;
+	h *= 0xD6E8FEB86659FD93ull;
+	h ^= h >> 32;
+	return h;
+}
+
+inline uint64_t hashString (const std::string & s, uint64_t seed = 0x9E3779B97F4A7C15ull)
+{
+	return hashBytes (s.data (), s.size (), seed);
+}
+
+#endif // HASH_H
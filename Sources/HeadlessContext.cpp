@@ -0,0 +1,113 @@
+#include "HeadlessContext.h"
+
+#include <stdexcept>
+#include <sstream>
+
+#ifdef BASEGL_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+using namespace std;
+
+#ifdef BASEGL_EGL
+
+namespace {
+
+std::string eglErrorString (const std::string & call)
+{
+	std::ostringstream message;
+	message << "[Headless Context][HeadlessContext] " << call << " failed, EGL error 0x" << std::hex << eglGetError ();
+	return message.str ();
+}
+
+/// Surfaceless display when the implementation supports it, so that no X11 or Wayland server is needed
+EGLDisplay getDisplay ()
+{
+	const char * extensions = eglQueryString (EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (extensions && std::string (extensions).find ("EGL_MESA_platform_surfaceless") != std::string::npos)
+	{
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC> (eglGetProcAddress ("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay)
+		{
+			EGLDisplay display = getPlatformDisplay (EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (display != EGL_NO_DISPLAY)
+				return display;
+		}
+	}
+	return eglGetDisplay (EGL_DEFAULT_DISPLAY);
+}
+
+}
+
+HeadlessContext::HeadlessContext (int majorVersion, int minorVersion)
+{
+	EGLDisplay display = getDisplay ();
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize (display, &major, &minor))
+		throw std::runtime_error (eglErrorString ("eglInitialize"));
+	m_display = display;
+	if (!eglBindAPI (EGL_OPENGL_API))
+	{
+		eglTerminate (display);
+		throw std::runtime_error (eglErrorString ("eglBindAPI"));
+	}
+
+	// No surface is ever created: any config able to render OpenGL will do, or none at all
+	const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = nullptr;
+	EGLint numConfigs = 0;
+	eglChooseConfig (display, configAttributes, &config, 1, &numConfigs);
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+		EGL_CONTEXT_MINOR_VERSION, minorVersion,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext (display, numConfigs > 0 ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		std::string message = eglErrorString ("eglCreateContext");
+		eglTerminate (display);
+		throw std::runtime_error (message);
+	}
+	m_context = context;
+	if (!eglMakeCurrent (display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		std::string message = eglErrorString ("eglMakeCurrent");
+		eglDestroyContext (display, context);
+		eglTerminate (display);
+		throw std::runtime_error (message);
+	}
+	const char * vendor = eglQueryString (display, EGL_VENDOR);
+	m_description = "EGL " + std::to_string (major) + "." + std::to_string (minor) + " (" + (vendor ? vendor : "unknown vendor") + ")";
+}
+
+HeadlessContext::~HeadlessContext ()
+{
+	EGLDisplay display = static_cast<EGLDisplay> (m_display);
+	eglMakeCurrent (display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext (display, static_cast<EGLContext> (m_context));
+	eglTerminate (display);
+}
+
+void * HeadlessContext::getProcAddress (const char * name)
+{
+	return reinterpret_cast<void *> (eglGetProcAddress (name));
+}
+
+#else
+
+HeadlessContext::HeadlessContext (int majorVersion, int minorVersion)
+{
+	throw std::runtime_error ("[Headless Context][HeadlessContext] Built without EGL");
+}
+
+HeadlessContext::~HeadlessContext () {}
+
+void * HeadlessContext::getProcAddress (const char * name)
+{
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <string>
+
+/// OpenGL context without any window nor display server, created with EGL on a surfaceless
+/// display (EGL_MESA_platform_surfaceless, e.g. Mesa llvmpipe on a server without GPU), or on the
+/// default display otherwise. It has no default framebuffer: render to a framebuffer object.
+/// Only available when built with EGL (BASEGL_EGL); otherwise the constructor throws.
+class HeadlessContext {
+public:
+	/// Creates a core profile context of the given version and makes it current on the calling thread.
+	/// Throws std::runtime_error if EGL cannot provide it.
+	HeadlessContext (int majorVersion = 4, int minorVersion = 5);
+
+	virtual ~HeadlessContext ();
+
+	HeadlessContext (const HeadlessContext &) = delete;
+	HeadlessContext & operator= (const HeadlessContext &) = delete;
+
+	/// Address of a GL function, to load with gladLoadGLLoader
+	static void * getProcAddress (const char * name);
+
+	/// EGL vendor and version, for logs
+	inline const std::string & description () const { return m_description; }
+
+private:
+	void * m_display = nullptr;
+	void * m_context = nullptr;
+	std::string m_description;
+};
+
+#endif // HEADLESS_CONTEXT_H
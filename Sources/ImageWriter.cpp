@@ -0,0 +1,23 @@
+#include "ImageWriter.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <ios>
+
+using namespace std;
+
+namespace ImageWriter {
+
+void savePNG (const std::string & filename, const uint8_t * pixels, int width, int height, int numComponents, bool flipVertically)
+{
+	if (width <= 0 || height <= 0 || numComponents < 1 || numComponents > 4)
+		throw std::ios_base::failure ("[Image Writer][savePNG] Invalid image for " + filename);
+	int stride = width * numComponents;
+	// Bottom-up rows are written from the last one, with a negative stride
+	const uint8_t * first = flipVertically ? pixels + size_t (height - 1) * stride : pixels;
+	if (!stbi_write_png (filename.c_str (), width, height, numComponents, first, flipVertically ? -stride : stride))
+		throw std::ios_base::failure ("[Image Writer][savePNG] Cannot write " + filename);
+}
+
+}
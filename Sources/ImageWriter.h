@@ -0,0 +1,16 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <string>
+#include <cstdint>
+
+/// PNG files of 8 bit images, e.g. frames read back from the GPU, written by stb_image_write
+namespace ImageWriter {
+
+/// Writes an image of numComponents interleaved channels (1 gray, 2 gray and alpha, 3 RGB, 4 RGBA),
+/// rows from the top unless flipVertically is set, e.g. for pixels given by glReadPixels
+void savePNG (const std::string & filename, const uint8_t * pixels, int width, int height, int numComponents, bool flipVertically = false);
+
+}
+
+#endif // IMAGE_WRITER_H
@@ -0,0 +1,99 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace std;
+
+LightClusters::LightClusters (unsigned int numTilesX, unsigned int numTilesY, unsigned int numSlices) :
+	m_numTilesX (numTilesX),
+	m_numTilesY (numTilesY),
+	m_numSlices (numSlices) {}
+
+bool LightClusters::computeBounds (const Light & light, const glm::mat4 & projectionMatrix, float zNear, float zFar, Bounds & bounds) const
+{
+	const glm::vec3 & center = light.position;
+	float range = light.range;
+
+	// Depths, the camera looking down -Z
+	float depthMin = std::max (-center.z - range, zNear);
+	float depthMax = std::min (-center.z + range, zFar);
+	if (!(depthMin <= depthMax))
+		return false;
+	auto slice = [&] (float depth) {
+		float s = std::floor (std::log (depth) * m_depthScale + m_depthBias);
+		return static_cast<unsigned int> (std::clamp (s, 0.f, float (m_numSlices - 1)));
+	};
+	bounds.min.z = slice (depthMin);
+	bounds.max.z = slice (depthMax);
+
+	// Screen extent of the bounding box of the range, the whole screen if the box reaches the camera
+	glm::vec2 ndcMin (-1.f), ndcMax (1.f);
+	if (center.z + range < 0.f)
+	{
+		ndcMin = glm::vec2 (FLT_MAX);
+		ndcMax = glm::vec2 (-FLT_MAX);
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec4 corner (center.x + (i & 1 ? range : -range), center.y + (i & 2 ? range : -range), center.z + (i & 4 ? range : -range), 1.f);
+			glm::vec4 clip = projectionMatrix * corner;
+			glm::vec2 ndc = glm::vec2 (clip) / clip.w;
+			ndcMin = glm::min (ndcMin, ndc);
+			ndcMax = glm::max (ndcMax, ndc);
+		}
+		if (ndcMax.x < -1.f || ndcMin.x > 1.f || ndcMax.y < -1.f || ndcMin.y > 1.f)
+			return false;
+	}
+	auto tile = [] (float ndc, unsigned int numTiles) {
+		float t = std::floor ((ndc * 0.5f + 0.5f) * numTiles);
+		return static_cast<unsigned int> (std::clamp (t, 0.f, float (numTiles - 1)));
+	};
+	bounds.min.x = tile (ndcMin.x, m_numTilesX);
+	bounds.max.x = tile (ndcMax.x, m_numTilesX);
+	bounds.min.y = tile (ndcMin.y, m_numTilesY);
+	bounds.max.y = tile (ndcMax.y, m_numTilesY);
+	return true;
+}
+
+void LightClusters::build (const std::vector<Light> & lights, const glm::mat4 & projectionMatrix, float zNear, float zFar)
+{
+	m_depthScale = m_numSlices / std::log (zFar / zNear);
+	m_depthBias = -std::log (zNear) * m_depthScale;
+	m_clusters.assign (size_t (m_numTilesX) * m_numTilesY * m_numSlices, glm::uvec2 (0));
+	m_bounds.resize (lights.size ());
+
+	// Count the lights of each cluster, turn the counts into offsets, then write the indices
+	for (size_t i = 0; i < lights.size (); i++)
+	{
+		Bounds & bounds = m_bounds[i];
+		if (!computeBounds (lights[i], projectionMatrix, zNear, zFar, bounds))
+		{
+			bounds.min = glm::uvec3 (1); // Empty
+			bounds.max = glm::uvec3 (0);
+		}
+		for (unsigned int z = bounds.min.z; z <= bounds.max.z; z++)
+			for (unsigned int y = bounds.min.y; y <= bounds.max.y; y++)
+				for (unsigned int x = bounds.min.x; x <= bounds.max.x; x++)
+					m_clusters[(size_t (z) * m_numTilesY + y) * m_numTilesX + x].y++;
+	}
+	uint32_t offset = 0;
+	for (glm::uvec2 & cluster : m_clusters)
+	{
+		cluster.x = offset;
+		offset += cluster.y;
+		cluster.y = 0;
+	}
+	m_lightIndices.resize (offset);
+	for (size_t i = 0; i < lights.size (); i++)
+	{
+		const Bounds & bounds = m_bounds[i];
+		for (unsigned int z = bounds.min.z; z <= bounds.max.z; z++)
+			for (unsigned int y = bounds.min.y; y <= bounds.max.y; y++)
+				for (unsigned int x = bounds.min.x; x <= bounds.max.x; x++)
+				{
+					glm::uvec2 & cluster = m_clusters[(size_t (z) * m_numTilesY + y) * m_numTilesX + x];
+					m_lightIndices[cluster.x + cluster.y++] = lights[i].index;
+				}
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/// Assigns lights to the clusters of the view frustum, so that a fragment only shades the lights of
+/// its cluster. Clusters are the screen tiles of a grid, each divided in depth slices spaced
+/// exponentially between the near and far planes. A light goes to every cluster the bounding box of
+/// its range may overlap, which is conservative. The result is laid out for the shaders: the light
+/// indices of all the clusters in a single array, and the offset and count of each cluster in it.
+class LightClusters {
+public:
+	/// Light to bin, in view space
+	struct Light {
+		glm::vec3 position;
+		float range; // May be infinite
+		uint32_t index; // Index given back in lightIndices
+	};
+
+	LightClusters (unsigned int numTilesX = 16, unsigned int numTilesY = 9, unsigned int numSlices = 24);
+
+	/// Bins the lights seen by a camera
+	void build (const std::vector<Light> & lights, const glm::mat4 & projectionMatrix, float zNear, float zFar);
+
+	/// Number of tiles along X and Y and number of slices
+	inline glm::uvec3 size () const { return glm::uvec3 (m_numTilesX, m_numTilesY, m_numSlices); }
+
+	/// Offset and number of the light indices of each cluster, slice by slice, each slice row by row
+	/// from the bottom of the screen
+	inline const std::vector<glm::uvec2> & clusters () const { return m_clusters; }
+
+	inline const std::vector<uint32_t> & lightIndices () const { return m_lightIndices; }
+
+	/// The slice of a view space depth d is floor (log (d) * depthScale + depthBias)
+	inline float depthScale () const { return m_depthScale; }
+
+	inline float depthBias () const { return m_depthBias; }
+
+private:
+	/// Clusters overlapped by a light, bounds included
+	struct Bounds {
+		glm::uvec3 min;
+		glm::uvec3 max;
+	};
+
+	/// False if the light is out of the frustum
+	bool computeBounds (const Light & light, const glm::mat4 & projectionMatrix, float zNear, float zFar, Bounds & bounds) const;
+
+	unsigned int m_numTilesX;
+	unsigned int m_numTilesY;
+	unsigned int m_numSlices;
+	float m_depthScale = 0.f;
+	float m_depthBias = 0.f;
+	std::vector<glm::uvec2> m_clusters;
+	std::vector<uint32_t> m_lightIndices;
+	std::vector<Bounds> m_bounds; // Of each light, kept between builds for its capacity
+};
+
+#endif // LIGHT_CLUSTERS_H
@@ -1,6 +1,10 @@
 #ifndef LIGHTSOURCE_H
 #define LIGHTSOURCE_H
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "Transform.h"
 
 class LightSource : public Transform {
@@ -22,6 +26,16 @@ public:
   inline float getConeAngle(){return coneAngle;};
   inline float getRadialAttenuation(){return radialAttenuation;};
   inline glm::vec3 getDistanceAttenuation(){return distanceAttenuation;};
+  /// Distance beyond which the attenuated intensity of the brightest channel falls below minIntensity,
+  /// 0 if it never reaches it, infinite without linear nor quadratic attenuation
+  inline float computeRange(float minIntensity){
+    float k = intensity*std::max(color.r,std::max(color.g,color.b))/minIntensity;
+    float a = distanceAttenuation[2], b = distanceAttenuation[1], c = distanceAttenuation[0] - k;
+    if(c >= 0.f) return 0.f;
+    if(a > 0.f) return (-b + std::sqrt(b*b - 4.f*a*c))/(2.f*a);
+    if(b > 0.f) return -c/b;
+    return std::numeric_limits<float>::infinity();
+  };
 };
 
 #endif // LIGHTSOURCE_H
@@ -20,6 +20,12 @@
 #include <memory>
 #include <algorithm>
 #include <exception>
+#include <stdexcept>
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -28,10 +34,27 @@
 #include "LightSource.h"
 #include "Error.h"
 #include "ShaderProgram.h"
+#include "ShaderReloader.h"
+#include "ShaderVariants.h"
+#include "UniformBuffer.h"
+#include "UniformBlocks.h"
+#include "StorageBuffer.h"
+#include "GPUTimer.h"
+#include "LightClusters.h"
+#include "BRDFLookupTable.h"
+#include "HeadlessContext.h"
+#include "ImageWriter.h"
 #include "Camera.h"
-#include "Mesh.h"
+#include "GLMesh.h"
 #include "Material.h"
 #include "MeshLoader.h"
+#include "OutOfCoreSimplifier.h"
+#include "MeshArchive.h"
+#include "AsyncMeshLoader.h"
+#include "TextureLoader.h"
+#include "TextureCache.h"
+#include "Profiler.h"
+#include "CommandLine.h"
 
 glm::quat curQuat;
 glm::quat lastQuat;
@@ -43,11 +66,23 @@ static const float initialScreenHeight = 768.0;
 
 static const std::string SHADER_PATH ("../Resources/Shaders/");
 
+// Linked shader programs, loaded back at startup as long as their sources and the driver are unchanged
+static const std::string SHADER_CACHE_PATH ("../Resources/Shaders/Cache");
+
 static const std::string MATERIAL_PATH ("../Resources/Materials/");
 
 static const std::string DEFAULT_MESH_PATH ("../Resources/Models/");
 
+static const std::string WINDOW_TITLE ("Computer Graphics - Practical Assignment");
+
+// Bytes of mesh attributes sent to the GPU per frame while a new model is uploaded
+static const size_t UPLOAD_BYTES_PER_FRAME = 16 * 1024 * 1024;
+
+// Video memory kept for the maps of the materials already displayed
+static const size_t TEXTURE_CACHE_BUDGET = 256 * 1024 * 1024;
+
 static std::vector<std::string> modelNames;
+static std::string commandLineMeshFilename;
 static std::vector<std::string> materialNames;
 static int meshIndex = 0;
 static int materialIndex = 0;
@@ -57,14 +92,70 @@ using namespace std;
 // Window parameters
 static GLFWwindow * windowPtr = nullptr;
 
+// Offscreen rendering of the headless mode (see renderHeadless): no visible window, the main pass
+// draws to mainFramebuffer
+static bool headless = false;
+static std::unique_ptr<HeadlessContext> headlessContextPtr;
+static GLuint mainFramebuffer = 0; // 0 is the framebuffer of the window
+
 // Pointer to the current camera model
 static std::shared_ptr<Camera> cameraPtr;
 
 // Pointer to the displayed mesh
-static std::shared_ptr<Mesh> meshPtr;
+static std::shared_ptr<GLMesh> meshPtr;
+
+// Model being loaded in the background, then uploaded to the GPU over the next frames, while
+// meshPtr is still displayed. A model requested in the meantime waits in queuedMeshFilename.
+static std::unique_ptr<AsyncMeshLoader> meshLoaderPtr;
+static std::shared_ptr<GLMesh> uploadingMeshPtr;
+static std::string uploadingMeshFilename;
+static std::string queuedMeshFilename;
+
+// Maps of the displayed material (see initTextures), and the next material decoded in the background.
+// Every map uploaded stays in the texture cache as long as the budget allows.
+static std::unique_ptr<TextureCache> textureCachePtr;
+static std::vector<std::shared_ptr<Texture>> materialTextures;
+static int materialTexturesIndex = -1;
+static std::unique_ptr<AsyncTextureLoader> prefetchLoaderPtr;
+static int prefetchMaterialIndex = -1;
 
 // Pointer to GPU shader pipeline i.e., set of shaders structured in a GPU program
 static std::shared_ptr<ShaderProgram> shaderProgramPtr; // A GPU program contains at least a vertex shader and a fragment shader
+static std::shared_ptr<ShaderProgram> depthProgramPtr; // Renders the depth map from the key light
+
+// Programs of the shaders compiled with the options used so far, see selectShaderPrograms
+static std::unique_ptr<ShaderVariants> shaderVariantsPtr;
+
+// Rebuilds the programs in the background when a shader file is saved, see updateShaderReloading
+static std::unique_ptr<ShaderReloader> shaderReloaderPtr;
+
+// Uniform blocks shared by every program: matrices (one instance per render pass) and material
+static std::unique_ptr<UniformBuffer> frameUniformsPtr;
+static std::unique_ptr<UniformBuffer> materialUniformsPtr;
+enum RenderPass { DEPTH_PASS = 0, MAIN_PASS = 1, NUM_RENDER_PASSES = 2 };
+
+// Every light in a storage buffer, binned each frame into the clusters of the view frustum for the PBR mode
+static std::unique_ptr<StorageBuffer> lightStoragePtr;
+static std::unique_ptr<StorageBuffer> clusterStoragePtr;
+static std::unique_ptr<StorageBuffer> clusterLightIndexStoragePtr;
+static std::unique_ptr<StorageBuffer> lightPositionStoragePtr; // In view space, see updateLightPositions
+static std::vector<glm::vec4> lightViewPositions;
+static LightClusters lightClusters;
+static double lightBinningSeconds = 0.0; // Spent in updateLightClusters, for benchmarkLights
+
+// Attenuated intensity below which a light is considered out of reach, see LightSource::computeRange
+static const float LIGHT_MIN_INTENSITY = 0.01f;
+
+// Prints the uniform and program calls made and skipped per frame every second, toggled with U
+static bool callCountersPrinted = false;
+
+// GPU durations of the render passes, printed every second when toggled with K
+static std::unique_ptr<GPUTimer> gpuTimerPtr;
+static bool gpuTimingsPrinted = false;
+static std::ofstream gpuTimingsFile; // Durations of every frame, see --gpu-timings
+
+// Chrome trace of the CPU zones, written when the capture started with C or --profile stops
+static std::string traceFilename ("BaseGL-trace.json");
 
 // Specifies the number of light to use :
 // 1 means there is only a key light
@@ -72,6 +163,10 @@ static std::shared_ptr<ShaderProgram> shaderProgramPtr; // A GPU program contain
 // 3 means there is also a back light
 static int numberLightUsed = 1;
 
+// Point lights scattered around the mesh in addition to the three-point lights, shaded by the PBR mode only
+static int additionalLightCount = 0;
+static const int MAX_ADDITIONAL_LIGHTS = 4096;
+
 // Specifies which render have to be use
 // 0 means PBR rendering
 #define SHADER_MODE_PBR 0
@@ -90,6 +185,16 @@ static int numberLightUsed = 1;
 
 static int subsurfaceScattering = 0;
 
+// Set by benchmarkBrdf only: the PBR mode is shaded as before its fast path, see REFERENCE_SHADING
+static int referenceShading = 0;
+
+// Split-sum table of the PBR mode, on texture unit 5
+static std::shared_ptr<Texture> brdfLookupTablePtr;
+
+// Uniform radiance lighting the PBR mode from every direction, toggled with G
+static glm::vec3 environmentRadiance (0.f);
+static const glm::vec3 ENVIRONMENT_RADIANCE (0.5f);
+
 static int shaderMode = SHADER_MODE_PBR;
 
 static GLuint FramebufferDepth;
@@ -127,12 +232,22 @@ void render();
 
 void initScene(const std::string & meshFilename);
 
+void setupScene ();
+
+void requestScene (const std::string & meshFilename);
+
 void init ();
 
 void clear ();
 
 void initTextures();
 
+void setupAdditionalLights ();
+
+void uploadLights ();
+
+void writeTrace ();
+
 void printHelp ()
 {
 	std::cout << "> Help:" << std::endl
@@ -144,7 +259,7 @@ void printHelp ()
    			  << "    * H: print this help" << std::endl
    			  << "    * F1: toggle wireframe rendering" << std::endl
    			  << "    * ESC: quit the program" << std::endl
-			  << "    * F5: load shader" << std::endl
+			  << "    * F5: reload the model and the shaders (saved shaders are reloaded anyway)" << std::endl
 			  << "    * T: switch between PBR mode and TSM (Toon Shading Mode)" << std::endl
 			  << "    * 1: basic toon shading (default mode of TSM)" << std::endl
 			  << "    * 2: X-Toon shading depth and view-point based (once in TSM)" << std::endl
@@ -152,24 +267,33 @@ void printHelp ()
 			  << "    * 4: X-Toon shading orientation based (once in TSM)" << std::endl
 			  << "    * UP: increment the number of lights to use (max 3)" << std::endl
 			  << "    * DOWN: decrement the number of lights to use (min 1)" << std::endl
+			  << "    * PAGE UP: multiply by 4 the number of additional point lights (PBR, max " << MAX_ADDITIONAL_LIGHTS << ")" << std::endl
+			  << "    * PAGE DOWN: divide by 4 the number of additional point lights" << std::endl
+			  << "    * G: toggle the uniform environment lighting (PBR)" << std::endl
 			  << "    * I: run a laplacian filtering with alpha = 0.1" << std::endl
 			  << "    * O: run a laplacian filtering with alpha = 0.5" << std::endl
 			  << "    * P: run a laplacian filtering with alpha = 1.0" << std::endl
 			  << "    * S: run the simplification with a predefined resolution" << std::endl
-			  << "    * A: run the simplification using an octree" << std::endl;
+			  << "    * A: run the simplification using an octree" << std::endl
+			  << "    * U: print the GL uniform and program calls per frame, issued and skipped as redundant" << std::endl
+			  << "    * K: print the GPU time of the depth and main passes (mean and percentiles of the last frames)" << std::endl
+			  << "    * C: start capturing the CPU time of the frames and mesh operations, or stop and write it as a Chrome trace" << std::endl;
 }
 
 void initModels()
 {
 	modelNames.resize(8);
-	modelNames[0] = (std::string)"/face.off";
-	modelNames[1] = (std::string)"/rhino.off";
-	modelNames[2] = (std::string)"/man.off";
-	modelNames[3] = (std::string)"/denis.off";
-	modelNames[4] = (std::string)"/killeroo.off";
-	modelNames[5] = (std::string)"/sphere.off";
-	modelNames[6] = (std::string)"/monkey.off";
-	modelNames[7] = (std::string)"/dragon.off";
+	modelNames[0] = DEFAULT_MESH_PATH + "face.off";
+	modelNames[1] = DEFAULT_MESH_PATH + "rhino.off";
+	modelNames[2] = DEFAULT_MESH_PATH + "man.off";
+	modelNames[3] = DEFAULT_MESH_PATH + "denis.off";
+	modelNames[4] = DEFAULT_MESH_PATH + "killeroo.off";
+	modelNames[5] = DEFAULT_MESH_PATH + "sphere.off";
+	modelNames[6] = DEFAULT_MESH_PATH + "monkey.off";
+	modelNames[7] = DEFAULT_MESH_PATH + "dragon.off";
+	// A mesh given on the command line (.off, .ply or .obj) is shown first
+	if (!commandLineMeshFilename.empty())
+		modelNames.insert(modelNames.begin(), commandLineMeshFilename);
 }
 
 void initTextureNames()
@@ -182,17 +306,59 @@ void initTextureNames()
 	materialNames[4] = (std::string)"/Skin/";
 }
 
-void loadShaders()
+/// Options of the shaders for a rendering mode. Those the mode does not use keep their default
+/// value, so that they do not multiply its variants.
+ShaderVariantKey shaderVariantKey (int mode)
+{
+	ShaderVariantKey key;
+	key.shaderMode = mode;
+	if (mode == SHADER_MODE_PBR)
+	{
+		key.textureUsing = textureUsing;
+		key.subsurfaceScattering = subsurfaceScattering;
+		key.referenceShading = referenceShading;
+	}
+	if (mode == SHADER_BASIC_TOON || mode == SHADER_ORIENTATION) // PBR reads the lights in use from their clusters
+		key.numberLightUsed = numberLightUsed;
+	if (mode != SHADER_DEPTH_MAPPING && mode != SHADER_DISTANCE_TRAVELED)
+		key.normalMapUsed = normalMapUsed;
+	return key;
+}
+
+/// Called whenever a rendering option changes: selects the programs of the depth and main passes,
+/// built the first time their options are used, and gives them the uniform values of the current
+/// program. The current programs stay in use if a new variant fails to build.
+void selectShaderPrograms()
 {
 	try
 	{
-		shaderProgramPtr = ShaderProgram::genBasicShaderProgram(SHADER_PATH + "VertexShader.glsl",
-			SHADER_PATH + "FragmentShader.glsl");
+		std::shared_ptr<ShaderProgram> programPtr = shaderVariantsPtr->get(shaderVariantKey(shaderMode));
+		std::shared_ptr<ShaderProgram> depthPtr = shaderVariantsPtr->get(shaderVariantKey(SHADER_DEPTH_MAPPING));
+		if (shaderProgramPtr)
+		{
+			if (programPtr != shaderProgramPtr)
+				programPtr->copyUniformsFrom(*shaderProgramPtr);
+			if (depthPtr != shaderProgramPtr)
+				depthPtr->copyUniformsFrom(*shaderProgramPtr);
+		}
+		shaderProgramPtr = programPtr;
+		depthProgramPtr = depthPtr;
 	}
 	catch (std::exception & e)
 	{
-		exitOnCriticalError(std::string("[Error loading shader program]") + e.what());
+		std::cerr << "> [Error building shader variant]" << e.what() << std::endl;
 	}
+	shaderReloaderPtr->setVariants(shaderVariantsPtr->definesList());
+	if (gpuTimerPtr) // Statistics are those of the current options only
+		gpuTimerPtr->clearHistory();
+}
+
+void loadShaders()
+{
+	shaderVariantsPtr = std::make_unique<ShaderVariants>(SHADER_PATH + "VertexShader.glsl", SHADER_PATH + "FragmentShader.glsl", SHADER_CACHE_PATH);
+	selectShaderPrograms();
+	if (!shaderProgramPtr || !depthProgramPtr)
+		exitOnCriticalError("[Error loading shader program]");
 }
 
 void switchShaderMode(int mode)
@@ -207,8 +373,7 @@ void switchShaderMode(int mode)
 	}
 
 	shaderMode = mode;
-	shaderProgramPtr->use();
-	shaderProgramPtr->set("shaderMode",shaderMode);
+	selectShaderPrograms();
 	shaderProgramPtr->set("zMin",zMin);
 	shaderProgramPtr->set("r",r);
 	shaderProgramPtr->set("zFocus",zFocus);
@@ -221,7 +386,6 @@ void windowSizeCallback (GLFWwindow * windowPtr, int width, int height)
 	glViewport (0, 0, (GLint)width, (GLint)height); // Dimension of the rendering region withminin the window
 	screen_height = height;
 	screen_width = width;
-	shaderProgramPtr->use();
 	shaderProgramPtr->set("windowHeight", height);
 	shaderProgramPtr->set("windowRatio", (float)height / (float)width);
 	std::cout << "windowRatio " << (float)height / (float)width << std::endl;
@@ -280,21 +444,37 @@ void keyCallback (GLFWwindow * windowPtr, int key, int scancode, int action, int
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_F5)
 	{
-		loadShaders();
-		initScene(DEFAULT_MESH_PATH+modelNames[meshIndex]);
-		switchShaderMode(shaderMode);
+		shaderReloaderPtr->requestReload(); // Swapped in once linked, see updateShaderReloading
+		requestScene(modelNames[meshIndex]);
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_UP)
 	{
 		numberLightUsed = min(numberLightUsed+1,3);
-		shaderProgramPtr->use();
-		shaderProgramPtr->set("numberLightUsed",numberLightUsed);
+		selectShaderPrograms();
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_DOWN)
 	{
 		numberLightUsed = max(numberLightUsed-1,1);
-		shaderProgramPtr->use();
-		shaderProgramPtr->set("numberLightUsed",numberLightUsed);
+		selectShaderPrograms();
+	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_PAGE_UP)
+	{
+		additionalLightCount = min(max(4*additionalLightCount,16),MAX_ADDITIONAL_LIGHTS);
+		std::cout << "additional lights : " << additionalLightCount << std::endl;
+		setupAdditionalLights();
+		uploadLights();
+	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_PAGE_DOWN)
+	{
+		additionalLightCount = (additionalLightCount > 16 ? additionalLightCount/4 : 0);
+		std::cout << "additional lights : " << additionalLightCount << std::endl;
+		setupAdditionalLights();
+		uploadLights();
+	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_G)
+	{
+		environmentRadiance = (environmentRadiance == glm::vec3(0.f) ? ENVIRONMENT_RADIANCE : glm::vec3(0.f));
+		std::cout << "environment lighting : " << (environmentRadiance != glm::vec3(0.f) ? "on" : "off") << std::endl;
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_RIGHT)
 	{
@@ -302,7 +482,7 @@ void keyCallback (GLFWwindow * windowPtr, int key, int scancode, int action, int
 			meshIndex += 1;
 		else
 			meshIndex = 0;
-		initScene(DEFAULT_MESH_PATH + modelNames[meshIndex]);
+		requestScene(modelNames[meshIndex]);
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_LEFT)
 	{
@@ -316,57 +496,49 @@ void keyCallback (GLFWwindow * windowPtr, int key, int scancode, int action, int
 	{
 		zMin = zMin - meshScale/30;
 		std::cout<<"zMin : "<<zMin<<std::endl;
-		shaderProgramPtr->use();
 		shaderProgramPtr->set("zMin",zMin);
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_W)
 	{
 		zMin = min(zMin + meshScale/30,meshPtr->getZMin());
 		std::cout<<"zMin : "<<zMin<<std::endl;
-		shaderProgramPtr->use();
 		shaderProgramPtr->set("zMin",zMin);
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_E)
 	{
 		r = max(r - float(0.05),float(1.001));
 		std::cout<<"r value : "<<r<<std::endl;
-		shaderProgramPtr->use();
 		shaderProgramPtr->set("r",r);
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_R)
 	{
 		r = r + 0.05;
 		std::cout<<"r value : "<<r<<std::endl;
-		shaderProgramPtr->use();
 		shaderProgramPtr->set("r",r);
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_D)
 	{
 		zFocus = min(zFocus - meshScale/10,0.0f);
 		std::cout<<"z of focus point : "<<zFocus<<std::endl;
-		shaderProgramPtr->use();
 		shaderProgramPtr->set("zFocus",zFocus);
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_F)
 {
 		zFocus = zFocus + meshScale/10;
 		std::cout<<"z of focus point : "<<zFocus<<std::endl;
-		shaderProgramPtr->use();
 		shaderProgramPtr->set("zFocus",zFocus);
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_N)
 	{
 		std::cout << "normal mapping"<< std::endl;
 		normalMapUsed = 1-normalMapUsed;
-		shaderProgramPtr->use();
-		shaderProgramPtr->set("normalMapUsed",normalMapUsed);
+		selectShaderPrograms();
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_X)
 {
 		std::cout << "texture using" <<std::endl;
 		textureUsing = 1-textureUsing;
-		shaderProgramPtr->use();
-		shaderProgramPtr->set("textureUsing",textureUsing);
+		selectShaderPrograms();
 	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_I)
 {
@@ -400,6 +572,26 @@ void keyCallback (GLFWwindow * windowPtr, int key, int scancode, int action, int
 		std::cout << "run a subdivision according loop scheme" << std::endl;
 		meshPtr->subdivide();
 	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_U)
+	{
+		callCountersPrinted = !callCountersPrinted;
+		ShaderProgram::resetCallCounters();
+	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_K)
+	{
+		gpuTimingsPrinted = !gpuTimingsPrinted;
+	}
+	else if (action == GLFW_PRESS && key == GLFW_KEY_C)
+	{
+		if (Profiler::isEnabled())
+			writeTrace();
+		else
+		{
+			Profiler::clear();
+			Profiler::setEnabled(true);
+			std::cout << " > Capturing a CPU trace, press C again to write it" << std::endl;
+		}
+	}
 	else if (action == GLFW_PRESS && key == GLFW_KEY_B)
 	{
 		std::cout << "use subsurface scattering" << std::endl;
@@ -411,8 +603,7 @@ void keyCallback (GLFWwindow * windowPtr, int key, int scancode, int action, int
 		{
 			subsurfaceScattering = subsurfaceScattering + 1;
 		}
-		shaderProgramPtr->use();
-		shaderProgramPtr->set("subsurfaceScattering", subsurfaceScattering);
+		selectShaderPrograms();
 	}
 }
 
@@ -494,9 +685,10 @@ void initGLFW () {
 	glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, 5);
 	glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint (GLFW_RESIZABLE, GL_TRUE);
+	glfwWindowHint (GLFW_VISIBLE, headless ? GL_FALSE : GL_TRUE);
 
 	// Create the window
-	windowPtr = glfwCreateWindow (1024, 768, "Computer Graphics - Practical Assignment", nullptr, nullptr);
+	windowPtr = glfwCreateWindow (screen_width, screen_height, WINDOW_TITLE.c_str (), nullptr, nullptr);
 	if (!windowPtr)
 	{
 		std::cerr << "ERROR: Failed to open window" << std::endl;
@@ -514,6 +706,21 @@ void initGLFW () {
 	glfwSetMouseButtonCallback (windowPtr, mouseButtonCallback);
 }
 
+/// Context of the headless mode: surfaceless EGL when available, else a hidden GLFW window, which is
+/// offscreen as well when GLFW is built with GLFW_USE_OSMESA
+void initHeadlessContext () {
+	try
+	{
+		headlessContextPtr = std::make_unique<HeadlessContext> (4, 5);
+		std::cout << " > Headless context: " << headlessContextPtr->description () << std::endl;
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "> [Error creating headless context]" << e.what () << ", using a hidden window" << std::endl;
+		initGLFW ();
+	}
+}
+
 void exitOnCriticalError (const std::string & message) {
 	std::cerr << "> [Critical error]" << message << std::endl;
 	std::cerr << "> [Clearing resources]" << std::endl;
@@ -522,9 +729,26 @@ void exitOnCriticalError (const std::string & message) {
 	std::exit (EXIT_FAILURE);
 }
 
+/// Uploads the split-sum table of the PBR mode, computed once and then read from the shader cache directory
+void initBRDFLookupTable () {
+	const unsigned int size = 128;
+	std::vector<glm::vec2> table = BRDFLookupTable::load (SHADER_CACHE_PATH, size);
+	GLuint id;
+	glCreateTextures (GL_TEXTURE_2D, 1, &id);
+	glTextureStorage2D (id, 1, GL_RG16F, size, size);
+	glTextureSubImage2D (id, 0, 0, 0, size, size, GL_RG, GL_FLOAT, table.data ());
+	glTextureParameteri (id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri (id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri (id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri (id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTextureUnit (5, id); // Unit given by the layout of brdfLookupTable in FragmentShader.glsl
+	brdfLookupTablePtr = std::make_shared<Texture> (id, size_t (size) * size * 4);
+}
+
 void initOpenGL () {
 	// Load extensions for modern OpenGL
-	if (!gladLoadGLLoader ((GLADloadproc)glfwGetProcAddress))
+	GLADloadproc getProcAddress = (headlessContextPtr ? (GLADloadproc)HeadlessContext::getProcAddress : (GLADloadproc)glfwGetProcAddress);
+	if (!gladLoadGLLoader (getProcAddress))
 		exitOnCriticalError ("[Failed to initialize OpenGL context]");
 
 	glEnable (GL_DEBUG_OUTPUT); // Modern error callback functionnality
@@ -537,82 +761,360 @@ void initOpenGL () {
 	glClearColor (0.0f, 0.0f, 0.0f, 1.0f); // specify the background color, used any time the framebuffer is cleared
 	// Loads and compile the programmable shader pipeline
 
+	shaderReloaderPtr = std::make_unique<ShaderReloader> (SHADER_PATH + "VertexShader.glsl", SHADER_PATH + "FragmentShader.glsl");
 	loadShaders();
+
+	frameUniformsPtr = std::make_unique<UniformBuffer> (UniformBlocks::FRAME_BINDING, sizeof (UniformBlocks::FrameBlock), 2);
+	materialUniformsPtr = std::make_unique<UniformBuffer> (UniformBlocks::MATERIAL_BINDING, sizeof (UniformBlocks::MaterialBlock));
+	materialUniformsPtr->bind ();
+	lightStoragePtr = std::make_unique<StorageBuffer> (UniformBlocks::LIGHTS_BINDING);
+	clusterStoragePtr = std::make_unique<StorageBuffer> (UniformBlocks::CLUSTERS_BINDING);
+	clusterLightIndexStoragePtr = std::make_unique<StorageBuffer> (UniformBlocks::CLUSTER_LIGHT_INDICES_BINDING);
+	lightPositionStoragePtr = std::make_unique<StorageBuffer> (UniformBlocks::LIGHT_POSITIONS_BINDING);
+	lightStoragePtr->bind ();
+	clusterStoragePtr->bind ();
+	clusterLightIndexStoragePtr->bind ();
+	lightPositionStoragePtr->bind ();
+	gpuTimerPtr = std::make_unique<GPUTimer> (NUM_RENDER_PASSES);
+	initBRDFLookupTable ();
 }
 
+/// Maps of a material in texture unit order, from unit 1; the normal map keeps X and Y only (see loadNormalMap).
+/// Only the first channel of the occlusion, roughness and metallic maps is packed, whatever their
+/// layout (Skin2 stores them in RGBA). Missing maps (Skin has no base color, metallic nor normal
+/// map) fall back to the values of the untextured material.
+std::vector<AsyncTextureLoader::Request> materialTextureRequests (int index)
+{
+	const std::string path = MATERIAL_PATH + materialNames[index];
+	return {
+		{ path + "Base_Color.png", false, {}, { 255, 204, 153 } },
+		{ ormFilename (path), false, ormSources (path), ormDefaults () },
+		{ normalMapFilename (path), true, {}, {} },
+		{ MATERIAL_PATH + "Style.png", false, {}, {} }
+	};
+}
+
+/// Binds the maps of the current material. Those missing from the texture cache are decoded in
+/// parallel, or taken from the prefetch of the previous switch, and uploaded first.
 void initTextures()
 {
-	shaderProgramPtr->use();
+	PROFILE_ZONE ("initTextures");
+	if (materialTexturesIndex != materialIndex)
+	{
+		try
+		{
+			std::vector<AsyncTextureLoader::Request> requests = materialTextureRequests (materialIndex);
+			std::vector<std::shared_ptr<Texture>> textures (requests.size ());
+			std::vector<AsyncTextureLoader::Request> misses;
+			for (size_t i = 0; i < requests.size (); i++)
+			{
+				textures[i] = textureCachePtr->find (requests[i].filename, requests[i].isNormalMap);
+				if (!textures[i])
+					misses.push_back (requests[i]);
+			}
+
+			std::vector<std::unique_ptr<TextureImage>> images;
+			if (prefetchLoaderPtr && prefetchMaterialIndex == materialIndex)
+				images = prefetchLoaderPtr->takeImages (); // Usually decoded already
+			else if (!misses.empty ())
+				images = AsyncTextureLoader (misses).takeImages ();
+			prefetchLoaderPtr.reset ();
+
+			for (size_t i = 0; i < requests.size (); i++)
+			{
+				if (textures[i])
+					continue;
+				auto imageIt = std::find_if (images.begin (), images.end (), [&] (const std::unique_ptr<TextureImage> & image) {
+					return image->filename () == requests[i].filename;
+				});
+				if (imageIt != images.end ())
+					textures[i] = textureCachePtr->insert (**imageIt, requests[i].isNormalMap);
+				else // Cached when the prefetch was planned, evicted since
+					textures[i] = textureCachePtr->insert (*AsyncTextureLoader::load (requests[i]), requests[i].isNormalMap);
+			}
+			materialTextures = textures; // Only once every map is in, the previous ones becoming evictable
+			materialTexturesIndex = materialIndex;
+		}
+		catch (std::exception & e) // The previous maps stay bound
+		{
+			std::cerr << "> [Error loading material]" << e.what () << std::endl;
+		}
 
-	bool isMetallicRGBA = false;
-	bool isBaseColorRGBA = false;
+		// The maps of the next material of the LEFT key cycle are decoded while this one is displayed
+		prefetchMaterialIndex = (materialIndex + 1) % materialNames.size ();
+		std::vector<AsyncTextureLoader::Request> prefetches;
+		for (const AsyncTextureLoader::Request & request : materialTextureRequests (prefetchMaterialIndex))
+			if (!textureCachePtr->contains (request.filename, request.isNormalMap))
+				prefetches.push_back (request);
+		if (!prefetches.empty ())
+			prefetchLoaderPtr = std::make_unique<AsyncTextureLoader> (prefetches);
+
+		std::cout << " > Texture cache: " << textureCachePtr->size () << " textures, "
+				  << textureCachePtr->bytes () / (1024 * 1024) << " MB of " << textureCachePtr->budget () / (1024 * 1024) << " MB, "
+				  << textureCachePtr->hits () << " hits, " << textureCachePtr->misses () << " misses, "
+				  << textureCachePtr->evictions () << " evictions" << std::endl;
+	}
 
-	if (materialNames[materialIndex] == "Skin2/")
+	for (size_t i = 0; i < materialTextures.size (); i++) // Units given by the layout of the samplers in FragmentShader.glsl
 	{
-		isMetallicRGBA = true;
+		glActiveTexture(GL_TEXTURE1 + i);
+		glBindTexture(GL_TEXTURE_2D, materialTextures[i]->id ());
 	}
-	if (materialNames[materialIndex] == "Skin/")
+	glActiveTexture(GL_TEXTURE0); // Later binds, e.g. of the depth pass texture, would replace the tone map otherwise
+}
+
+/// Loads the first model synchronously: there is nothing to display before it
+void initScene (const std::string & meshFilename) {
+	meshPtr = std::make_shared<GLMesh> ();
+
+	try
 	{
-		isBaseColorRGBA = true;
+		MeshLoader::loadCached (meshFilename, meshPtr);
 	}
+	catch (std::exception & e)
+	{
+		exitOnCriticalError (std::string ("[Error loading mesh]") + e.what ());
+	}
+	meshPtr->init ();
+	setupScene ();
+}
 
-	GLuint albedoTex = loadTextureFromFileToGPU(MATERIAL_PATH + materialNames[materialIndex] + "Base_Color.png", isBaseColorRGBA);
-	GLuint roughnessTex = loadTextureFromFileToGPU(MATERIAL_PATH + materialNames[materialIndex] + "Roughness.png", false);
-	GLuint metallicTex = loadTextureFromFileToGPU(MATERIAL_PATH + materialNames[materialIndex] + "Metallic.png", isMetallicRGBA);
-	GLuint ambientTex = loadTextureFromFileToGPU(MATERIAL_PATH + materialNames[materialIndex] + "Ambient_Occlusion.png", false);
-	GLuint normalTex = loadTextureFromFileToGPU(MATERIAL_PATH + materialNames[materialIndex] + "Normal.png", true);
-	GLuint toneTex = loadTextureFromFileToGPU(MATERIAL_PATH + "Style.png", false);
-
-	shaderProgramPtr->set("material.albedoTex", 1);
-	shaderProgramPtr->set("material.roughnessTex", 2);
-	shaderProgramPtr->set("material.metallicTex", 3);
-	shaderProgramPtr->set("material.ambientTex", 4);
-	shaderProgramPtr->set("material.normalTex", 5);
-	shaderProgramPtr->set("material.toneTex", 6);
+/// Starts loading a model in the background, see updateSceneLoading
+void requestScene (const std::string & meshFilename)
+{
+	if (meshLoaderPtr || uploadingMeshPtr)
+	{
+		queuedMeshFilename = meshFilename; // Only the latest request matters
+		return;
+	}
+	meshLoaderPtr = std::make_unique<AsyncMeshLoader> (meshFilename);
+}
 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, albedoTex);
+/// Called once per frame: hands a loaded model over to the GPU upload, uploads a slice of it,
+/// and swaps it in place of the displayed mesh once it is complete. Progress goes to the window title.
+void updateSceneLoading ()
+{
+	if (meshLoaderPtr && meshLoaderPtr->isReady ())
+	{
+		try
+		{
+			uploadingMeshPtr = meshLoaderPtr->takeMesh ();
+			uploadingMeshFilename = meshLoaderPtr->filename ();
+		}
+		catch (std::exception & e) // The current model stays on screen
+		{
+			std::cerr << "> [Error loading mesh]" << e.what () << std::endl;
+		}
+		meshLoaderPtr.reset ();
+	}
 
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, roughnessTex);
+	if (uploadingMeshPtr && uploadingMeshPtr->upload (UPLOAD_BYTES_PER_FRAME))
+	{
+		meshPtr = uploadingMeshPtr; // The previous mesh is released here, on the thread owning its GL objects
+		uploadingMeshPtr.reset ();
+		setupScene ();
+	}
 
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, metallicTex);
+	if (!meshLoaderPtr && !uploadingMeshPtr && !queuedMeshFilename.empty ())
+	{
+		requestScene (queuedMeshFilename);
+		queuedMeshFilename.clear ();
+	}
 
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, ambientTex);
+	static std::string currentTitle = WINDOW_TITLE;
+	std::string title = WINDOW_TITLE;
+	if (meshLoaderPtr)
+		title += " - Loading " + meshLoaderPtr->filename () + " " + std::to_string (static_cast<int> (100.f * meshLoaderPtr->progress ())) + "%";
+	else if (uploadingMeshPtr)
+		title += " - Uploading " + uploadingMeshFilename + " " + std::to_string (static_cast<int> (100.f * uploadingMeshPtr->uploadProgress ())) + "%";
+	if (title != currentTitle)
+	{
+		glfwSetWindowTitle (windowPtr, title.c_str ());
+		currentTitle = title;
+	}
+}
 
-	glActiveTexture(GL_TEXTURE5);
-	glBindTexture(GL_TEXTURE_2D, normalTex);
+/// Called once per frame: swaps in the variants rebuilt from edited shader files once they are all
+/// linked, giving them the uniform values of the current program. Nothing else is reloaded.
+void updateShaderReloading ()
+{
+	ShaderReloader::Programs reloadedPrograms = shaderReloaderPtr->update ();
+	if (reloadedPrograms.empty ())
+		return;
+	for (const auto & [defines, programPtr] : reloadedPrograms)
+		shaderVariantsPtr->replace (defines, programPtr);
+	selectShaderPrograms ();
+}
 
-	glActiveTexture(GL_TEXTURE6);
-	glBindTexture(GL_TEXTURE_2D, toneTex);
+/// Called once per frame: every second, prints the average calls per frame made by ShaderProgram, if enabled
+void updateCallCounters ()
+{
+	static int numFrames = 0;
+	static double lastPrintTime = glfwGetTime ();
+	if (!callCountersPrinted)
+	{
+		numFrames = 0;
+		lastPrintTime = glfwGetTime ();
+		return;
+	}
+	numFrames++;
+	if (glfwGetTime () - lastPrintTime < 1.0)
+		return;
+	const ShaderProgram::CallCounters & counters = ShaderProgram::callCounters ();
+	std::cout << " > Per frame: " << double (counters.uniformCalls) / numFrames << " uniform calls issued, "
+			  << double (counters.elidedUniformCalls) / numFrames << " skipped; " << double (counters.useCalls) / numFrames
+			  << " program binds issued, " << double (counters.elidedUseCalls) / numFrames << " skipped; "
+			  << double (UniformBuffer::uploadCounter ()) / numFrames << " uniform buffer uploads, "
+			  << double (StorageBuffer::uploadCounter ()) / numFrames << " storage buffer uploads" << std::endl;
+	ShaderProgram::resetCallCounters ();
+	UniformBuffer::resetUploadCounter ();
+	StorageBuffer::resetUploadCounter ();
+	numFrames = 0;
+	lastPrintTime = glfwGetTime ();
 }
 
-void initScene (const std::string & meshFilename) {
-	// Camera
-	int width, height;
-	glfwGetWindowSize (windowPtr, &width, &height);
-	cameraPtr = std::make_shared<Camera> ();
-	cameraPtr->setAspectRatio (static_cast<float>(width) / static_cast<float>(height));
+/// Called once per frame: writes the GPU durations read back to the --gpu-timings file, and every
+/// second prints their statistics over the last frames rendered with the current options, if enabled
+void updateGPUTimings ()
+{
+	std::vector<GPUTimer::Frame> frames = gpuTimerPtr->takeFrames ();
+	if (gpuTimingsFile.is_open ())
+	{
+		for (const GPUTimer::Frame & frame : frames)
+		{
+			gpuTimingsFile << frame.index << ',' << frame.tag;
+			for (double milliseconds : frame.passMilliseconds)
+				gpuTimingsFile << ',' << milliseconds;
+			gpuTimingsFile << '\n';
+		}
+	}
 
-	// Mesh
-	meshPtr = std::make_shared<Mesh> ();
+	static double lastPrintTime = glfwGetTime ();
+	if (!gpuTimingsPrinted || glfwGetTime () - lastPrintTime < 1.0)
+		return;
+	static const char * passNames[NUM_RENDER_PASSES] = { "depth pass", "main pass" };
+	std::cout << " > GPU time (shader mode " << shaderMode << ")";
+	for (int pass = 0; pass < NUM_RENDER_PASSES; pass++)
+	{
+		GPUTimer::Statistics statistics = gpuTimerPtr->statistics (pass);
+		std::cout << (pass == 0 ? ": " : "; ") << passNames[pass] << " " << statistics.mean << " ms mean, " << statistics.median << " median, "
+				  << statistics.p95 << " p95, " << statistics.p99 << " p99, " << statistics.max << " max";
+	}
+	std::cout << " (last " << gpuTimerPtr->statistics (MAIN_PASS).count << " frames, " << gpuTimerPtr->numSkippedFrames () << " skipped)" << std::endl;
+	lastPrintTime = glfwGetTime ();
+}
 
+/// Writes the CPU zones captured since the C key or the start with --profile, and stops the capture
+void writeTrace ()
+{
+	Profiler::setEnabled (false);
 	try
 	{
-		MeshLoader::loadOFF (meshFilename, meshPtr);
+		Profiler::writeChromeTrace (traceFilename);
+		std::cout << " > CPU trace written to " << traceFilename << ", to open in ui.perfetto.dev or chrome://tracing" << std::endl;
 	}
 	catch (std::exception & e)
 	{
-		exitOnCriticalError (std::string ("[Error loading mesh]") + e.what ());
+		std::cerr << "> [Error writing trace]" << e.what () << std::endl;
 	}
-	meshPtr->init ();
+}
+
+/// Element of the Lights storage buffer
+UniformBlocks::Light lightData (LightSource & light)
+{
+	UniformBlocks::Light data = {};
+	data.color = light.getColor();
+	data.intensity = light.getIntensity();
+	data.distanceAttenuation = light.getDistanceAttenuation();
+	data.coneAngle = light.getConeAngle();
+	data.position = light.getTranslation();
+	data.radialAttenuation = light.getRadialAttenuation();
+	return data;
+}
+
+/// Scatters the additional point lights in a sphere around the mesh, each reaching a fifth of its
+/// size. Lights come from the same random sequence whatever their number, so that adding lights
+/// keeps the previous ones in place.
+void setupAdditionalLights ()
+{
+	lightSources.resize (3 + additionalLightCount);
+	std::mt19937 generator (1);
+	std::uniform_real_distribution<float> coordinate (-1.f, 1.f);
+	std::uniform_real_distribution<float> channel (0.2f, 1.f);
+	float range = 0.4f * meshScale;
+	for (int i = 0; i < additionalLightCount; i++)
+	{
+		glm::vec3 offset;
+		do
+			offset = glm::vec3 (coordinate (generator), coordinate (generator), coordinate (generator));
+		while (glm::length (offset) > 1.f);
+		glm::vec3 color (channel (generator), channel (generator), channel (generator));
+		auto lightPtr = std::make_shared<LightSource> ();
+		lightPtr->setColor(color);
+		lightPtr->setIntensity(2.f);
+		lightPtr->setConeAngle(M_PI);
+		lightPtr->setRadialAttenuation(1.f);
+		// Quadratic falloff down to LIGHT_MIN_INTENSITY at range, for the brightest channel
+		float peak = 2.f * std::max (color.r, std::max (color.g, color.b));
+		lightPtr->setDistanceAttenuation(glm::vec3(1.f, 0.f, (peak / LIGHT_MIN_INTENSITY - 1.f) / (range * range)));
+		lightPtr->setTranslation(center + 1.5f * meshScale * offset);
+		lightSources[3 + i] = lightPtr;
+	}
+}
+
+/// Uploads every light to the storage buffer read by the shaders
+void uploadLights ()
+{
+	std::vector<UniformBlocks::Light> lights;
+	lights.reserve (lightSources.size ());
+	for (const std::shared_ptr<LightSource> & lightPtr : lightSources)
+		lights.push_back (lightData (*lightPtr));
+	lightStoragePtr->set (lights);
+}
+
+/// Called once per frame: transforms every light to view space, uploaded if the camera, the mesh or a light moved
+void updateLightPositions (const glm::mat4 & modelViewMatrix)
+{
+	lightViewPositions.resize (lightSources.size ());
+	for (size_t i = 0; i < lightSources.size (); i++)
+		lightViewPositions[i] = modelViewMatrix * glm::vec4 (lightSources[i]->getTranslation (), 1.f);
+	lightPositionStoragePtr->set (lightViewPositions);
+}
+
+/// Called once per frame in PBR mode, after updateLightPositions: bins the three-point lights in use
+/// and the additional lights into the clusters of the view frustum, uploaded if they changed
+void updateLightClusters (const glm::mat4 & projectionMatrix)
+{
+	auto start = std::chrono::high_resolution_clock::now ();
+	static std::vector<LightClusters::Light> lights;
+	lights.clear ();
+	for (size_t i = 0; i < lightSources.size (); i++)
+	{
+		if (i < 3 && int (i) >= numberLightUsed)
+			continue;
+		LightClusters::Light light;
+		light.position = glm::vec3 (lightViewPositions[i]);
+		light.range = lightSources[i]->computeRange (LIGHT_MIN_INTENSITY);
+		light.index = static_cast<uint32_t> (i);
+		lights.push_back (light);
+	}
+	lightClusters.build (lights, projectionMatrix, cameraPtr->getNear (), cameraPtr->getFar ());
+	clusterStoragePtr->set (lightClusters.clusters ());
+	clusterLightIndexStoragePtr->set (lightClusters.lightIndices ());
+	lightBinningSeconds += std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+}
+
+/// Fits the camera, lights and material to the displayed mesh
+void setupScene () {
+	// Camera
+	int width = screen_width, height = screen_height;
+	if (windowPtr)
+		glfwGetWindowSize (windowPtr, &width, &height);
+	cameraPtr = std::make_shared<Camera> ();
+	cameraPtr->setAspectRatio (static_cast<float>(width) / static_cast<float>(height));
 
 	meshPtr->computeBoundingSphere (center, meshScale);
 
-	shaderProgramPtr->use();
-	shaderProgramPtr->set("meshCenter", center);
 	shaderProgramPtr->set("windowHeight", height);
 	shaderProgramPtr->set("windowRatio", (float)height / (float)width);
 
@@ -626,11 +1128,6 @@ void initScene (const std::string & meshFilename) {
 	lightSources.at(0)->setRadialAttenuation(1.f);
 	lightSources.at(0)->setDistanceAttenuation(glm::vec3(1,0.000001,0.0000001));
 	lightSources.at(0)->setTranslation(center+glm::vec3(0.0, 0.0, 3.0*meshScale));
-	shaderProgramPtr->set ("keyLight.color", lightSources.at(0)->getColor());
-	shaderProgramPtr->set ("keyLight.intensity", lightSources.at(0)->getIntensity());
-	shaderProgramPtr->set ("keyLight.coneAngle", lightSources.at(0)->getConeAngle());
-	shaderProgramPtr->set ("keyLight.radialAttenuation", lightSources.at(0)->getRadialAttenuation());
-	shaderProgramPtr->set ("keyLight.distanceAttenuation", lightSources.at(0)->getDistanceAttenuation());
 
 
 	// Fill light
@@ -642,11 +1139,6 @@ void initScene (const std::string & meshFilename) {
 	lightSources.at(1)->setRadialAttenuation(1.f);
 	lightSources.at(1)->setDistanceAttenuation(glm::vec3(1,0.000001,0.0000001));
 	lightSources.at(1)->setTranslation(center+glm::vec3(-7.0*meshScale, 0.0, 7.0*meshScale));
-	shaderProgramPtr->set ("fillLight.color", lightSources.at(1)->getColor());
-	shaderProgramPtr->set ("fillLight.intensity", lightSources.at(1)->getIntensity());
-	shaderProgramPtr->set ("fillLight.coneAngle", lightSources.at(1)->getConeAngle());
-	shaderProgramPtr->set ("fillLight.radialAttenuation", lightSources.at(1)->getRadialAttenuation());
-	shaderProgramPtr->set ("fillLight.distanceAttenuation", lightSources.at(1)->getDistanceAttenuation());
 
 	// Back light
 
@@ -657,13 +1149,10 @@ void initScene (const std::string & meshFilename) {
 	lightSources.at(2)->setRadialAttenuation(1.f);
 	lightSources.at(2)->setDistanceAttenuation(glm::vec3(1,0.000001,0.0000001));
 	lightSources.at(2)->setTranslation(center+glm::vec3(7.0*meshScale, 0.0, -7.0*meshScale));
-	shaderProgramPtr->set ("backLight.color", lightSources.at(2)->getColor());
-	shaderProgramPtr->set ("backLight.intensity", lightSources.at(2)->getIntensity());
-	shaderProgramPtr->set ("backLight.coneAngle", lightSources.at(2)->getConeAngle());
-	shaderProgramPtr->set ("backLight.radialAttenuation", lightSources.at(2)->getRadialAttenuation());
-	shaderProgramPtr->set ("backLight.distanceAttenuation", lightSources.at(2)->getDistanceAttenuation());
 
-	shaderProgramPtr->set ("numberLightUsed", numberLightUsed);
+	// Additional lights
+	setupAdditionalLights();
+	uploadLights();
 
 	// Material
 	materialPtr = std::make_shared<Material> ();
@@ -671,10 +1160,13 @@ void initScene (const std::string & meshFilename) {
 	materialPtr->setKd(0.2);
 	materialPtr->setMetallic(0.1);
 	materialPtr->setRoughness(0.6);
-	shaderProgramPtr->set ("material.kd", materialPtr->getKd());
-	shaderProgramPtr->set ("material.albedo", materialPtr->getAlbedo());
-	shaderProgramPtr->set ("material.metallic", materialPtr->getMetallic());
-	shaderProgramPtr->set ("material.roughness", materialPtr->getRoughness());
+	UniformBlocks::MaterialBlock materialBlock = {};
+	materialBlock.albedo = materialPtr->getAlbedo();
+	materialBlock.kd = materialPtr->getKd();
+	materialBlock.metallic = materialPtr->getMetallic();
+	materialBlock.roughness = materialPtr->getRoughness();
+	materialUniformsPtr->set (materialBlock);
+	materialUniformsPtr->flush ();
 	
 	initTextures();
 
@@ -683,7 +1175,6 @@ void initScene (const std::string & meshFilename) {
 	cameraPtr->setNear (meshScale / 100.f);
 	cameraPtr->setFar (6.f * meshScale);
 
-	shaderProgramPtr->set("textureUsing",textureUsing);
 	zMin = -300.0f;
 	zFocus = -80.0f;
 	r = 1.6f;
@@ -748,19 +1239,40 @@ void init ()
 {
 	initTextureNames();
 	initModels();
-	initGLFW (); // Windowing system
+	if (headless)
+		initHeadlessContext (); // No windowing system
+	else
+		initGLFW (); // Windowing system
 	initOpenGL (); // OpenGL Context and shader pipeline
-	initScene (DEFAULT_MESH_PATH+modelNames[meshIndex]); // Actual scene to render
+	textureCachePtr = std::make_unique<TextureCache> (TEXTURE_CACHE_BUDGET);
+	initScene (modelNames[meshIndex]); // Actual scene to render
 	initTextureBuffer();
 }
 
 void clear ()
 {
 	cameraPtr.reset ();
+	meshLoaderPtr.reset (); // Waits for a load in progress
+	uploadingMeshPtr.reset ();
 	meshPtr.reset ();
+	prefetchLoaderPtr.reset ();
+	materialTextures.clear ();
+	textureCachePtr.reset ();
+	brdfLookupTablePtr.reset ();
+	frameUniformsPtr.reset ();
+	materialUniformsPtr.reset ();
+	lightStoragePtr.reset ();
+	clusterStoragePtr.reset ();
+	clusterLightIndexStoragePtr.reset ();
+	lightPositionStoragePtr.reset ();
+	gpuTimerPtr.reset ();
 	shaderProgramPtr.reset ();
+	depthProgramPtr.reset ();
+	shaderVariantsPtr.reset ();
+	shaderReloaderPtr.reset ();
 	glfwDestroyWindow (windowPtr);
 	glfwTerminate ();
+	headlessContextPtr.reset ();
 }
 
 // The main rendering call
@@ -777,40 +1289,60 @@ void render ()
 	glm::mat4 modelViewMatrixFromLight = viewMatrixFromLight * modelMatrix;
 	glm::mat4 normalMatrixFromLight = glm::transpose(glm::inverse(modelViewMatrixFromLight));
 
+	updateLightPositions(modelViewMatrix);
+	if (shaderMode == SHADER_MODE_PBR)
+		updateLightClusters(projectionMatrix);
+
+	// Both passes have their own instance of the Frame uniform block, uploaded only when the camera, the mesh or the light moved
+	UniformBlocks::FrameBlock depthPass = {};
+	depthPass.projectionMat = projectionMatrix;
+	depthPass.modelViewMat = modelViewMatrixFromLight;
+	depthPass.normalMat = normalMatrixFromLight;
+	depthPass.modelViewMatFromLight = modelViewMatrixFromLight;
+	depthPass.normalMatFromLight = normalMatrixFromLight;
+	depthPass.meshCenterFromLight = modelViewMatrixFromLight * glm::vec4(center, 1.0);
+	depthPass.meshCenter = center;
+	depthPass.fov = cameraPtr->getFov();
+	depthPass.aspectRatio = cameraPtr->getAspectRatio();
+	depthPass.clusterDepthScale = lightClusters.depthScale();
+	depthPass.clusterDepthBias = lightClusters.depthBias();
+	depthPass.clusterCount = glm::uvec4(lightClusters.size(), 0);
+	depthPass.viewportSize = glm::vec2(screen_width, screen_height);
+	depthPass.environmentRadiance = environmentRadiance;
+	UniformBlocks::FrameBlock mainPass = depthPass;
+	mainPass.modelViewMat = modelViewMatrix;
+	mainPass.normalMat = normalMatrix;
+	frameUniformsPtr->set(depthPass, DEPTH_PASS);
+	frameUniformsPtr->set(mainPass, MAIN_PASS);
+	frameUniformsPtr->flush();
+
+	gpuTimerPtr->beginFrame(shaderMode);
+
 	/* Render in texture the depth map. */
 	glBindFramebuffer(GL_FRAMEBUFFER, FramebufferDepth);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	gpuTimerPtr->beginPass(DEPTH_PASS);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Erase the color and z buffers.
 
-	shaderProgramPtr->use(); // Activate the program to be used for upcoming primitive
-	shaderProgramPtr->set("projectionMat", projectionMatrix); // Compute the projection matrix of the camera and pass it to the GPU program
-	shaderProgramPtr->set("modelViewMat", modelViewMatrixFromLight);
-	shaderProgramPtr->set("modelViewMatFromLight", modelViewMatrixFromLight);
-	shaderProgramPtr->set("meshCenterFromLight", modelViewMatrixFromLight * glm::vec4(center, 1.0));
-	shaderProgramPtr->set("normalMat", normalMatrixFromLight);
-	shaderProgramPtr->set("normalMatFromLight", normalMatrixFromLight);
-	shaderProgramPtr->set("shaderMode", SHADER_DEPTH_MAPPING);
-	shaderProgramPtr->set("keyLightPosition", lightSources.at(0)->getTranslation());
-	shaderProgramPtr->set("fillLightPosition", lightSources.at(1)->getTranslation());
-	shaderProgramPtr->set("backLightPosition", lightSources.at(2)->getTranslation());
-	shaderProgramPtr->set("fov", cameraPtr->getFov()); 
-	shaderProgramPtr->set("aspectRatio", cameraPtr->getAspectRatio());
+	depthProgramPtr->use(); // Activate the program to be used for upcoming primitive
+	frameUniformsPtr->bind(DEPTH_PASS);
 	meshPtr->render();
+	gpuTimerPtr->endPass();
 	
 	/* Render to screen. */
 	//glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, (GLint)screen_width, (GLint)screen_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, mainFramebuffer);
 	glViewport(0, 0, (GLint)screen_width, (GLint)screen_height); // Render on the whole framebuffer, complete from the lower left corner to the upper right
+	gpuTimerPtr->beginPass(MAIN_PASS);
 	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Erase the color and z buffers.
 	shaderProgramPtr->use (); // Activate the program to be used for upcoming primitive
-	shaderProgramPtr->set("projectionMat", projectionMatrix); // Compute the projection matrix of the camera and pass it to the GPU program
-	shaderProgramPtr->set("modelViewMat", modelViewMatrix);
-	shaderProgramPtr->set("normalMat", normalMatrix);
-	shaderProgramPtr->set("shaderMode", shaderMode);
+	frameUniformsPtr->bind(MAIN_PASS);
 	meshPtr->render ();
+	gpuTimerPtr->endPass();
 
 	shaderProgramPtr->stop();
+	gpuTimerPtr->endFrame();
 }
 
 // Update any accessible variable based on the current time
@@ -828,24 +1360,365 @@ void update (float currentTime)
 
 void usage (const char * command)
 {
-	std::cerr << "Usage : " << command << " [<file.off>]" << std::endl;
+	std::cerr << "Usage : " << command << " [--gpu-timings <timings.csv>] [--profile <trace.json>] [<file.off|file.ply|file.obj|file.qmesh>]" << std::endl
+			  << "        " << command << " --simplify-out-of-core <input.off|input.bmesh> <output.off> [<resolution> [<memory MB>]]" << std::endl
+			  << "        " << command << " --archive <input.off|input.ply|input.obj> <output.qmesh> [<position bits> [<normal bits>]]" << std::endl
+			  << "        " << command << " --benchmark-lights [<file.off|file.ply|file.obj|file.qmesh>]" << std::endl
+			  << "        " << command << " --benchmark-brdf [<file.off|file.ply|file.obj|file.qmesh>]" << std::endl
+			  << "        " << command << " --headless <output directory> [<shots.txt> [<file.off|file.ply|file.obj|file.qmesh>]]" << std::endl;
 	std::exit (EXIT_FAILURE);
 }
 
+/// Runs the out-of-core simplification without opening any window
+int simplifyOutOfCore (int argc, char ** argv)
+{
+	if (argc < 4 || argc > 6)
+		usage (argv[0]);
+	try
+	{
+		unsigned int resolution = (argc > 4 ? parsePositive (argv[4], "resolution") : 256);
+		size_t memoryBudget = size_t (argc > 5 ? parsePositive (argv[5], "memory budget") : 512) * 1024 * 1024;
+		OutOfCoreSimplifier::simplify (argv[2], argv[3], resolution, memoryBudget);
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "> [Critical error]" << e.what () << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Writes the compressed archive of a mesh without opening any window
+int archiveMesh (int argc, char ** argv)
+{
+	if (argc < 4 || argc > 6)
+		usage (argv[0]);
+	try
+	{
+		unsigned int positionBits = (argc > 4 ? parsePositive (argv[4], "number of position bits") : 16);
+		unsigned int normalBits = (argc > 5 ? parsePositive (argv[5], "number of normal bits") : 12);
+		auto archivedMeshPtr = std::make_shared<Mesh> ();
+		MeshLoader::load (argv[2], archivedMeshPtr);
+		MeshArchive::save (argv[3], archivedMeshPtr, positionBits, normalBits);
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "> [Critical error]" << e.what () << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/// Renders the scene in PBR mode with an increasing number of additional lights, and prints the time
+/// taken by the light binning and by whole frames, and how many lights the clusters hold
+int benchmarkLights (int argc, char ** argv)
+{
+	if (argc > 3)
+		usage (argv[0]);
+	if (argc == 3)
+		commandLineMeshFilename = argv[2];
+	const int NUM_FRAMES = 100;
+
+	init ();
+	glfwSwapInterval (0); // Frames are not held back by the display
+	std::cout << " > Lights benchmark, " << screen_width << "x" << screen_height << ", " << NUM_FRAMES << " frames per light count, "
+			  << lightClusters.size ().x << "x" << lightClusters.size ().y << "x" << lightClusters.size ().z << " clusters" << std::endl
+			  << "   lights | lights per cluster (mean, max) | binning (ms) | frame (ms)" << std::endl;
+	for (int count = 0; count <= MAX_ADDITIONAL_LIGHTS; count = std::max (4 * count, 16))
+	{
+		additionalLightCount = count;
+		setupAdditionalLights ();
+		uploadLights ();
+		render (); // Warm up, uploads included
+		glFinish ();
+		lightBinningSeconds = 0.0;
+		auto start = std::chrono::high_resolution_clock::now ();
+		for (int i = 0; i < NUM_FRAMES; i++)
+		{
+			render ();
+			glfwSwapBuffers (windowPtr);
+			glfwPollEvents ();
+		}
+		glFinish ();
+		double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+		size_t maxLights = 0;
+		for (const glm::uvec2 & cluster : lightClusters.clusters ())
+			maxLights = std::max (maxLights, size_t (cluster.y));
+		std::printf ("   %6zu | %14.1f %15zu | %12.3f | %10.3f\n", lightSources.size () - 3 + numberLightUsed,
+					 double (lightClusters.lightIndices ().size ()) / lightClusters.clusters ().size (), maxLights,
+					 lightBinningSeconds * 1000.0 / NUM_FRAMES, seconds * 1000.0 / NUM_FRAMES);
+	}
+	clear ();
+	return EXIT_SUCCESS;
+}
+
+/// Renders the model (man.off by default) in PBR mode close enough to fill most of the window, shaded
+/// as before the fast path (see REFERENCE_SHADING) and with it, and prints their frame times for a few light counts
+int benchmarkBrdf (int argc, char ** argv)
+{
+	if (argc > 3)
+		usage (argv[0]);
+	commandLineMeshFilename = (argc == 3 ? std::string (argv[2]) : DEFAULT_MESH_PATH + "man.off");
+	const int NUM_FRAMES = 100;
+
+	init ();
+	glfwSwapInterval (0); // Frames are not held back by the display
+	cameraPtr->setTranslation (center + glm::vec3 (0.0, 0.0, 1.2 * meshScale));
+	numberLightUsed = 3;
+	std::cout << " > BRDF benchmark, " << screen_width << "x" << screen_height << ", " << NUM_FRAMES << " frames per light count" << std::endl
+			  << "   lights | reference (ms) | fast path (ms) | speedup" << std::endl;
+	for (int count : { 0, 64, 1024 })
+	{
+		additionalLightCount = count;
+		setupAdditionalLights ();
+		uploadLights ();
+		double milliseconds[2];
+		for (int reference = 1; reference >= 0; reference--)
+		{
+			referenceShading = reference;
+			selectShaderPrograms ();
+			render (); // Warm up, uploads included
+			glFinish ();
+			auto start = std::chrono::high_resolution_clock::now ();
+			for (int i = 0; i < NUM_FRAMES; i++)
+			{
+				render ();
+				glfwSwapBuffers (windowPtr);
+				glfwPollEvents ();
+			}
+			glFinish ();
+			milliseconds[reference] = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count () * 1000.0 / NUM_FRAMES;
+		}
+		std::printf ("   %6d | %14.3f | %14.3f | %6.2fx\n", count + numberLightUsed, milliseconds[1], milliseconds[0], milliseconds[1] / milliseconds[0]);
+	}
+	clear ();
+	return EXIT_SUCCESS;
+}
+
+/// Image of the headless mode: a shader mode, and the camera orbiting around the center of the mesh
+struct HeadlessShot {
+	std::string name; // Of its PNG file
+	int shaderMode = SHADER_MODE_PBR;
+	glm::vec2 rotation = glm::vec2 (0.f); // Around X then Y, in degrees
+	float distance = 3.f; // To the center, in bounding sphere radii
+};
+
+/// Reads the shots of a script, one per line: name, shader mode (the values of the 1 to 6 keys, 0
+/// for PBR), rotation around X and Y in degrees and distance in bounding sphere radii. Lines
+/// starting with # are ignored.
+std::vector<HeadlessShot> loadHeadlessShots (const std::string & filename)
+{
+	std::ifstream input (filename.c_str ());
+	if (!input)
+		throw std::ios_base::failure ("[Main][loadHeadlessShots] Cannot open " + filename);
+	std::vector<HeadlessShot> shots;
+	std::string line;
+	for (int lineNumber = 1; std::getline (input, line); lineNumber++)
+	{
+		std::istringstream fields (line);
+		HeadlessShot shot;
+		if (!(fields >> shot.name) || shot.name[0] == '#')
+			continue;
+		if (!(fields >> shot.shaderMode >> shot.rotation.x >> shot.rotation.y >> shot.distance)
+			|| shot.shaderMode < SHADER_MODE_PBR || shot.shaderMode > SHADER_DISTANCE_TRAVELED)
+			throw std::ios_base::failure ("[Main][loadHeadlessShots] Invalid shot line " + std::to_string (lineNumber) + " of " + filename);
+		shots.push_back (shot);
+	}
+	return shots;
+}
+
+/// Shots rendered when no script is given: PBR, toon and orientation X-toon from four sides
+std::vector<HeadlessShot> defaultHeadlessShots ()
+{
+	std::vector<HeadlessShot> shots;
+	for (int mode : { SHADER_MODE_PBR, SHADER_BASIC_TOON, SHADER_ORIENTATION })
+		for (int yaw = 0; yaw < 360; yaw += 90)
+		{
+			HeadlessShot shot;
+			shot.name = "mode" + std::to_string (mode) + "-yaw" + std::to_string (yaw);
+			shot.shaderMode = mode;
+			shot.rotation = glm::vec2 (0.f, float (yaw));
+			shots.push_back (shot);
+		}
+	return shots;
+}
+
+/// Places the camera of a shot: the camera rotation is applied to its translation too (see
+/// Transform::computeTransformMatrix), which is chosen so that the camera looks at the mesh center
+void setHeadlessCamera (const HeadlessShot & shot)
+{
+	cameraPtr->setRotation (glm::radians (glm::vec3 (shot.rotation, 0.f)));
+	cameraPtr->setTranslation (glm::vec3 (0.f));
+	glm::mat3 rotationMatrix (cameraPtr->computeTransformMatrix ());
+	cameraPtr->setTranslation (glm::transpose (rotationMatrix) * center + glm::vec3 (0.f, 0.f, shot.distance * meshScale));
+}
+
+/// Renders shots to PNG files in an offscreen framebuffer, without any window nor display server,
+/// and prints the frame time of each: meant for automated regression and performance tests
+int renderHeadless (int argc, char ** argv)
+{
+	if (argc < 3 || argc > 5)
+		usage (argv[0]);
+	const std::string outputDirectory = argv[2];
+	const int NUM_FRAMES = 10; // Timed per shot, after a first frame building the shader variant
+	std::vector<HeadlessShot> shots;
+	try
+	{
+		shots = (argc > 3 ? loadHeadlessShots (argv[3]) : defaultHeadlessShots ());
+		std::filesystem::create_directories (outputDirectory);
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "> [Critical error]" << e.what () << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (argc == 5)
+		commandLineMeshFilename = argv[4];
+
+	headless = true;
+	auto start = std::chrono::high_resolution_clock::now ();
+	init ();
+	GLuint colorBuffer, depthBuffer;
+	glCreateRenderbuffers (1, &colorBuffer);
+	glNamedRenderbufferStorage (colorBuffer, GL_RGBA8, screen_width, screen_height);
+	glCreateRenderbuffers (1, &depthBuffer);
+	glNamedRenderbufferStorage (depthBuffer, GL_DEPTH_COMPONENT24, screen_width, screen_height);
+	glCreateFramebuffers (1, &mainFramebuffer);
+	glNamedFramebufferRenderbuffer (mainFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glNamedFramebufferRenderbuffer (mainFramebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckNamedFramebufferStatus (mainFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		exitOnCriticalError ("[Error creating offscreen framebuffer]");
+	double setupSeconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+
+	std::cout << " > Headless rendering, " << shots.size () << " shots, " << screen_width << "x" << screen_height << ", "
+			  << NUM_FRAMES << " frames per shot" << std::endl
+			  << "   shot                     | mode | first frame (ms) | frame mean (ms) | min (ms) | max (ms) | GPU depth (ms) | GPU main (ms)" << std::endl;
+	int exitCode = EXIT_SUCCESS;
+	double frameSeconds = 0.0;
+	std::vector<uint8_t> pixels (size_t (screen_width) * screen_height * 3);
+	for (const HeadlessShot & shot : shots)
+	{
+		switchShaderMode (shot.shaderMode);
+		setHeadlessCamera (shot);
+		auto frameStart = std::chrono::high_resolution_clock::now ();
+		render ();
+		glFinish ();
+		double firstSeconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - frameStart).count ();
+		gpuTimerPtr->collect ();
+		gpuTimerPtr->clearHistory (); // GPU times of the timed frames only
+		double minSeconds = 1e30, maxSeconds = 0.0, sumSeconds = 0.0;
+		for (int i = 0; i < NUM_FRAMES; i++)
+		{
+			frameStart = std::chrono::high_resolution_clock::now ();
+			render ();
+			glFinish ();
+			double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - frameStart).count ();
+			minSeconds = std::min (minSeconds, seconds);
+			maxSeconds = std::max (maxSeconds, seconds);
+			sumSeconds += seconds;
+		}
+		frameSeconds += sumSeconds;
+		gpuTimerPtr->collect ();
+		gpuTimerPtr->takeFrames ();
+		std::printf ("   %-24s | %4d | %16.3f | %15.3f | %8.3f | %8.3f | %14.3f | %13.3f\n", shot.name.c_str (), shot.shaderMode, firstSeconds * 1000.0,
+					 sumSeconds * 1000.0 / NUM_FRAMES, minSeconds * 1000.0, maxSeconds * 1000.0, gpuTimerPtr->statistics (DEPTH_PASS).mean,
+					 gpuTimerPtr->statistics (MAIN_PASS).mean);
+
+		glBindFramebuffer (GL_READ_FRAMEBUFFER, mainFramebuffer);
+		glPixelStorei (GL_PACK_ALIGNMENT, 1);
+		glReadPixels (0, 0, screen_width, screen_height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data ());
+		try
+		{
+			ImageWriter::savePNG (outputDirectory + "/" + shot.name + ".png", pixels.data (), screen_width, screen_height, 3, true);
+		}
+		catch (std::exception & e)
+		{
+			std::cerr << "> [Error saving shot]" << e.what () << std::endl;
+			exitCode = EXIT_FAILURE;
+		}
+	}
+	double totalSeconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	std::cout << " > " << shots.size () << " shots written to " << outputDirectory << " in " << totalSeconds << " s: setup "
+			  << setupSeconds * 1000.0 << " ms, mean frame " << (shots.empty () ? 0.0 : frameSeconds * 1000.0 / (shots.size () * NUM_FRAMES))
+			  << " ms" << std::endl;
+
+	glDeleteFramebuffers (1, &mainFramebuffer);
+	mainFramebuffer = 0;
+	glDeleteRenderbuffers (1, &colorBuffer);
+	glDeleteRenderbuffers (1, &depthBuffer);
+	clear ();
+	return exitCode;
+}
+
 int main (int argc, char ** argv)
 {
-	if (argc > 2)
+	if (argc > 1 && std::string (argv[1]) == "--simplify-out-of-core")
+		return simplifyOutOfCore (argc, argv);
+	if (argc > 1 && std::string (argv[1]) == "--archive")
+		return archiveMesh (argc, argv);
+	if (argc > 1 && std::string (argv[1]) == "--benchmark-lights")
+		return benchmarkLights (argc, argv);
+	if (argc > 1 && std::string (argv[1]) == "--benchmark-brdf")
+		return benchmarkBrdf (argc, argv);
+	if (argc > 1 && std::string (argv[1]) == "--headless")
+		return renderHeadless (argc, argv);
+
+	int meshArgument = 1;
+	for (; meshArgument + 1 < argc; meshArgument += 2)
+	{
+		std::string option = argv[meshArgument];
+		if (option == "--gpu-timings")
+		{
+			gpuTimingsFile.open (argv[meshArgument + 1]);
+			if (!gpuTimingsFile)
+			{
+				std::cerr << "> [Critical error][Cannot open " << argv[meshArgument + 1] << "]" << std::endl;
+				return EXIT_FAILURE;
+			}
+			gpuTimingsFile << "frame,shaderMode,depthPassMs,mainPassMs" << std::endl;
+		}
+		else if (option == "--profile")
+		{
+			traceFilename = argv[meshArgument + 1];
+			Profiler::setEnabled (true); // From the start, the first mesh loading included
+		}
+		else
+			break;
+	}
+	if (argc > meshArgument + 1)
 		usage (argv[0]);
+	if (argc == meshArgument + 1)
+		commandLineMeshFilename = argv[meshArgument];
 
+	Profiler::setThreadName ("Main");
 	init ();
 
 	while (!glfwWindowShouldClose (windowPtr))
 	{
+		PROFILE_ZONE ("Frame");
 		update (static_cast<float> (glfwGetTime ()));
-		render ();
-		glfwSwapBuffers (windowPtr);
-		glfwPollEvents ();
+		{
+			PROFILE_ZONE ("updateSceneLoading");
+			updateSceneLoading ();
+		}
+		updateShaderReloading ();
+		{
+			PROFILE_ZONE ("render");
+			render ();
+		}
+		updateCallCounters ();
+		updateGPUTimings ();
+		{
+			PROFILE_ZONE ("glfwSwapBuffers");
+			glfwSwapBuffers (windowPtr);
+		}
+		{
+			PROFILE_ZONE ("glfwPollEvents");
+			glfwPollEvents (); // Runs the key callbacks, and thus the mesh operations
+		}
 	}
+	if (Profiler::isEnabled ())
+		writeTrace ();
 	clear ();
 	std::cout << " > Quit" << std::endl;
 	return EXIT_SUCCESS;
@@ -0,0 +1,92 @@
+#include "MappedFile.h"
+
+#include <exception>
+#include <ios>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile (const std::string & filename)
+{
+	HANDLE file = CreateFileA (filename.c_str (), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::ios_base::failure ("[Mapped File][MappedFile] Cannot open " + filename);
+	m_file = file;
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx (file, &fileSize);
+	m_size = static_cast<size_t> (fileSize.QuadPart);
+	if (m_size == 0) // Empty files cannot be mapped, expose an empty range instead
+		return;
+
+	m_mapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_mapping)
+	{
+		CloseHandle (file);
+		throw std::ios_base::failure ("[Mapped File][MappedFile] Cannot map " + filename);
+	}
+	m_data = static_cast<const char *> (MapViewOfFile (m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data)
+	{
+		CloseHandle (m_mapping);
+		CloseHandle (file);
+		throw std::ios_base::failure ("[Mapped File][MappedFile] Cannot map " + filename);
+	}
+}
+
+MappedFile::~MappedFile ()
+{
+	if (m_data)
+		UnmapViewOfFile (m_data);
+	if (m_mapping)
+		CloseHandle (m_mapping);
+	if (m_file)
+		CloseHandle (m_file);
+}
+
+#else
+
+MappedFile::MappedFile (const std::string & filename)
+{
+	int fd = open (filename.c_str (), O_RDONLY);
+	if (fd < 0)
+		throw std::ios_base::failure ("[Mapped File][MappedFile] Cannot open " + filename);
+
+	struct stat st;
+	if (fstat (fd, &st) != 0)
+	{
+		close (fd);
+		throw std::ios_base::failure ("[Mapped File][MappedFile] Cannot stat " + filename);
+	}
+	m_size = static_cast<size_t> (st.st_size);
+	if (m_size == 0) // Empty files cannot be mapped, expose an empty range instead
+	{
+		close (fd);
+		return;
+	}
+
+	void * ptr = mmap (nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd); // The mapping keeps its own reference to the file
+	if (ptr == MAP_FAILED)
+		throw std::ios_base::failure ("[Mapped File][MappedFile] Cannot map " + filename);
+	madvise (ptr, m_size, MADV_SEQUENTIAL); // The parsers walk the file front to back
+	m_data = static_cast<const char *> (ptr);
+}
+
+MappedFile::~MappedFile ()
+{
+	if (m_data)
+		munmap (const_cast<char *> (m_data), m_size);
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+/// Read-only memory mapping of a whole file. The content is exposed as a contiguous
+/// byte range and stays valid as long as the object lives.
+class MappedFile {
+public:
+	/// Maps the file in memory. Throws std::ios_base::failure if the file cannot be opened or mapped.
+	MappedFile (const std::string & filename);
+
+	virtual ~MappedFile ();
+
+	MappedFile (const MappedFile &) = delete;
+	MappedFile & operator= (const MappedFile &) = delete;
+
+	inline const char * data () const { return m_data; }
+	inline size_t size () const { return m_size; }
+	inline const char * begin () const { return m_data; }
+	inline const char * end () const { return m_data + m_size; }
+
+private:
+	const char * m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void * m_file = nullptr;
+	void * m_mapping = nullptr;
+#endif
+};
+
+#endif // MAPPED_FILE_H
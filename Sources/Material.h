@@ -1,8 +1,10 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
 
 class Material {
 private:
@@ -22,38 +24,25 @@ public:
   void setRoughness(float _roughness){roughness=_roughness;};
 };
 
-
-GLuint loadTextureFromFileToGPU(const std::string & filename, bool isNormalMap){
-  int width,height,numComponents;
-  GLuint texID;
-  glGenTextures(1,&texID);
-  glBindTexture(GL_TEXTURE_2D,texID);
-  if(isNormalMap){
-    float * data = stbi_loadf(filename.c_str(),&width,&height,&numComponents,0);
-
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
-    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,width,height,0,GL_RGBA,GL_FLOAT,data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
-  }
-  else {
-    unsigned char * data = stbi_load(filename.c_str(),&width,&height,&numComponents,0);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
-    glTexImage2D(GL_TEXTURE_2D,0,(numComponents==1?GL_RED:GL_RGB),width,height,0,(numComponents==1?GL_RED:GL_RGB),GL_UNSIGNED_BYTE,data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
-  }
-  glBindTexture(GL_TEXTURE_2D,0);
-  return texID;
-};
+/// Tangent-space normal map of a material directory, loaded with loadNormalMap
+inline std::string normalMapFilename(const std::string & directory){
+  return directory + "Normal.png";
+}
+
+/// The occlusion, roughness and metallic maps of a material directory are packed in the R, G and B
+/// channels of a single texture (see packChannels), named after this file
+inline std::string ormFilename(const std::string & directory){
+  return directory + "ORM.png";
+}
+
+inline std::vector<std::string> ormSources(const std::string & directory){
+  return {directory + "Ambient_Occlusion.png", directory + "Roughness.png", directory + "Metallic.png"};
+}
+
+/// Values of missing maps: no occlusion, and the roughness (0.6) and metallic (0.1) of the untextured material
+inline std::vector<uint8_t> ormDefaults(){
+  return {255, 153, 26};
+}
 
 
 #endif // MATERIAL_H
@@ -3,6 +3,7 @@
 #include "Mesh.h"
 #include "OctreeNode.h"
 #include "Data.h"
+#include "Profiler.h"
 
 #include <cmath>
 #include <algorithm>
@@ -15,6 +16,7 @@ Mesh::~Mesh ()
 }
 void Mesh::subdivide()
 {
+	PROFILE_ZONE ("Mesh::subdivide");
 	int index0;
 	int index1;
 	int index2;
@@ -56,6 +58,16 @@ void Mesh::subdivide()
 			m_vertexPositions.push_back(newPos1);
 			m_vertexPositions.push_back(newPos2);
 
+			if(m_hasTexCoords)
+			{
+				glm::vec2 uv0 = m_vertexTexCoords.at(index0);
+				glm::vec2 uv1 = m_vertexTexCoords.at(index1);
+				glm::vec2 uv2 = m_vertexTexCoords.at(index2);
+				m_vertexTexCoords.push_back((uv0+uv1)/2.0f);
+				m_vertexTexCoords.push_back((uv1+uv2)/2.0f);
+				m_vertexTexCoords.push_back((uv2+uv0)/2.0f);
+			}
+
 			// modify the current triangle
 			triangleIndicesCopy.at(i).x = newIndex0;
 			triangleIndicesCopy.at(i).y = index1;
@@ -68,8 +80,8 @@ void Mesh::subdivide()
 	}
 
 	m_triangleIndices = triangleIndicesCopy;
-	init();
-	//push_buffers();
+	recomputePerVertexNormals(true);
+	geometryChanged();
 }
 
 void Mesh::computeMinMaxCoordinates()
@@ -122,20 +134,6 @@ void Mesh::computeMinMaxCoordinates()
 		yMax = maxY;
 }
 
-void Mesh::push_buffers()
-{
-	size_t vertexBufferSize = sizeof (glm::vec3) * m_vertexPositions.size (); // Gather the size of the buffer from the CPU-side vector
-	size_t texCoordBufferSize = sizeof (glm::vec2) * m_vertexTexCoords.size ();
-	size_t indexBufferSize = sizeof (glm::uvec3) * m_triangleIndices.size ();
-
-	glNamedBufferSubData (m_ibo, 0, indexBufferSize, m_triangleIndices.data ());
-	glNamedBufferSubData (m_normalVbo, 0, vertexBufferSize, m_vertexNormals.data ());
-	glNamedBufferSubData (m_texCoordVbo, 0, texCoordBufferSize, m_vertexTexCoords.data ());
-	glNamedBufferSubData (m_posVbo, 0, vertexBufferSize, m_vertexPositions.data ());
-	glNamedBufferSubData (m_tanVbo, 0, vertexBufferSize, m_vertexTangents.data ());
-	glNamedBufferSubData (m_biVbo, 0, vertexBufferSize, m_vertexBitangents.data ());
-}
-
 void travelTree(std::vector<Data>* datas,OctreeNode * node)
 {
 	if(!node->getIsALeaf())
@@ -169,6 +167,7 @@ bool isInCell(Data data, glm::vec3 vertexPos)
 
 void Mesh::adaptiveSimplify(unsigned int numOfPerLeafVertices)
 {
+	PROFILE_ZONE ("Mesh::adaptiveSimplify");
 	OctreeNode * octreeNode;
 
 	float maxX = xMax +(xMax-xMin)/100.0;
@@ -242,11 +241,12 @@ void Mesh::adaptiveSimplify(unsigned int numOfPerLeafVertices)
 		m_vertexNormals.at(vertexIndex2) = perCellVertexNormals.at(cell2);
 	}
 
-	push_buffers();
+	geometryChanged();
 }
 
 void Mesh::simplify(unsigned int resolution)
 {
+	PROFILE_ZONE ("Mesh::simplify");
 	std::vector<int> perVertexCellIndices;
 	std::vector<glm::vec3> perCellVertexPositions;
 	std::vector<glm::vec3> perCellVertexNormals;
@@ -314,7 +314,7 @@ void Mesh::simplify(unsigned int resolution)
 		m_vertexNormals.at(vertexIndex2) = perCellVertexNormals.at(cell2);
 	}
 
-	push_buffers();
+	geometryChanged();
 }
 
 void Mesh::computePlanarParameterization()
@@ -331,6 +331,7 @@ void Mesh::computePlanarParameterization()
 
 void Mesh::laplacianFilter(float alpha, bool cotangentWeights)
 {
+	PROFILE_ZONE ("Mesh::laplacianFilter");
 	glm::vec3 p0 ;
 	glm::vec3 p1 ;
 	glm::vec3 p2 ;
@@ -414,7 +415,7 @@ void Mesh::laplacianFilter(float alpha, bool cotangentWeights)
 	}
 
 	recomputePerVertexNormals(true);
-	push_buffers();
+	geometryChanged();
 }
 
 void Mesh::computeBoundingSphere (glm::vec3 & center, float & radius) const 
@@ -429,10 +430,28 @@ void Mesh::computeBoundingSphere (glm::vec3 & center, float & radius) const
 		radius = std::max (radius, distance (center, p));
 }
 
-void Mesh::recomputePerVertexNormals (bool angleBased) 
+void Mesh::computeBoundingBox (glm::vec3 & bbMin, glm::vec3 & bbMax)
 {
-	computePlanarParameterization();
-	m_vertexNormals.clear ();
+	computeMinMaxCoordinates();
+	bbMin = glm::vec3(xMin, yMin, zMin);
+	bbMax = glm::vec3(xMax, yMax, zMax);
+}
+
+void Mesh::recomputePerVertexNormals (bool angleBased, bool keepNormals) 
+{
+	PROFILE_ZONE ("Mesh::recomputePerVertexNormals");
+	if(m_hasTexCoords)
+	{
+		computeMinMaxCoordinates();
+	}
+	else
+	{
+		computePlanarParameterization();
+	}
+	if(!keepNormals)
+	{
+		m_vertexNormals.clear ();
+	}
 	m_vertexTangents.clear ();
 	m_vertexBitangents.clear ();
 
@@ -497,9 +516,12 @@ void Mesh::recomputePerVertexNormals (bool angleBased)
 			angle2 = std::acos(dot(p0-p2,p1-p2)/(length(p0-p2)*length(p1-p2)));
 		}
 
-		m_vertexNormals.at(index0) = m_vertexNormals.at(index0) + angle0*normal;
-		m_vertexNormals.at(index1) = m_vertexNormals.at(index1) + angle1*normal;
-		m_vertexNormals.at(index2) = m_vertexNormals.at(index2) + angle2*normal;
+		if(!keepNormals)
+		{
+			m_vertexNormals.at(index0) = m_vertexNormals.at(index0) + angle0*normal;
+			m_vertexNormals.at(index1) = m_vertexNormals.at(index1) + angle1*normal;
+			m_vertexNormals.at(index2) = m_vertexNormals.at(index2) + angle2*normal;
+		}
 
 		// tangent and bitangent computation
 
@@ -541,64 +563,6 @@ void Mesh::recomputePerVertexNormals (bool angleBased)
 	}
 }
 
-void Mesh::init () 
-{
-	computePlanarParameterization();
-	recomputePerVertexNormals (true);
-	glCreateBuffers (1, &m_posVbo); // Generate a GPU buffer to store the positions of the vertices
-	size_t vertexBufferSize = sizeof (glm::vec3) * m_vertexPositions.size (); // Gather the size of the buffer from the CPU-side vector
-	glNamedBufferStorage (m_posVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT); // Create a data store on the GPU
-	glNamedBufferSubData (m_posVbo, 0, vertexBufferSize, m_vertexPositions.data ()); // Fill the data store from a CPU array
-
-	glCreateBuffers (1, &m_normalVbo); // Same for normal
-	glNamedBufferStorage (m_normalVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferSubData (m_normalVbo, 0, vertexBufferSize, m_vertexNormals.data ());
-
-	glCreateBuffers (1, &m_texCoordVbo); // Same for texture coordinates
-	size_t texCoordBufferSize = sizeof (glm::vec2) * m_vertexTexCoords.size ();
-	glNamedBufferStorage (m_texCoordVbo, texCoordBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferSubData (m_texCoordVbo, 0, texCoordBufferSize, m_vertexTexCoords.data ());
-
-	glCreateBuffers (1, &m_ibo); // Same for the index buffer, that stores the list of indices of the triangles forming the mesh
-	size_t indexBufferSize = sizeof (glm::uvec3) * m_triangleIndices.size ();
-	glNamedBufferStorage (m_ibo, indexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferSubData (m_ibo, 0, indexBufferSize, m_triangleIndices.data ());
-
-	glCreateBuffers (1, &m_tanVbo); // Same for the tangent buffer
-	glNamedBufferStorage (m_tanVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferSubData (m_tanVbo, 0, vertexBufferSize, m_vertexTangents.data ());
-
-	glCreateBuffers (1, &m_biVbo); // Same for the bitangent buffer
-	glNamedBufferStorage (m_biVbo, vertexBufferSize, NULL, GL_DYNAMIC_STORAGE_BIT);
-	glNamedBufferSubData (m_biVbo, 0, vertexBufferSize, m_vertexBitangents.data ());
-
-	glCreateVertexArrays (1, &m_vao); // Create a single handle that joins together attributes (vertex positions, normals) and connectivity (triangles indices)
-	glBindVertexArray (m_vao);
-	glEnableVertexAttribArray (0);
-	glBindBuffer (GL_ARRAY_BUFFER, m_posVbo);
-	glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
-	glEnableVertexAttribArray (1);
-	glBindBuffer (GL_ARRAY_BUFFER, m_normalVbo);
-	glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
-	glEnableVertexAttribArray (2);
-	glBindBuffer (GL_ARRAY_BUFFER, m_texCoordVbo);
-	glVertexAttribPointer (2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof (GLfloat), 0);
-	glEnableVertexAttribArray (3);
-	glBindBuffer (GL_ARRAY_BUFFER, m_tanVbo);
-	glVertexAttribPointer (3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
-	glEnableVertexAttribArray (4);
-	glBindBuffer (GL_ARRAY_BUFFER, m_biVbo);
-	glVertexAttribPointer (4, 3, GL_FLOAT, GL_FALSE, 3 * sizeof (GLfloat), 0);
-	glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-	glBindVertexArray (0); // Desactive the VAO just created. Will be activated at rendering time.
-}
-
-void Mesh::render () 
-{
-	glBindVertexArray (m_vao); // Activate the VAO storing geometry data
-	glDrawElements (GL_TRIANGLES, static_cast<GLsizei> (m_triangleIndices.size () * 3), GL_UNSIGNED_INT, 0); // Call for rendering: stream the current GPU geometry through the current GPU program
-}
-
 void Mesh::clear () 
 {
 	m_vertexPositions.clear ();
@@ -607,44 +571,5 @@ void Mesh::clear ()
 	m_triangleIndices.clear ();
 	m_vertexTangents.clear ();
 	m_vertexBitangents.clear ();
-
-	if (m_vao) 
-	{
-		glDeleteVertexArrays (1, &m_vao);
-		m_vao = 0;
-	}
-
-	if(m_posVbo)
-	{
-		glDeleteBuffers (1, &m_posVbo);
-		m_posVbo = 0;
-	}
-
-	if (m_normalVbo)
-	{
-		glDeleteBuffers (1, &m_normalVbo);
-		m_normalVbo = 0;
-	}
-
-	if (m_texCoordVbo) 
-	{
-		glDeleteBuffers (1, &m_texCoordVbo);
-		m_texCoordVbo = 0;
-	}
-
-	if (m_ibo) 
-	{
-		glDeleteBuffers (1, &m_ibo);
-		m_ibo = 0;
-	}
-
-	if (m_tanVbo) 
-	{
-		glDeleteBuffers (1, &m_tanVbo);
-	}
-
-	if (m_biVbo)
-	{
-		glDeleteBuffers (1, &m_biVbo);
-	}
+	m_hasTexCoords = false;
 }
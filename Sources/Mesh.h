@@ -1,7 +1,6 @@
 #ifndef MESH_H
 #define MESH_H
 
-#include <glad/glad.h>
 #include <vector>
 #include <memory>
 
@@ -10,6 +9,8 @@
 
 #include "Transform.h"
 
+/// Triangle mesh and the CPU geometry processing run on it. Nothing here depends on OpenGL, so that
+/// the loaders and the algorithms also run without a window (see BaseGLTool). GLMesh adds the GPU side.
 class Mesh : public Transform {
 public:
 	virtual ~Mesh ();
@@ -22,13 +23,26 @@ public:
 	inline std::vector<glm::vec2> & vertexTexCoords () { return m_vertexTexCoords; }
 	inline const std::vector<glm::uvec3> & triangleIndices () const { return m_triangleIndices; }
 	inline std::vector<glm::uvec3> & triangleIndices () { return m_triangleIndices; }
+	inline const std::vector<glm::vec3> & vertexTangents () const { return m_vertexTangents; }
+	inline std::vector<glm::vec3> & vertexTangents () { return m_vertexTangents; }
+	inline const std::vector<glm::vec3> & vertexBitangents () const { return m_vertexBitangents; }
+	inline std::vector<glm::vec3> & vertexBitangents () { return m_vertexBitangents; }
+	/// True when the texture coordinates come from the mesh file, in which case they are kept
+	/// instead of being replaced by computePlanarParameterization
+	inline bool hasTexCoords () const { return m_hasTexCoords; }
+	inline void setHasTexCoords (bool b) { m_hasTexCoords = b; }
 	inline float getZMin(){return this->zMin;};
 	inline float getZMax(){return this->zMax;};
 
 	/// Compute the parameters of a sphere which bounds the mesh
 	void computeBoundingSphere (glm::vec3 & center, float & radius) const;
 
-	void recomputePerVertexNormals (bool angleBased = false);
+	/// Compute the axis-aligned bounding box of the mesh
+	void computeBoundingBox (glm::vec3 & bbMin, glm::vec3 & bbMax);
+
+	/// Recomputes normals, tangents and bitangents. With keepNormals, only the tangent frame is rebuilt
+	/// around the current normals (e.g. normals read from the mesh file).
+	void recomputePerVertexNormals (bool angleBased = false, bool keepNormals = false);
 
 	void computePlanarParameterization();
 
@@ -39,15 +53,16 @@ public:
 	void adaptiveSimplify(unsigned int numOfPerLeafVertices);
 
 	void subdivide();
-	
-	void init ();
-	void render ();
-	void clear ();
 
-private:
+	virtual void clear ();
+
+protected:
+	/// Called by the processing algorithms once they have modified the attributes or the connectivity
+	virtual void geometryChanged () {}
+
 	void computeMinMaxCoordinates();
 
-	void push_buffers();
+private:
 	std::vector<glm::vec3> m_vertexPositions;
 	std::vector<glm::vec3> m_vertexNormals;
 	std::vector<glm::vec2> m_vertexTexCoords;
@@ -55,14 +70,8 @@ private:
 	std::vector<glm::vec3> m_vertexTangents;
 	std::vector<glm::vec3> m_vertexBitangents;
 	std::vector<std::vector<int>> m_vertexNeighborhood;
+	bool m_hasTexCoords = false;
 
-	GLuint m_vao = 0;
-	GLuint m_posVbo = 0;
-	GLuint m_normalVbo = 0;
-	GLuint m_texCoordVbo = 0;
-	GLuint m_ibo = 0;
-	GLuint m_tanVbo = 0;
-	GLuint m_biVbo = 0;
 	float zMin;
 	float zMax;
 	float xMin;
@@ -0,0 +1,642 @@
+#include "MeshArchive.h"
+#include "MappedFile.h"
+#include "MeshLoader.h"
+
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <ios>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const uint32_t QMESH_VERSION = 1;
+const uint32_t QMESH_FLAG_TEXCOORDS = 1;
+
+/// Items (vertices or triangles) per independently decodable block
+const uint32_t QMESH_BLOCK_ITEMS = 16384;
+
+/// Quantization of the file texture coordinates, relative to their bounding rectangle
+const unsigned int QMESH_TEXCOORD_BITS = 16;
+
+enum QMeshStream { QMESH_POSITIONS = 0, QMESH_NORMALS, QMESH_TEXCOORDS, QMESH_INDICES, QMESH_STREAM_COUNT };
+
+/// File header, followed by the streams in QMeshStream order. A stream is a sequence of blocks,
+/// each one prefixed by its byte size so that the decoder can dispatch them before decoding.
+struct QMeshHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t numVertices;
+	uint32_t numTriangles;
+	uint32_t positionBits;
+	uint32_t normalBits;
+	uint32_t blockItems;
+	float bbMin[3];
+	float bbMax[3];
+	float uvMin[2];
+	float uvMax[2];
+	uint64_t streamSizes[QMESH_STREAM_COUNT];
+};
+
+inline uint32_t zigzag (int32_t v) { return (static_cast<uint32_t> (v) << 1) ^ static_cast<uint32_t> (v >> 31); }
+inline int32_t unzigzag (uint32_t v) { return static_cast<int32_t> (v >> 1) ^ -static_cast<int32_t> (v & 1); }
+
+inline void writeVarint (std::vector<uint8_t> & out, uint32_t v)
+{
+	while (v >= 0x80)
+	{
+		out.push_back (static_cast<uint8_t> (v | 0x80));
+		v >>= 7;
+	}
+	out.push_back (static_cast<uint8_t> (v));
+}
+
+inline uint32_t readVarint (const uint8_t * & p, const uint8_t * end)
+{
+	uint32_t v = 0;
+	for (unsigned int shift = 0; shift < 35; shift += 7)
+	{
+		if (p >= end)
+			break;
+		uint8_t byte = *p++;
+		v |= static_cast<uint32_t> (byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return v;
+	}
+	throw std::ios_base::failure ("[Mesh Archive][readVarint] Corrupted block");
+}
+
+/// A value v is split in its bit length k (the entropy-coded symbol, 0 to 32) and, for k > 1, its k-1
+/// low bits which are stored raw: small deltas cost a single symbol and the alphabet stays tiny.
+const uint32_t CLASS_COUNT = 33;
+
+inline uint32_t bitLength (uint32_t v)
+{
+	uint32_t k = 0;
+	while (v)
+	{
+		k++;
+		v >>= 1;
+	}
+	return k;
+}
+
+/// Order-0 rANS coder (Duda, "Asymmetric numeral systems", 2013) with byte-wise renormalization and
+/// frequencies normalized to 2^RANS_SCALE_BITS. Even and odd symbols go through two interleaved 32-bit
+/// states sharing one byte stream, which halves the dependency chain of the decoder.
+const uint32_t RANS_SCALE_BITS = 12;
+const uint32_t RANS_SCALE = 1u << RANS_SCALE_BITS;
+const uint32_t RANS_LOW = 1u << 23;
+
+void normalizeFrequencies (const std::vector<uint8_t> & symbols, uint32_t freqs[CLASS_COUNT])
+{
+	uint64_t counts[CLASS_COUNT] = { 0 };
+	for (uint8_t s : symbols)
+		counts[s]++;
+	uint32_t sum = 0;
+	for (uint32_t s = 0; s < CLASS_COUNT; s++)
+	{
+		freqs[s] = counts[s] ? std::max<uint32_t> (1, static_cast<uint32_t> (counts[s] * RANS_SCALE / symbols.size ())) : 0;
+		sum += freqs[s];
+	}
+	// Rounding leaves the total off by less than CLASS_COUNT: settle the difference on the most frequent symbol
+	uint32_t best = 0;
+	for (uint32_t s = 1; s < CLASS_COUNT; s++)
+		if (freqs[s] > freqs[best])
+			best = s;
+	freqs[best] = freqs[best] + RANS_SCALE - sum;
+}
+
+/// Appends a block to out: byte size, number of values, frequency table, rANS payload of the bit
+/// lengths, raw low bits (zero-padded so that the decoder can always load 8 bytes at once)
+void encodeBlock (const std::vector<uint32_t> & values, std::vector<uint8_t> & out)
+{
+	std::vector<uint8_t> block;
+	writeVarint (block, static_cast<uint32_t> (values.size ()));
+	if (!values.empty ())
+	{
+		std::vector<uint8_t> symbols (values.size ());
+		std::vector<uint8_t> raw;
+		uint64_t bits = 0;
+		unsigned int numBits = 0;
+		for (size_t i = 0; i < values.size (); i++)
+		{
+			uint32_t k = bitLength (values[i]);
+			symbols[i] = static_cast<uint8_t> (k);
+			if (k > 1)
+			{
+				bits |= static_cast<uint64_t> (values[i] & ((1u << (k - 1)) - 1)) << numBits;
+				numBits += k - 1;
+				while (numBits >= 8)
+				{
+					raw.push_back (static_cast<uint8_t> (bits));
+					bits >>= 8;
+					numBits -= 8;
+				}
+			}
+		}
+		if (numBits)
+			raw.push_back (static_cast<uint8_t> (bits));
+		raw.resize (raw.size () + 8, 0);
+
+		uint32_t freqs[CLASS_COUNT], starts[CLASS_COUNT];
+		normalizeFrequencies (symbols, freqs);
+		for (uint32_t s = 0, start = 0; s < CLASS_COUNT; s++)
+		{
+			starts[s] = start;
+			start += freqs[s];
+			writeVarint (block, freqs[s]);
+		}
+		// rANS encodes backwards: the payload is produced reversed and flipped at the end
+		std::vector<uint8_t> payload;
+		payload.reserve (symbols.size ());
+		uint32_t states[2] = { RANS_LOW, RANS_LOW };
+		for (size_t i = symbols.size (); i-- > 0;)
+		{
+			uint32_t & x = states[i & 1];
+			uint32_t f = freqs[symbols[i]];
+			uint32_t xMax = ((RANS_LOW >> RANS_SCALE_BITS) << 8) * f;
+			while (x >= xMax)
+			{
+				payload.push_back (static_cast<uint8_t> (x));
+				x >>= 8;
+			}
+			x = ((x / f) << RANS_SCALE_BITS) + (x % f) + starts[symbols[i]];
+		}
+		for (int k = 1; k >= 0; k--)
+			for (int shift = 24; shift >= 0; shift -= 8)
+				payload.push_back (static_cast<uint8_t> (states[k] >> shift));
+		writeVarint (block, static_cast<uint32_t> (payload.size ()));
+		block.insert (block.end (), payload.rbegin (), payload.rend ());
+		block.insert (block.end (), raw.begin (), raw.end ());
+	}
+
+	uint32_t blockSize = static_cast<uint32_t> (block.size ());
+	uint8_t prefix[4] = { uint8_t (blockSize), uint8_t (blockSize >> 8), uint8_t (blockSize >> 16), uint8_t (blockSize >> 24) };
+	out.insert (out.end (), prefix, prefix + 4);
+	out.insert (out.end (), block.begin (), block.end ());
+}
+
+/// Decodes a block written by encodeBlock (without its size prefix) into values
+void decodeBlock (const uint8_t * p, const uint8_t * end, std::vector<uint32_t> & values)
+{
+	uint32_t numValues = readVarint (p, end);
+	values.resize (numValues);
+	if (numValues == 0)
+		return;
+
+	// One entry per slot: symbol (6 bits), then its frequency (13 bits) and the start of its slot range
+	uint32_t slots[RANS_SCALE];
+	uint32_t start = 0;
+	for (uint32_t s = 0; s < CLASS_COUNT; s++)
+	{
+		uint32_t freq = readVarint (p, end);
+		if (freq > RANS_SCALE - start)
+			throw std::ios_base::failure ("[Mesh Archive][decodeBlock] Corrupted frequency table");
+		for (uint32_t slot = start; slot < start + freq; slot++)
+			slots[slot] = s | (freq << 6) | (start << 19);
+		start += freq;
+	}
+	uint32_t payloadSize = readVarint (p, end);
+	if (start != RANS_SCALE || payloadSize < 8 || static_cast<size_t> (end - p) < payloadSize + 8)
+		throw std::ios_base::failure ("[Mesh Archive][decodeBlock] Corrupted block");
+
+	const uint8_t * payloadEnd = p + payloadSize;
+	const uint8_t * raw = payloadEnd;
+	size_t rawBits = static_cast<size_t> (end - raw - 8) * 8;
+	size_t bitPosition = 0;
+	uint32_t states[2];
+	for (int k = 0; k < 2; k++, p += 4)
+		states[k] = uint32_t (p[0]) | (uint32_t (p[1]) << 8) | (uint32_t (p[2]) << 16) | (uint32_t (p[3]) << 24);
+	for (uint32_t i = 0; i < numValues; i++)
+	{
+		uint32_t & x = states[i & 1];
+		uint32_t slot = x & (RANS_SCALE - 1);
+		uint32_t entry = slots[slot];
+		uint32_t k = entry & 0x3F;
+		x = ((entry >> 6) & 0x1FFF) * (x >> RANS_SCALE_BITS) + slot - (entry >> 19);
+		while (x < RANS_LOW && p < payloadEnd)
+			x = (x << 8) | *p++;
+		if (k <= 1)
+		{
+			values[i] = k;
+			continue;
+		}
+		if (bitPosition + k - 1 > rawBits)
+			throw std::ios_base::failure ("[Mesh Archive][decodeBlock] Corrupted block");
+		uint64_t bits;
+		std::memcpy (&bits, raw + (bitPosition >> 3), sizeof (uint64_t)); // Little-endian, as written
+		bits >>= (bitPosition & 7);
+		values[i] = (1u << (k - 1)) | (static_cast<uint32_t> (bits) & ((1u << (k - 1)) - 1));
+		bitPosition += k - 1;
+	}
+}
+
+inline uint32_t quantize (float v, float minV, float maxV, uint32_t maxQ)
+{
+	float extent = maxV - minV;
+	if (extent <= 0.f)
+		return 0;
+	float t = std::min (std::max ((v - minV) / extent, 0.f), 1.f);
+	return static_cast<uint32_t> (std::lround (t * maxQ));
+}
+
+inline float dequantize (uint32_t q, float minV, float maxV, uint32_t maxQ)
+{
+	return minV + (maxV - minV) * (static_cast<float> (q) / static_cast<float> (maxQ));
+}
+
+/// Octahedral normal encoding (Meyer et al., "On Floating-Point Normal Vectors", 2010)
+inline void encodeOctahedral (glm::vec3 n, uint32_t maxQ, uint32_t & u, uint32_t & v)
+{
+	float l1 = std::abs (n.x) + std::abs (n.y) + std::abs (n.z);
+	if (l1 <= 0.f)
+		n = glm::vec3 (0.f, 0.f, 1.f);
+	else
+		n /= l1;
+	float x = n.x, y = n.y;
+	if (n.z < 0.f)
+	{
+		x = (1.f - std::abs (n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+		y = (1.f - std::abs (n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+	}
+	u = quantize (x, -1.f, 1.f, maxQ);
+	v = quantize (y, -1.f, 1.f, maxQ);
+}
+
+inline glm::vec3 decodeOctahedral (uint32_t u, uint32_t v, uint32_t maxQ)
+{
+	glm::vec3 n (dequantize (u, -1.f, 1.f, maxQ), dequantize (v, -1.f, 1.f, maxQ), 0.f);
+	n.z = 1.f - std::abs (n.x) - std::abs (n.y);
+	if (n.z < 0.f)
+	{
+		float x = n.x;
+		n.x = (1.f - std::abs (n.y)) * (x >= 0.f ? 1.f : -1.f);
+		n.y = (1.f - std::abs (x)) * (n.y >= 0.f ? 1.f : -1.f);
+	}
+	return glm::normalize (n);
+}
+
+/// Cuts [0, count) in blocks of blockItems and appends the encoding of each to out. valuesOf fills
+/// the values of the block [first, last); deltas must restart at first so that blocks stay independent.
+template<typename Fn>
+void encodeStream (size_t count, uint32_t blockItems, std::vector<uint8_t> & out, Fn valuesOf)
+{
+	std::vector<uint32_t> values;
+	for (size_t first = 0; first < count; first += blockItems)
+	{
+		values.clear ();
+		valuesOf (first, std::min (count, first + blockItems), values);
+		encodeBlock (values, out);
+	}
+}
+
+/// A block located in the mapped file, with the range of items it holds
+struct BlockRef {
+	const uint8_t * begin;
+	const uint8_t * end;
+	size_t first;
+	size_t last;
+	int stream;
+};
+
+void locateBlocks (const uint8_t * p, const uint8_t * end, int stream, size_t count, uint32_t blockItems, std::vector<BlockRef> & blocks)
+{
+	for (size_t first = 0; first < count; first += blockItems)
+	{
+		if (end - p < 4)
+			throw std::ios_base::failure ("[Mesh Archive][load] Truncated stream");
+		uint32_t size = uint32_t (p[0]) | (uint32_t (p[1]) << 8) | (uint32_t (p[2]) << 16) | (uint32_t (p[3]) << 24);
+		p += 4;
+		if (static_cast<size_t> (end - p) < size)
+			throw std::ios_base::failure ("[Mesh Archive][load] Truncated stream");
+		blocks.push_back ({ p, p + size, first, std::min (count, first + blockItems), stream });
+		p += size;
+	}
+}
+
+}
+
+void MeshArchive::save (const std::string & filename, std::shared_ptr<Mesh> meshPtr, unsigned int positionBits, unsigned int normalBits)
+{
+	if (positionBits < 1 || positionBits > 24)
+		throw std::runtime_error ("[Mesh Archive][save] Position bits must be between 1 and 24");
+	if (normalBits < 2 || normalBits > 16)
+		throw std::runtime_error ("[Mesh Archive][save] Normal bits must be between 2 and 16");
+
+	const auto & P = meshPtr->vertexPositions ();
+	const auto & N = meshPtr->vertexNormals ();
+	const auto & UV = meshPtr->vertexTexCoords ();
+	const auto & T = meshPtr->triangleIndices ();
+	if (N.size () != P.size () || UV.size () != P.size ())
+		throw std::ios_base::failure ("[Mesh Archive][save] Vertex attributes of the mesh are not computed");
+	auto start = std::chrono::high_resolution_clock::now ();
+
+	QMeshHeader header;
+	std::memset (&header, 0, sizeof (QMeshHeader));
+	std::memcpy (header.magic, "QMSH", 4);
+	header.version = QMESH_VERSION;
+	header.flags = meshPtr->hasTexCoords () ? QMESH_FLAG_TEXCOORDS : 0;
+	header.numVertices = static_cast<uint32_t> (P.size ());
+	header.numTriangles = static_cast<uint32_t> (T.size ());
+	header.positionBits = positionBits;
+	header.normalBits = normalBits;
+	header.blockItems = QMESH_BLOCK_ITEMS;
+	glm::vec3 bbMin (0.f), bbMax (0.f);
+	if (!P.empty ())
+		meshPtr->computeBoundingBox (bbMin, bbMax);
+	glm::vec2 uvMin (0.f), uvMax (0.f);
+	if (!UV.empty ())
+	{
+		uvMin = uvMax = UV[0];
+		for (const auto & uv : UV)
+		{
+			uvMin = glm::min (uvMin, uv);
+			uvMax = glm::max (uvMax, uv);
+		}
+	}
+	for (int c = 0; c < 3; c++)
+	{
+		header.bbMin[c] = bbMin[c];
+		header.bbMax[c] = bbMax[c];
+	}
+	for (int c = 0; c < 2; c++)
+	{
+		header.uvMin[c] = uvMin[c];
+		header.uvMax[c] = uvMax[c];
+	}
+
+	// Vertices are renumbered in order of first reference by the triangles. Each corner then either
+	// introduces the next vertex or points a short distance back, and consecutive vertices are mostly
+	// neighbours on the surface, so that the deltas of their attributes stay small.
+	std::vector<uint32_t> order, remap (P.size (), UINT32_MAX);
+	order.reserve (P.size ());
+	for (const auto & t : T)
+		for (int j = 0; j < 3; j++)
+			if (remap[t[j]] == UINT32_MAX)
+			{
+				remap[t[j]] = static_cast<uint32_t> (order.size ());
+				order.push_back (t[j]);
+			}
+	for (uint32_t v = 0; v < P.size (); v++)
+		if (remap[v] == UINT32_MAX)
+		{
+			remap[v] = static_cast<uint32_t> (order.size ());
+			order.push_back (v);
+		}
+
+	std::vector<uint8_t> streams[QMESH_STREAM_COUNT];
+	uint32_t maxPosition = (1u << positionBits) - 1;
+	encodeStream (P.size (), QMESH_BLOCK_ITEMS, streams[QMESH_POSITIONS], [&] (size_t first, size_t last, std::vector<uint32_t> & values) {
+		uint32_t previous[3] = { 0, 0, 0 };
+		for (size_t i = first; i < last; i++)
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t q = quantize (P[order[i]][c], bbMin[c], bbMax[c], maxPosition);
+				values.push_back (zigzag (static_cast<int32_t> (q - previous[c])));
+				previous[c] = q;
+			}
+	});
+	uint32_t maxNormal = (1u << normalBits) - 1;
+	encodeStream (N.size (), QMESH_BLOCK_ITEMS, streams[QMESH_NORMALS], [&] (size_t first, size_t last, std::vector<uint32_t> & values) {
+		uint32_t previous[2] = { 0, 0 };
+		for (size_t i = first; i < last; i++)
+		{
+			uint32_t q[2];
+			encodeOctahedral (N[order[i]], maxNormal, q[0], q[1]);
+			for (int c = 0; c < 2; c++)
+			{
+				values.push_back (zigzag (static_cast<int32_t> (q[c] - previous[c])));
+				previous[c] = q[c];
+			}
+		}
+	});
+	if (header.flags & QMESH_FLAG_TEXCOORDS)
+	{
+		uint32_t maxTexCoord = (1u << QMESH_TEXCOORD_BITS) - 1;
+		encodeStream (UV.size (), QMESH_BLOCK_ITEMS, streams[QMESH_TEXCOORDS], [&] (size_t first, size_t last, std::vector<uint32_t> & values) {
+			uint32_t previous[2] = { 0, 0 };
+			for (size_t i = first; i < last; i++)
+				for (int c = 0; c < 2; c++)
+				{
+					uint32_t q = quantize (UV[order[i]][c], uvMin[c], uvMax[c], maxTexCoord);
+					values.push_back (zigzag (static_cast<int32_t> (q - previous[c])));
+					previous[c] = q;
+				}
+		});
+	}
+	// A block starts with the number of vertices introduced before it (the high-water mark), then each
+	// corner is 0 if it introduces the next vertex, its distance below the high-water mark otherwise.
+	std::vector<uint32_t> highWaterMarks;
+	for (size_t first = 0, mark = 0; first < T.size (); first++)
+	{
+		if (first % QMESH_BLOCK_ITEMS == 0)
+			highWaterMarks.push_back (static_cast<uint32_t> (mark));
+		for (int j = 0; j < 3; j++)
+			mark = std::max<size_t> (mark, remap[T[first][j]] + 1);
+	}
+	encodeStream (T.size (), QMESH_BLOCK_ITEMS, streams[QMESH_INDICES], [&] (size_t first, size_t last, std::vector<uint32_t> & values) {
+		uint32_t mark = highWaterMarks[first / QMESH_BLOCK_ITEMS];
+		values.push_back (mark);
+		for (size_t i = first; i < last; i++)
+			for (int j = 0; j < 3; j++)
+			{
+				uint32_t v = remap[T[i][j]];
+				if (v == mark)
+				{
+					values.push_back (0);
+					mark++;
+				}
+				else
+					values.push_back (mark - v);
+			}
+	});
+
+	uint64_t fileSize = sizeof (QMeshHeader);
+	for (int s = 0; s < QMESH_STREAM_COUNT; s++)
+	{
+		header.streamSizes[s] = streams[s].size ();
+		fileSize += streams[s].size ();
+	}
+
+	// Written to a temporary file first so that a crash never leaves a truncated archive behind
+	std::string tmpFilename = filename + ".tmp";
+	{
+		std::ofstream out (tmpFilename, std::ios::binary | std::ios::trunc);
+		if (!out)
+			throw std::ios_base::failure ("[Mesh Archive][save] Cannot open " + tmpFilename);
+		out.write (reinterpret_cast<const char *> (&header), sizeof (QMeshHeader));
+		for (int s = 0; s < QMESH_STREAM_COUNT; s++)
+			out.write (reinterpret_cast<const char *> (streams[s].data ()), streams[s].size ());
+		if (!out)
+		{
+			out.close ();
+			std::remove (tmpFilename.c_str ());
+			throw std::ios_base::failure ("[Mesh Archive][save] Cannot write " + tmpFilename);
+		}
+	}
+	if (std::rename (tmpFilename.c_str (), filename.c_str ()) != 0)
+	{
+		std::remove (tmpFilename.c_str ());
+		throw std::ios_base::failure ("[Mesh Archive][save] Cannot rename " + tmpFilename + " to " + filename);
+	}
+
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	size_t rawBytes = P.size () * (sizeof (glm::vec3) * 2 + (header.flags & QMESH_FLAG_TEXCOORDS ? sizeof (glm::vec2) : 0)) + T.size () * sizeof (glm::uvec3);
+	std::cout << " > Mesh archive <" << filename << "> written: " << fileSize / 1024.0 << " KB in " << seconds * 1000.0 << " ms ("
+			  << positionBits << " bits per coordinate, " << normalBits << " bits per normal component, "
+			  << (fileSize ? double (rawBytes) / fileSize : 0.0) << "x smaller than the raw arrays)" << std::endl;
+}
+
+void MeshArchive::load (const std::string & filename, std::shared_ptr<Mesh> meshPtr, unsigned int numThreads)
+{
+	std::cout << " > Start loading mesh archive <" << filename << ">" << std::endl;
+	meshPtr->clear ();
+	auto start = std::chrono::high_resolution_clock::now ();
+
+	MappedFile file (filename);
+	QMeshHeader header;
+	if (file.size () < sizeof (QMeshHeader))
+		throw std::ios_base::failure ("[Mesh Archive][load] Truncated header in " + filename);
+	std::memcpy (&header, file.data (), sizeof (QMeshHeader));
+	if (std::memcmp (header.magic, "QMSH", 4) != 0)
+		throw std::ios_base::failure ("[Mesh Archive][load] Not a mesh archive: " + filename);
+	if (header.version != QMESH_VERSION)
+		throw std::ios_base::failure ("[Mesh Archive][load] Unsupported archive version in " + filename);
+	if (header.positionBits < 1 || header.positionBits > 24 || header.normalBits < 2 || header.normalBits > 16 || header.blockItems == 0)
+		throw std::ios_base::failure ("[Mesh Archive][load] Corrupted header in " + filename);
+
+	const uint8_t * p = reinterpret_cast<const uint8_t *> (file.data ()) + sizeof (QMeshHeader);
+	const uint8_t * end = reinterpret_cast<const uint8_t *> (file.data ()) + file.size ();
+	bool hasTexCoords = (header.flags & QMESH_FLAG_TEXCOORDS) != 0;
+	std::vector<BlockRef> blocks;
+	for (int s = 0; s < QMESH_STREAM_COUNT; s++)
+	{
+		if (header.streamSizes[s] > static_cast<uint64_t> (end - p))
+			throw std::ios_base::failure ("[Mesh Archive][load] Truncated stream in " + filename);
+		size_t count = (s == QMESH_INDICES ? header.numTriangles : (s == QMESH_TEXCOORDS && !hasTexCoords ? 0 : header.numVertices));
+		locateBlocks (p, p + header.streamSizes[s], s, count, header.blockItems, blocks);
+		p += header.streamSizes[s];
+	}
+
+	auto & P = meshPtr->vertexPositions ();
+	auto & N = meshPtr->vertexNormals ();
+	auto & UV = meshPtr->vertexTexCoords ();
+	auto & T = meshPtr->triangleIndices ();
+	P.resize (header.numVertices);
+	N.resize (header.numVertices);
+	UV.resize (header.numVertices, glm::vec2 (0.f, 0.f));
+	T.resize (header.numTriangles);
+
+	// Every block decodes into its own slice of the arrays: workers pull blocks from a shared counter
+	uint32_t maxPosition = (1u << header.positionBits) - 1;
+	uint32_t maxNormal = (1u << header.normalBits) - 1;
+	uint32_t maxTexCoord = (1u << QMESH_TEXCOORD_BITS) - 1;
+	auto decode = [&] (const BlockRef & block, std::vector<uint32_t> & values) {
+		decodeBlock (block.begin, block.end, values);
+		size_t perItem = (block.stream == QMESH_POSITIONS || block.stream == QMESH_INDICES ? 3 : 2);
+		size_t leading = (block.stream == QMESH_INDICES ? 1 : 0); // High-water mark of the connectivity blocks
+		if (values.size () != (block.last - block.first) * perItem + leading)
+			throw std::ios_base::failure ("[Mesh Archive][load] Corrupted block in " + filename);
+		const uint32_t * v = values.data ();
+		if (block.stream == QMESH_POSITIONS)
+		{
+			uint32_t q[3] = { 0, 0, 0 };
+			for (size_t i = block.first; i < block.last; i++, v += 3)
+				for (int c = 0; c < 3; c++)
+				{
+					q[c] += static_cast<uint32_t> (unzigzag (v[c]));
+					P[i][c] = dequantize (q[c], header.bbMin[c], header.bbMax[c], maxPosition);
+				}
+		}
+		else if (block.stream == QMESH_NORMALS)
+		{
+			uint32_t q[2] = { 0, 0 };
+			for (size_t i = block.first; i < block.last; i++, v += 2)
+			{
+				q[0] += static_cast<uint32_t> (unzigzag (v[0]));
+				q[1] += static_cast<uint32_t> (unzigzag (v[1]));
+				N[i] = decodeOctahedral (q[0], q[1], maxNormal);
+			}
+		}
+		else if (block.stream == QMESH_TEXCOORDS)
+		{
+			uint32_t q[2] = { 0, 0 };
+			for (size_t i = block.first; i < block.last; i++, v += 2)
+				for (int c = 0; c < 2; c++)
+				{
+					q[c] += static_cast<uint32_t> (unzigzag (v[c]));
+					UV[i][c] = dequantize (q[c], header.uvMin[c], header.uvMax[c], maxTexCoord);
+				}
+		}
+		else
+		{
+			uint32_t mark = *v++;
+			for (size_t i = block.first; i < block.last; i++, v += 3)
+				for (int j = 0; j < 3; j++)
+				{
+					if (v[j] == 0)
+						T[i][j] = mark++;
+					else if (v[j] <= mark)
+						T[i][j] = mark - v[j];
+					else
+						throw std::ios_base::failure ("[Mesh Archive][load] Corrupted connectivity in " + filename);
+					if (T[i][j] >= header.numVertices)
+						throw std::ios_base::failure ("[Mesh Archive][load] Vertex index out of range in " + filename);
+				}
+		}
+	};
+
+	if (numThreads == 0)
+		numThreads = std::max (std::thread::hardware_concurrency (), 1u);
+	numThreads = std::max (1u, std::min (numThreads, static_cast<unsigned int> (blocks.size ())));
+	std::atomic<size_t> nextBlock (0);
+	std::atomic<size_t> decodedBlocks (0);
+	std::vector<std::exception_ptr> errors (numThreads);
+	auto worker = [&] (unsigned int k) {
+		try
+		{
+			std::vector<uint32_t> values;
+			for (size_t b = nextBlock++; b < blocks.size (); b = nextBlock++)
+			{
+				decode (blocks[b], values);
+				size_t decoded = ++decodedBlocks;
+				if (k == 0) // Progress callbacks belong to the calling thread
+					MeshLoader::reportProgress (float (decoded) / blocks.size ());
+			}
+		}
+		catch (...)
+		{
+			errors[k] = std::current_exception ();
+		}
+	};
+	std::vector<std::thread> threads;
+	for (unsigned int k = 1; k < numThreads; k++)
+		threads.emplace_back (worker, k);
+	worker (0);
+	for (auto & thread : threads)
+		thread.join ();
+	for (auto & error : errors)
+		if (error)
+			std::rethrow_exception (error);
+	MeshLoader::reportProgress (1.f);
+
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	double megabytes = file.size () / (1024.0 * 1024.0);
+
+	meshPtr->setHasTexCoords (hasTexCoords);
+	meshPtr->recomputePerVertexNormals (true, true);
+	std::cout << " > Mesh archive <" << filename << "> loaded: " << megabytes << " MB decoded in " << seconds * 1000.0
+			  << " ms (" << blocks.size () << " blocks, " << numThreads << " thread(s))" << std::endl;
+}
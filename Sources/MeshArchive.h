@@ -0,0 +1,25 @@
+#ifndef MESH_ARCHIVE_H
+#define MESH_ARCHIVE_H
+
+#include <string>
+#include <memory>
+
+#include "Mesh.h"
+
+/// Compressed mesh container (.qmesh) meant for storage and transfer:
+/// positions quantized relative to the bounding box, octahedral-encoded normals, and delta-coded
+/// attributes and connectivity, entropy coded with rANS. Every stream is cut in independent
+/// blocks so that decoding runs on all cores. Vertices are renumbered in order of first use by the
+/// triangles, so a loaded mesh keeps its triangles but not its original vertex numbering.
+namespace MeshArchive {
+
+/// Writes the mesh in a compressed archive. positionBits (1 to 24) is the number of bits per
+/// coordinate, normalBits (2 to 16) the number of bits per octahedral normal component.
+void save (const std::string & filename, std::shared_ptr<Mesh> meshPtr, unsigned int positionBits = 16, unsigned int normalBits = 12);
+
+/// Decodes a compressed archive into the mesh, with numThreads threads (0 means one per core)
+void load (const std::string & filename, std::shared_ptr<Mesh> meshPtr, unsigned int numThreads = 0);
+
+}
+
+#endif // MESH_ARCHIVE_H
@@ -0,0 +1,222 @@
+#include "MeshLoader.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include "BMesh.h"
+
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <ios>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <filesystem>
+#include <system_error>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+/// Identity of the source file the cache was built from
+struct SourceStamp {
+	bool exists = false;
+	uint64_t size = 0;
+	int64_t time = 0;
+};
+
+static SourceStamp stampSource (const std::string & sourceFilename)
+{
+	SourceStamp stamp;
+	std::error_code ec;
+	stamp.size = fs::file_size (sourceFilename, ec);
+	if (ec)
+		return stamp;
+	auto time = fs::last_write_time (sourceFilename, ec);
+	if (ec)
+		return stamp;
+	stamp.time = static_cast<int64_t> (time.time_since_epoch ().count ());
+	stamp.exists = true;
+	return stamp;
+}
+
+static uint64_t hashSource (const std::string & sourceFilename)
+{
+	MappedFile source (sourceFilename);
+	return hashBytes (source.data (), source.size ());
+}
+
+static inline uint64_t alignOffset (uint64_t offset)
+{
+	return (offset + BMESH_ALIGNMENT - 1) / BMESH_ALIGNMENT * BMESH_ALIGNMENT;
+}
+
+template<typename T>
+static void copyArray (const MappedFile & file, uint64_t offset, size_t count, std::vector<T> & array)
+{
+	array.resize (count);
+	if (count)
+		std::memcpy (array.data (), file.data () + offset, count * sizeof (T));
+}
+
+bool MeshLoader::loadBMesh (const std::string & cacheFilename, const std::string & sourceFilename, std::shared_ptr<Mesh> meshPtr)
+{
+	std::error_code ec;
+	if (!fs::exists (cacheFilename, ec))
+		return false;
+
+	auto start = std::chrono::high_resolution_clock::now ();
+	SourceStamp stamp = stampSource (sourceFilename);
+	bool isTimeStale = false;
+	uint64_t fileSize = 0;
+	{
+		MappedFile file (cacheFilename);
+		fileSize = file.size ();
+		if (fileSize < sizeof (BMeshHeader))
+			return false;
+		BMeshHeader header;
+		std::memcpy (&header, file.data (), sizeof (BMeshHeader));
+		if (std::memcmp (header.magic, "BMSH", 4) != 0 || header.version != BMESH_VERSION || header.byteOrder != BMESH_BYTE_ORDER)
+			return false;
+
+		// The modification time is the fast path; a touched but unmodified source is recognized by its content hash.
+		// Without a source file the cache is the only data available and is used as is.
+		if (stamp.exists)
+		{
+			if (stamp.size != header.sourceSize)
+				return false;
+			if (stamp.time != header.sourceTime)
+			{
+				if (hashSource (sourceFilename) != header.sourceHash)
+					return false;
+				isTimeStale = true;
+			}
+		}
+
+		// The header cannot be trusted: a corrupted cache must fall back on the source, not read out of bounds
+		const size_t elementSizes[BMESH_ARRAY_COUNT] = { sizeof (glm::vec3), sizeof (glm::vec3), sizeof (glm::vec2),
+														 sizeof (glm::vec3), sizeof (glm::vec3), sizeof (glm::uvec3) };
+		for (int a = 0; a < BMESH_ARRAY_COUNT; a++)
+		{
+			uint64_t count = (a == BMESH_INDICES ? header.numTriangles : header.numVertices);
+			if (header.offsets[a] > fileSize || count > (fileSize - header.offsets[a]) / elementSizes[a])
+				return false; // Truncated cache
+		}
+
+		meshPtr->clear ();
+		copyArray (file, header.offsets[BMESH_POSITIONS], header.numVertices, meshPtr->vertexPositions ());
+		copyArray (file, header.offsets[BMESH_NORMALS], header.numVertices, meshPtr->vertexNormals ());
+		copyArray (file, header.offsets[BMESH_TEXCOORDS], header.numVertices, meshPtr->vertexTexCoords ());
+		copyArray (file, header.offsets[BMESH_TANGENTS], header.numVertices, meshPtr->vertexTangents ());
+		copyArray (file, header.offsets[BMESH_BITANGENTS], header.numVertices, meshPtr->vertexBitangents ());
+		copyArray (file, header.offsets[BMESH_INDICES], header.numTriangles, meshPtr->triangleIndices ());
+		for (const glm::uvec3 & t : meshPtr->triangleIndices ())
+			if (t[0] >= header.numVertices || t[1] >= header.numVertices || t[2] >= header.numVertices)
+			{
+				meshPtr->clear ();
+				return false;
+			}
+		meshPtr->setHasTexCoords ((header.flags & BMESH_FLAG_FILE_TEXCOORDS) != 0);
+	}
+
+	// The source was touched without being modified: its new time spares hashing it at the next loads
+	if (isTimeStale)
+	{
+		std::fstream out (cacheFilename.c_str (), std::ios::binary | std::ios::in | std::ios::out);
+		out.seekp (offsetof (BMeshHeader, sourceTime));
+		out.write (reinterpret_cast<const char *> (&stamp.time), sizeof (stamp.time));
+		if (!out) // Only costs the hash again
+			std::cerr << " > [Warning] Cannot update the source time of " << cacheFilename << std::endl;
+	}
+	reportProgress (1.f);
+
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	double megabytes = fileSize / (1024.0 * 1024.0);
+	std::cout << " > Mesh <" << sourceFilename << "> loaded from cache <" << cacheFilename << ">: " << megabytes << " MB in "
+			  << seconds * 1000.0 << " ms (" << megabytes / seconds << " MB/s)" << std::endl;
+	return true;
+}
+
+template<typename T>
+static void writeArray (std::ofstream & out, uint64_t offset, const std::vector<T> & array)
+{
+	static const char padding[BMESH_ALIGNMENT] = { 0 };
+	uint64_t position = static_cast<uint64_t> (out.tellp ());
+	out.write (padding, offset - position);
+	out.write (reinterpret_cast<const char *> (array.data ()), array.size () * sizeof (T));
+}
+
+void MeshLoader::saveBMesh (const std::string & cacheFilename, const std::string & sourceFilename, std::shared_ptr<Mesh> meshPtr)
+{
+	size_t numVertices = meshPtr->vertexPositions ().size ();
+	if (meshPtr->vertexNormals ().size () != numVertices || meshPtr->vertexTexCoords ().size () != numVertices ||
+		meshPtr->vertexTangents ().size () != numVertices || meshPtr->vertexBitangents ().size () != numVertices)
+		throw std::ios_base::failure ("[Mesh Loader][saveBMesh] Vertex attributes of " + sourceFilename + " are not computed");
+
+	SourceStamp stamp = stampSource (sourceFilename);
+	if (!stamp.exists)
+		throw std::ios_base::failure ("[Mesh Loader][saveBMesh] Cannot stat " + sourceFilename);
+
+	BMeshHeader header;
+	std::memset (&header, 0, sizeof (BMeshHeader));
+	std::memcpy (header.magic, "BMSH", 4);
+	header.version = BMESH_VERSION;
+	header.byteOrder = BMESH_BYTE_ORDER;
+	header.numVertices = static_cast<uint32_t> (numVertices);
+	header.numTriangles = static_cast<uint32_t> (meshPtr->triangleIndices ().size ());
+	header.flags = meshPtr->hasTexCoords () ? BMESH_FLAG_FILE_TEXCOORDS : 0;
+	header.sourceSize = stamp.size;
+	header.sourceTime = stamp.time;
+	header.sourceHash = hashSource (sourceFilename);
+
+	uint64_t offset = alignOffset (sizeof (BMeshHeader));
+	const size_t arraySizes[BMESH_ARRAY_COUNT] = { numVertices * sizeof (glm::vec3), numVertices * sizeof (glm::vec3), numVertices * sizeof (glm::vec2),
+												   numVertices * sizeof (glm::vec3), numVertices * sizeof (glm::vec3), header.numTriangles * sizeof (glm::uvec3) };
+	for (int a = 0; a < BMESH_ARRAY_COUNT; a++)
+	{
+		header.offsets[a] = offset;
+		offset = alignOffset (offset + arraySizes[a]);
+	}
+
+	// Write to a temporary file first so that a concurrent reader never sees a partial cache
+	std::string tmpFilename = cacheFilename + ".tmp";
+	{
+		std::ofstream out (tmpFilename.c_str (), std::ios::binary | std::ios::trunc);
+		if (!out)
+			throw std::ios_base::failure ("[Mesh Loader][saveBMesh] Cannot open " + tmpFilename);
+		out.write (reinterpret_cast<const char *> (&header), sizeof (BMeshHeader));
+		writeArray (out, header.offsets[BMESH_POSITIONS], meshPtr->vertexPositions ());
+		writeArray (out, header.offsets[BMESH_NORMALS], meshPtr->vertexNormals ());
+		writeArray (out, header.offsets[BMESH_TEXCOORDS], meshPtr->vertexTexCoords ());
+		writeArray (out, header.offsets[BMESH_TANGENTS], meshPtr->vertexTangents ());
+		writeArray (out, header.offsets[BMESH_BITANGENTS], meshPtr->vertexBitangents ());
+		writeArray (out, header.offsets[BMESH_INDICES], meshPtr->triangleIndices ());
+		if (!out)
+			throw std::ios_base::failure ("[Mesh Loader][saveBMesh] Cannot write " + tmpFilename);
+	}
+	std::error_code ec;
+	fs::rename (tmpFilename, cacheFilename, ec);
+	if (ec)
+	{
+		fs::remove (tmpFilename, ec);
+		throw std::ios_base::failure ("[Mesh Loader][saveBMesh] Cannot write " + cacheFilename);
+	}
+}
+
+void MeshLoader::loadCached (const std::string & filename, std::shared_ptr<Mesh> meshPtr)
+{
+	std::string cacheFilename = filename + ".bmesh";
+	if (loadBMesh (cacheFilename, filename, meshPtr))
+		return;
+
+	load (filename, meshPtr);
+
+	try
+	{
+		saveBMesh (cacheFilename, filename, meshPtr);
+	}
+	catch (std::exception & e) // A missing cache only costs time, it is not an error
+	{
+		std::cerr << " > [Warning] " << e.what () << std::endl;
+	}
+}
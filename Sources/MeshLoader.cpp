@@ -1,54 +1,289 @@
 #include "MeshLoader.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
+#include "MeshArchive.h"
+#include "Profiler.h"
 
 #include <iostream>
-#include <fstream>
 #include <exception>
 #include <ios>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <filesystem>
+#include <cctype>
+#include <functional>
+#include <fstream>
+#include <charconv>
 
 using namespace std;
 
-void MeshLoader::loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr) 
+// Below this size, spawning threads costs more than it saves
+static const size_t PARALLEL_OFF_MIN_BYTES = 4 * 1024 * 1024;
+
+static inline void parseOFFFace (TextScanner & in, glm::uvec3 & t)
 {
-	std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
-    meshPtr->clear ();
-	ifstream in (filename.c_str ());
-
-    if (!in)
-        throw std::ios_base::failure ("[Mesh Loader][loadOFF] Cannot open " + filename);
-
-	string offString;
-    unsigned int sizeV, sizeT, tmp;
-    in >> offString >> sizeV >> sizeT >> tmp;
-    auto & P = meshPtr->vertexPositions ();
-    auto & T = meshPtr->triangleIndices ();
-    P.resize (sizeV);
-    T.resize (sizeT);
-    size_t tracker = (sizeV + sizeT)/20;
-    std::cout << " > [" << std::flush;
-
-    for (unsigned int i = 0; i < sizeV; i++) 
+	unsigned int s = in.readUInt ();
+
+	for (unsigned int j = 0; j < 3; j++)
+		t[j] = in.readUInt ();
+
+	for (unsigned int j = 3; j < s; j++) // Only the first triangle of larger polygons is kept
+		in.readUInt ();
+}
+
+/// Progress callback of the loads run by each thread
+static thread_local std::function<void (float)> progressCallback;
+
+void MeshLoader::setProgressCallback (std::function<void (float)> callback)
+{
+	progressCallback = std::move (callback);
+}
+
+void MeshLoader::reportProgress (float fraction)
+{
+	if (progressCallback)
+		progressCallback (fraction);
+}
+
+static void parseOFFSerial (TextScanner & in, std::vector<glm::vec3> & P, std::vector<glm::uvec3> & T)
+{
+	size_t sizeV = P.size ();
+	size_t sizeT = T.size ();
+	size_t tracker = std::max<size_t> ((sizeV + sizeT)/100, 1);
+
+	for (size_t i = 0; i < sizeV; i++)
+	{
+		if (i % tracker == 0)
+			MeshLoader::reportProgress (float (i) / (sizeV + sizeT));
+
+		P[i][0] = in.readFloat ();
+		P[i][1] = in.readFloat ();
+		P[i][2] = in.readFloat ();
+	}
+
+	for (size_t i = 0; i < sizeT; i++)
 	{
-    	if (i % tracker == 0)
-    		std::cout << "-" << std::flush;
+		if ((sizeV + i) % tracker == 0)
+			MeshLoader::reportProgress (float (sizeV + i) / (sizeV + sizeT));
+
+		parseOFFFace (in, T[i]);
+	}
+}
+
+/// Number of lines holding a record (i.e. neither blank nor comment) in [begin, end)
+static size_t countOFFRecords (const char * begin, const char * end)
+{
+	size_t count = 0;
+	const char * cur = begin;
+	while (cur < end)
+	{
+		while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\f' || *cur == '\v'))
+			++cur;
+		if (cur < end && *cur != '\n' && *cur != '#')
+			++count;
+		const char * eol = static_cast<const char *> (std::memchr (cur, '\n', end - cur));
+		cur = eol ? eol + 1 : end;
+	}
+	return count;
+}
+
+/// Parses the records of [begin, end), the first one being the record number firstRecord of the body
+static void parseOFFChunk (const char * begin, const char * end, size_t firstRecord,
+						   std::vector<glm::vec3> & P, std::vector<glm::uvec3> & T)
+{
+	PROFILE_ZONE ("parseOFFChunk");
+	TextScanner in (begin, end);
+	size_t sizeV = P.size ();
+	for (size_t record = firstRecord; !in.atEnd (); record++)
+	{
+		if (record < sizeV)
+		{
+			glm::vec3 & p = P[record];
+			p[0] = in.readFloat ();
+			p[1] = in.readFloat ();
+			p[2] = in.readFloat ();
+		}
+		else
+			parseOFFFace (in, T[record - sizeV]);
+		in.skipLine (); // Drop optional per-element colors
+	}
+}
 
-        in >> P[i][0] >> P[i][1] >> P[i][2];
-    }
-    int s;
-    for (unsigned int i = 0; i < sizeT; i++) 
+/// Splits the body of the file in line-aligned chunks, counts the records of each chunk in
+/// parallel, then parses each chunk in parallel directly into its slice of P and T.
+/// Returns false if the body is not one record per line, in which case nothing was written.
+static bool parseOFFParallel (const char * body, const char * end, unsigned int numThreads,
+							  std::vector<glm::vec3> & P, std::vector<glm::uvec3> & T)
+{
+	size_t bodySize = end - body;
+	std::vector<const char *> bounds (numThreads + 1, end);
+	bounds[0] = body;
+	for (unsigned int k = 1; k < numThreads; k++)
 	{
-    	if ((sizeV + i) % tracker == 0)
-    		std::cout << "-" << std::flush;
+		const char * split = std::max (bounds[k-1], body + bodySize * k / numThreads);
+		const char * eol = static_cast<const char *> (std::memchr (split, '\n', end - split));
+		bounds[k] = eol ? eol + 1 : end;
+	}
+
+	std::vector<size_t> firstRecords (numThreads + 1, 0);
+	std::vector<std::thread> threads;
+	for (unsigned int k = 0; k < numThreads; k++)
+		threads.emplace_back ([&, k] () { firstRecords[k+1] = countOFFRecords (bounds[k], bounds[k+1]); });
+	for (auto & thread : threads)
+		thread.join ();
+	threads.clear ();
+
+	MeshLoader::reportProgress (0.2f);
+
+	// Fixup pass: turn the per-chunk counts into the global index of each chunk's first record
+	for (unsigned int k = 0; k < numThreads; k++)
+		firstRecords[k+1] += firstRecords[k];
+	if (firstRecords[numThreads] != P.size () + T.size ())
+		return false;
+
+	std::vector<std::exception_ptr> errors (numThreads);
+	for (unsigned int k = 0; k < numThreads; k++)
+		threads.emplace_back ([&, k] () {
+			try
+			{
+				parseOFFChunk (bounds[k], bounds[k+1], firstRecords[k], P, T);
+			}
+			catch (...)
+			{
+				errors[k] = std::current_exception ();
+			}
+		});
+	for (auto & thread : threads)
+		thread.join ();
+	for (auto & error : errors)
+		if (error)
+			std::rethrow_exception (error);
+	return true;
+}
+
+void MeshLoader::loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr, unsigned int numThreads)
+{
+	PROFILE_ZONE ("MeshLoader::loadOFF");
+	std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
+	meshPtr->clear ();
+	auto start = std::chrono::high_resolution_clock::now ();
+
+	MappedFile file (filename);
+	TextScanner in (file.begin (), file.end ());
+
+	size_t length;
+	const char * offString = in.readWord (length);
+	if (length != 3 || std::strncmp (offString, "OFF", 3) != 0)
+		throw std::ios_base::failure ("[Mesh Loader][loadOFF] Missing OFF header in " + filename);
+
+	unsigned int sizeV = in.readUInt ();
+	unsigned int sizeT = in.readUInt ();
+	in.readUInt (); // Number of edges, unused
+	in.skipLine ();
+	auto & P = meshPtr->vertexPositions ();
+	auto & T = meshPtr->triangleIndices ();
+	P.resize (sizeV);
+	T.resize (sizeT);
+
+	if (numThreads == 0)
+		numThreads = std::max (std::thread::hardware_concurrency (), 1u);
+	bool parsed = false;
+	if (numThreads > 1 && file.size () >= PARALLEL_OFF_MIN_BYTES)
+		parsed = parseOFFParallel (in.position (), file.end (), numThreads, P, T);
+	if (!parsed)
+		parseOFFSerial (in, P, T);
+	reportProgress (1.f);
+
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	double megabytes = file.size () / (1024.0 * 1024.0);
+
+	meshPtr->vertexNormals ().resize (P.size (), glm::vec3 (0.f, 0.f, 1.f));
+	meshPtr->vertexTexCoords ().resize (P.size (), glm::vec2 (0.f, 0.f));
+	meshPtr->recomputePerVertexNormals (true);
+	std::cout << " > Mesh <" << filename << "> loaded: " << megabytes << " MB parsed in " << seconds * 1000.0
+			  << " ms (" << megabytes / seconds << " MB/s, " << (parsed ? numThreads : 1) << " thread(s))" << std::endl;
+}
+
+static std::string lowerCaseExtension (const std::string & filename)
+{
+	std::string extension = std::filesystem::path (filename).extension ().string ();
+	std::transform (extension.begin (), extension.end (), extension.begin (), [] (unsigned char c) { return std::tolower (c); });
+	return extension;
+}
 
-        in >> s;
+void MeshLoader::load (const std::string & filename, std::shared_ptr<Mesh> meshPtr, unsigned int numThreads)
+{
+	PROFILE_ZONE ("MeshLoader::load");
+	std::string extension = lowerCaseExtension (filename);
+	if (extension == ".ply")
+		loadPLY (filename, meshPtr);
+	else if (extension == ".obj")
+		loadOBJ (filename, meshPtr);
+	else if (extension == ".off")
+		loadOFF (filename, meshPtr, numThreads);
+	else if (extension == ".qmesh")
+		MeshArchive::load (filename, meshPtr, numThreads);
+	else
+		throw std::ios_base::failure ("[Mesh Loader][load] Unsupported mesh format " + filename);
+}
 
-        for (unsigned int j = 0; j < 3; j++)
-            in >> T[i][j];
-    }
+void MeshLoader::saveOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr)
+{
+	saveOFF (filename, meshPtr->vertexPositions (), meshPtr->triangleIndices ());
+}
 
-    std::cout << "]" << std::endl;
-    in.close ();
-    meshPtr->vertexNormals ().resize (P.size (), glm::vec3 (0.f, 0.f, 1.f));
-    meshPtr->vertexTexCoords ().resize (P.size (), glm::vec2 (0.f, 0.f));
-    meshPtr->recomputePerVertexNormals (true);
-    std::cout << " > Mesh <" << filename << "> loaded" <<  std::endl;
+void MeshLoader::saveOFF (const std::string & filename, const std::vector<glm::vec3> & P, const std::vector<glm::uvec3> & T)
+{
+	std::ofstream out (filename, std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::ios_base::failure ("[Mesh Loader][saveOFF] Cannot open " + filename);
+	out << "OFF\n" << P.size () << " " << T.size () << " 0\n";
+
+	// Records are formatted with to_chars in a buffer flushed every few hundred kilobytes
+	std::vector<char> buffer (1 << 20);
+	const size_t flushSize = buffer.size () - 256; // Room left for one more record
+	size_t size = 0;
+	auto flush = [&] () {
+		out.write (buffer.data (), size);
+		size = 0;
+	};
+	for (const glm::vec3 & p : P)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			size += std::to_chars (buffer.data () + size, buffer.data () + buffer.size (), p[c]).ptr - (buffer.data () + size);
+			buffer[size++] = (c < 2 ? ' ' : '\n');
+		}
+		if (size > flushSize)
+			flush ();
+	}
+	for (const glm::uvec3 & t : T)
+	{
+		buffer[size++] = '3';
+		for (int c = 0; c < 3; c++)
+		{
+			buffer[size++] = ' ';
+			size += std::to_chars (buffer.data () + size, buffer.data () + buffer.size (), t[c]).ptr - (buffer.data () + size);
+		}
+		buffer[size++] = '\n';
+		if (size > flushSize)
+			flush ();
+	}
+	flush ();
+	if (!out)
+		throw std::ios_base::failure ("[Mesh Loader][saveOFF] Cannot write " + filename);
+}
+
+void MeshLoader::save (const std::string & filename, std::shared_ptr<Mesh> meshPtr)
+{
+	std::string extension = lowerCaseExtension (filename);
+	if (extension == ".off")
+		saveOFF (filename, meshPtr);
+	else if (extension == ".qmesh")
+		MeshArchive::save (filename, meshPtr);
+	else
+		throw std::ios_base::failure ("[Mesh Loader][save] Unsupported mesh format " + filename);
 }
@@ -3,14 +3,61 @@
 
 #include <string>
 #include <memory>
+#include <functional>
 
 #include "Mesh.h"
 
 namespace MeshLoader {
 
+/// Sets the function receiving the progress (from 0 to 1) of the loads run by the calling thread.
+/// Loaders report nothing on threads without a callback.
+void setProgressCallback (std::function<void (float)> callback);
+
+/// Reports the progress of the current load to the callback of the calling thread, if any
+void reportProgress (float fraction);
+
 /// Loads an OFF mesh file. See https://en.wikipedia.org/wiki/OFF_(file_format)
-void loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr);
+/// Large files are split in line-aligned chunks parsed concurrently by numThreads threads
+/// (0 means one per core). The result is identical to a serial parse.
+void loadOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr, unsigned int numThreads = 0);
+
+/// Loads a PLY mesh file, ASCII or binary of either endianness. See http://paulbourke.net/dataformats/ply/
+/// Only the vertex coordinates and the face indices are kept; polygons are fan-triangulated and
+/// unknown properties and elements are skipped without being decoded.
+void loadPLY (const std::string & filename, std::shared_ptr<Mesh> meshPtr);
+
+/// Loads a Wavefront OBJ mesh file. The distinct (position, texture coordinate, normal) index
+/// triplets of the face corners are welded into a single indexed vertex stream. Texture coordinates
+/// and normals provided for every corner are kept as is instead of being recomputed.
+void loadOBJ (const std::string & filename, std::shared_ptr<Mesh> meshPtr);
+
+/// Loads a mesh file, choosing the loader from the file extension (.off, .ply, .obj or .qmesh).
+/// numThreads bounds the threads of the loaders which have a parallel path (0 means one per core).
+void load (const std::string & filename, std::shared_ptr<Mesh> meshPtr, unsigned int numThreads = 0);
+
+/// Writes the vertex positions and the triangles of the mesh as an OFF file. Coordinates are
+/// printed with the shortest representation that reads back to the same floats.
+void saveOFF (const std::string & filename, std::shared_ptr<Mesh> meshPtr);
+
+/// Same with the positions and the triangles given directly, e.g. by OutOfCoreSimplifier which has no Mesh
+void saveOFF (const std::string & filename, const std::vector<glm::vec3> & P, const std::vector<glm::uvec3> & T);
+
+/// Writes a mesh file, choosing the format from the file extension (.off or .qmesh)
+void save (const std::string & filename, std::shared_ptr<Mesh> meshPtr);
+
+/// Loads a binary mesh cache (.bmesh) holding positions, normals, texture coordinates, tangents,
+/// bitangents and indices in GPU-ready layout. Returns false, leaving the mesh untouched, if the
+/// cache is missing, of another version, or stale with respect to sourceFilename.
+bool loadBMesh (const std::string & cacheFilename, const std::string & sourceFilename, std::shared_ptr<Mesh> meshPtr);
+
+/// Writes the attributes of a fully initialized mesh in a binary cache keyed by the size,
+/// modification time and content hash of sourceFilename.
+void saveBMesh (const std::string & cacheFilename, const std::string & sourceFilename, std::shared_ptr<Mesh> meshPtr);
+
+/// Loads a mesh through its binary cache stored next to it (<filename>.bmesh), falling back
+/// to the source file (see load), and refreshing the cache, whenever the cache is stale.
+void loadCached (const std::string & filename, std::shared_ptr<Mesh> meshPtr);
 
 }
 
-#endif // MESH_LOADER_H
\ No newline at end of file
+#endif // MESH_LOADER_H
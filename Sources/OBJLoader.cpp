@@ -0,0 +1,244 @@
+#include "MeshLoader.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
+
+#include <iostream>
+#include <exception>
+#include <ios>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+/// A face corner of an OBJ file: 1-based position, texture coordinate and normal indices, 0 when absent
+struct OBJCorner {
+	uint32_t v, t, n;
+	inline bool operator== (const OBJCorner & o) const { return v == o.v && t == o.t && n == o.n; }
+};
+
+/// Open-addressing hash map (linear probing, power-of-two capacity) from OBJ corners to welded
+/// vertex indices. Keys and values live in a single flat array: no node allocation, and a probe
+/// usually stays within one cache line.
+class CornerWeldMap {
+public:
+	CornerWeldMap (size_t expectedSize)
+	{
+		size_t capacity = 16;
+		while (capacity < 2 * expectedSize)
+			capacity *= 2;
+		m_slots.resize (capacity);
+	}
+
+	/// Returns the index of the welded vertex matching the corner, inserting newIndex if it is not known yet
+	inline uint32_t findOrInsert (const OBJCorner & corner, uint32_t newIndex, bool & inserted)
+	{
+		if (2 * (m_size + 1) > m_slots.size ())
+			grow ();
+		size_t mask = m_slots.size () - 1;
+		for (size_t i = hash (corner) & mask; ; i = (i + 1) & mask)
+		{
+			Slot & slot = m_slots[i];
+			if (slot.value == EMPTY)
+			{
+				slot.key = corner;
+				slot.value = newIndex;
+				m_size++;
+				inserted = true;
+				return newIndex;
+			}
+			if (slot.key == corner)
+			{
+				inserted = false;
+				return slot.value;
+			}
+		}
+	}
+
+private:
+	static const uint32_t EMPTY = 0xFFFFFFFFu;
+
+	struct Slot {
+		OBJCorner key;
+		uint32_t value = EMPTY;
+	};
+
+	static inline size_t hash (const OBJCorner & c)
+	{
+		uint64_t h = uint64_t (c.v) * 0x9E3779B97F4A7C15ull;
+		h ^= uint64_t (c.t) * 0xC2B2AE3D27D4EB4Full;
+		h ^= uint64_t (c.n) * 0x165667B19E3779F9ull;
+		return static_cast<size_t> (h ^ (h >> 29));
+	}
+
+	void grow ()
+	{
+		std::vector<Slot> old (m_slots.size () * 2);
+		old.swap (m_slots);
+		size_t mask = m_slots.size () - 1;
+		for (const Slot & slot : old)
+		{
+			if (slot.value == EMPTY)
+				continue;
+			size_t i = hash (slot.key) & mask;
+			while (m_slots[i].value != EMPTY)
+				i = (i + 1) & mask;
+			m_slots[i] = slot;
+		}
+	}
+
+	std::vector<Slot> m_slots;
+	size_t m_size = 0;
+};
+
+/// Lines parsed between two progress reports
+const size_t PROGRESS_LINES = 65536;
+
+/// Turns a 1-based (or negative, relative to the end) OBJ index into a 1-based index, 0 if out of range
+inline uint32_t resolveOBJIndex (long long index, size_t count)
+{
+	if (index < 0)
+		index += static_cast<long long> (count) + 1;
+	if (index < 1 || index > static_cast<long long> (count))
+		return 0;
+	return static_cast<uint32_t> (index);
+}
+
+}
+
+void MeshLoader::loadOBJ (const std::string & filename, std::shared_ptr<Mesh> meshPtr)
+{
+	std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
+	meshPtr->clear ();
+	auto start = std::chrono::high_resolution_clock::now ();
+
+	MappedFile file (filename);
+	TextScanner in (file.begin (), file.end ());
+
+	std::vector<glm::vec3> filePositions;
+	std::vector<glm::vec2> fileTexCoords;
+	std::vector<glm::vec3> fileNormals;
+	std::vector<OBJCorner> corners;
+	std::vector<uint32_t> polygonSizes;
+
+	// Pass 1: attribute arrays and face corners, as they appear in the file
+	for (size_t line = 0; !in.atEnd (); line++)
+	{
+		if (line % PROGRESS_LINES == 0)
+			reportProgress (0.9f * (in.position () - file.begin ()) / file.size ()); // Welding takes the rest
+		size_t length;
+		const char * keyword = in.readWord (length);
+		if (length == 1 && keyword[0] == 'v')
+		{
+			glm::vec3 p;
+			p[0] = in.readFloat ();
+			p[1] = in.readFloat ();
+			p[2] = in.readFloat ();
+			filePositions.push_back (p);
+		}
+		else if (length == 2 && keyword[0] == 'v' && keyword[1] == 't')
+		{
+			glm::vec2 t;
+			t[0] = in.readFloat ();
+			t[1] = in.atEndOfLine () ? 0.f : in.readFloat ();
+			fileTexCoords.push_back (t);
+		}
+		else if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n')
+		{
+			glm::vec3 n;
+			n[0] = in.readFloat ();
+			n[1] = in.readFloat ();
+			n[2] = in.readFloat ();
+			fileNormals.push_back (n);
+		}
+		else if (length == 1 && keyword[0] == 'f')
+		{
+			uint32_t size = 0;
+			while (!in.atEndOfLine ())
+			{
+				OBJCorner corner = { 0, 0, 0 };
+				corner.v = resolveOBJIndex (in.read<long long> (), filePositions.size ());
+				if (corner.v == 0)
+					throw std::ios_base::failure ("[Mesh Loader][loadOBJ] Vertex index out of range in " + filename);
+				if (in.position () < in.end () && *in.position () == '/')
+				{
+					in.setPosition (in.position () + 1);
+					if (in.position () < in.end () && *in.position () != '/')
+						corner.t = resolveOBJIndex (in.read<long long> (), fileTexCoords.size ());
+					if (in.position () < in.end () && *in.position () == '/')
+					{
+						in.setPosition (in.position () + 1);
+						corner.n = resolveOBJIndex (in.read<long long> (), fileNormals.size ());
+					}
+				}
+				corners.push_back (corner);
+				size++;
+			}
+			polygonSizes.push_back (size);
+		}
+		// o, g, s, usemtl, mtllib, l, p... carry nothing we display
+		if (!in.atEndOfLine ())
+			in.skipLine ();
+	}
+
+	// Pass 2: weld the distinct (v, vt, vn) corners into a single indexed stream
+	bool hasTexCoords = !corners.empty ();
+	bool hasNormals = !corners.empty ();
+	for (const OBJCorner & corner : corners)
+	{
+		hasTexCoords = hasTexCoords && corner.t != 0;
+		hasNormals = hasNormals && corner.n != 0;
+	}
+
+	auto & P = meshPtr->vertexPositions ();
+	auto & N = meshPtr->vertexNormals ();
+	auto & UV = meshPtr->vertexTexCoords ();
+	auto & T = meshPtr->triangleIndices ();
+	CornerWeldMap weldMap (filePositions.size ());
+	std::vector<uint32_t> welded (corners.size ());
+	P.reserve (filePositions.size ());
+	for (size_t i = 0; i < corners.size (); i++)
+	{
+		OBJCorner corner = corners[i];
+		if (!hasTexCoords)
+			corner.t = 0; // Partial attributes are dropped rather than splitting vertices for nothing
+		if (!hasNormals)
+			corner.n = 0;
+		bool inserted;
+		welded[i] = weldMap.findOrInsert (corner, static_cast<uint32_t> (P.size ()), inserted);
+		if (inserted)
+		{
+			P.push_back (filePositions[corner.v - 1]);
+			if (hasTexCoords)
+				UV.push_back (fileTexCoords[corner.t - 1]);
+			if (hasNormals)
+				N.push_back (glm::normalize (fileNormals[corner.n - 1]));
+		}
+	}
+
+	T.reserve (corners.size () / 3);
+	size_t first = 0;
+	for (uint32_t size : polygonSizes)
+	{
+		for (uint32_t j = 2; j < size; j++) // Fan triangulation
+			T.push_back (glm::uvec3 (welded[first], welded[first + j - 1], welded[first + j]));
+		first += size;
+	}
+
+	reportProgress (1.f);
+
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	double megabytes = file.size () / (1024.0 * 1024.0);
+
+	meshPtr->vertexNormals ().resize (P.size (), glm::vec3 (0.f, 0.f, 1.f));
+	meshPtr->vertexTexCoords ().resize (P.size (), glm::vec2 (0.f, 0.f));
+	meshPtr->setHasTexCoords (hasTexCoords);
+	meshPtr->recomputePerVertexNormals (true, hasNormals);
+	std::cout << " > Mesh <" << filename << "> loaded: " << megabytes << " MB parsed in " << seconds * 1000.0
+			  << " ms (" << megabytes / seconds << " MB/s), " << corners.size () << " face corners welded into "
+			  << P.size () << " vertices (dedup ratio " << (P.empty () ? 0.0 : double (corners.size ()) / P.size ()) << "x"
+			  << (hasTexCoords ? ", file texture coordinates" : "") << (hasNormals ? ", file normals" : "") << ")" << std::endl;
+}
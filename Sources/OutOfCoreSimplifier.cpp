@@ -0,0 +1,414 @@
+#include "OutOfCoreSimplifier.h"
+#include "MeshLoader.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
+#include "BMesh.h"
+
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <stdexcept>
+#include <ios>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <system_error>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+using namespace std;
+
+namespace {
+
+/// Sequential access to the vertices then the faces of a mesh file, through a buffer of bounded size
+class MeshStream {
+public:
+	virtual ~MeshStream () {}
+	inline size_t numVertices () const { return m_numVertices; }
+	inline size_t numTriangles () const { return m_numTriangles; }
+	/// Goes back to the first vertex
+	virtual void rewind () = 0;
+	virtual glm::vec3 nextVertex () = 0;
+	/// Only valid once all the vertices have been read
+	virtual glm::uvec3 nextFace () = 0;
+
+protected:
+	size_t m_numVertices = 0;
+	size_t m_numTriangles = 0;
+};
+
+/// Streams an ASCII OFF file, one record per line, never holding more than chunkBytes of it
+class OFFStream : public MeshStream {
+public:
+	OFFStream (const std::string & filename, size_t chunkBytes) : m_filename (filename), m_in (filename.c_str (), std::ios::binary), m_buffer (chunkBytes)
+	{
+		if (!m_in)
+			throw std::ios_base::failure ("[Out Of Core Simplifier][OFFStream] Cannot open " + filename);
+		fill ();
+		TextScanner in (m_buffer.data (), m_buffer.data () + m_size);
+		if (in.readString () != "OFF")
+			throw std::ios_base::failure ("[Out Of Core Simplifier][OFFStream] Missing OFF header in " + filename);
+		m_numVertices = in.readUInt ();
+		m_numTriangles = in.readUInt ();
+		in.readUInt ();
+		in.skipLine ();
+		m_bodyOffset = in.position () - m_buffer.data ();
+		m_cur = m_bodyOffset;
+	}
+
+	void rewind ()
+	{
+		m_in.clear ();
+		m_in.seekg (m_bodyOffset);
+		m_size = 0;
+		m_cur = 0;
+		m_eof = false;
+		fill ();
+	}
+
+	glm::vec3 nextVertex ()
+	{
+		TextScanner in = nextRecord ();
+		glm::vec3 p;
+		p[0] = in.readFloat ();
+		p[1] = in.readFloat ();
+		p[2] = in.readFloat ();
+		return p;
+	}
+
+	glm::uvec3 nextFace ()
+	{
+		TextScanner in = nextRecord ();
+		in.readUInt (); // Only the first triangle of larger polygons is kept, as in MeshLoader::loadOFF
+		glm::uvec3 t;
+		t[0] = in.readUInt ();
+		t[1] = in.readUInt ();
+		t[2] = in.readUInt ();
+		return t;
+	}
+
+private:
+	/// Moves the unread bytes to the front of the buffer and completes it from the file
+	void fill ()
+	{
+		std::memmove (m_buffer.data (), m_buffer.data () + m_cur, m_size - m_cur);
+		m_size -= m_cur;
+		m_cur = 0;
+		m_in.read (m_buffer.data () + m_size, m_buffer.size () - m_size);
+		m_size += static_cast<size_t> (m_in.gcount ());
+		m_eof = m_size < m_buffer.size ();
+	}
+
+	/// Returns a scanner over the next non-empty line and moves past it
+	TextScanner nextRecord ()
+	{
+		while (true)
+		{
+			const char * begin = m_buffer.data () + m_cur;
+			const char * eol = static_cast<const char *> (std::memchr (begin, '\n', m_size - m_cur));
+			if (!eol && !m_eof)
+			{
+				if (m_cur == 0)
+					throw std::ios_base::failure ("[Out Of Core Simplifier][OFFStream] Line longer than the chunk size in " + m_filename);
+				fill ();
+				continue;
+			}
+			const char * end = eol ? eol : m_buffer.data () + m_size;
+			if (begin == end && !eol)
+				throw std::ios_base::failure ("[Out Of Core Simplifier][OFFStream] Unexpected end of " + m_filename);
+			m_cur = (eol ? eol + 1 : end) - m_buffer.data ();
+			TextScanner in (begin, end);
+			if (!in.atEnd ())
+				return in;
+		}
+	}
+
+	std::string m_filename;
+	std::ifstream m_in;
+	std::vector<char> m_buffer;
+	size_t m_size = 0;
+	size_t m_cur = 0;
+	size_t m_bodyOffset = 0;
+	bool m_eof = false;
+};
+
+/// Streams the positions and indices of a binary mesh cache by blocks of at most chunkBytes
+class BMeshStream : public MeshStream {
+public:
+	BMeshStream (const std::string & filename, size_t chunkBytes) : m_filename (filename), m_in (filename.c_str (), std::ios::binary)
+	{
+		if (!m_in)
+			throw std::ios_base::failure ("[Out Of Core Simplifier][BMeshStream] Cannot open " + filename);
+		m_in.read (reinterpret_cast<char *> (&m_header), sizeof (BMeshHeader));
+		if (!m_in || std::memcmp (m_header.magic, "BMSH", 4) != 0 || m_header.version != BMESH_VERSION || m_header.byteOrder != BMESH_BYTE_ORDER)
+			throw std::ios_base::failure ("[Out Of Core Simplifier][BMeshStream] Unsupported cache " + filename);
+		m_numVertices = m_header.numVertices;
+		m_numTriangles = m_header.numTriangles;
+		m_vertices.resize (std::max<size_t> (chunkBytes / sizeof (glm::vec3), 1));
+		m_faces.resize (std::max<size_t> (chunkBytes / sizeof (glm::uvec3), 1));
+		rewind ();
+	}
+
+	void rewind ()
+	{
+		m_vertexRead = 0;
+		m_faceRead = 0;
+		m_vertexCur = m_vertexEnd = 0;
+		m_faceCur = m_faceEnd = 0;
+	}
+
+	glm::vec3 nextVertex ()
+	{
+		if (m_vertexCur == m_vertexEnd)
+			m_vertexEnd = readBlock (m_header.offsets[BMESH_POSITIONS], m_vertexRead, m_numVertices, m_vertices, m_vertexCur);
+		return m_vertices[m_vertexCur++];
+	}
+
+	glm::uvec3 nextFace ()
+	{
+		if (m_faceCur == m_faceEnd)
+			m_faceEnd = readBlock (m_header.offsets[BMESH_INDICES], m_faceRead, m_numTriangles, m_faces, m_faceCur);
+		return m_faces[m_faceCur++];
+	}
+
+private:
+	template<typename T>
+	size_t readBlock (uint64_t offset, size_t & read, size_t total, std::vector<T> & block, size_t & cur)
+	{
+		size_t count = std::min (block.size (), total - read);
+		if (count == 0)
+			throw std::ios_base::failure ("[Out Of Core Simplifier][BMeshStream] Unexpected end of " + m_filename);
+		m_in.clear ();
+		m_in.seekg (offset + read * sizeof (T));
+		m_in.read (reinterpret_cast<char *> (block.data ()), count * sizeof (T));
+		if (!m_in)
+			throw std::ios_base::failure ("[Out Of Core Simplifier][BMeshStream] Truncated cache " + m_filename);
+		read += count;
+		cur = 0;
+		return count;
+	}
+
+	std::string m_filename;
+	std::ifstream m_in;
+	BMeshHeader m_header;
+	std::vector<glm::vec3> m_vertices;
+	std::vector<glm::uvec3> m_faces;
+	size_t m_vertexRead, m_vertexCur, m_vertexEnd;
+	size_t m_faceRead, m_faceCur, m_faceEnd;
+};
+
+/// Per-vertex record spilled to disk during the vertex pass and looked up, through a memory
+/// mapping that the OS is free to page out, during the face pass
+struct VertexRecord {
+	glm::vec3 position;
+	uint32_t cluster;
+};
+
+/// Accumulated error quadric Q = (A, b, c) of the planes around a cluster, with A symmetric,
+/// plus the mean of its vertices used when A is singular
+struct Cluster {
+	double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+	double b0 = 0, b1 = 0, b2 = 0;
+	double c = 0;
+	glm::dvec3 positionSum = glm::dvec3 (0.0);
+	uint32_t count = 0;
+	uint32_t outputIndex = 0;
+	glm::ivec3 cell;
+};
+
+/// Removes the file when going out of scope, including when an exception is thrown
+struct TemporaryFile {
+	std::string filename;
+	~TemporaryFile () { std::error_code ec; std::filesystem::remove (filename, ec); }
+};
+
+struct ClusterTriangle {
+	uint32_t v[3];
+	bool operator== (const ClusterTriangle & o) const { return v[0] == o.v[0] && v[1] == o.v[1] && v[2] == o.v[2]; }
+};
+
+struct ClusterTriangleHash {
+	size_t operator() (const ClusterTriangle & t) const {
+		uint64_t h = (uint64_t (t.v[0]) * 0x9E3779B97F4A7C15ull) ^ (uint64_t (t.v[1]) * 0xC2B2AE3D27D4EB4Full) ^ (uint64_t (t.v[2]) * 0x165667B19E3779F9ull);
+		return static_cast<size_t> (h ^ (h >> 31));
+	}
+};
+
+}
+
+// Rough per-entry cost of the hash containers, including node and bucket overhead
+static const size_t CLUSTER_BYTES = sizeof (Cluster) + sizeof (std::pair<uint64_t, uint32_t>) + 48;
+static const size_t TRIANGLE_BYTES = sizeof (ClusterTriangle) + 40;
+
+static glm::vec3 clusterRepresentative (const Cluster & cluster, const glm::vec3 & cellMin, float cellSize)
+{
+	glm::dvec3 mean = cluster.positionSum / double (cluster.count);
+	glm::dmat3 A (cluster.a00, cluster.a01, cluster.a02,
+				  cluster.a01, cluster.a11, cluster.a12,
+				  cluster.a02, cluster.a12, cluster.a22);
+	double trace = cluster.a00 + cluster.a11 + cluster.a22;
+	double det = glm::determinant (A);
+	if (trace <= 0.0 || std::abs (det) < 1e-6 * trace * trace * trace)
+		return glm::vec3 (mean); // Flat or creased region: the quadric has no unique minimum
+
+	glm::dvec3 x = glm::inverse (A) * -glm::dvec3 (cluster.b0, cluster.b1, cluster.b2);
+	glm::dvec3 lo = glm::dvec3 (cellMin) + glm::dvec3 (cluster.cell) * double (cellSize) - double (cellSize);
+	glm::dvec3 hi = lo + 3.0 * double (cellSize);
+	if (glm::any (glm::lessThan (x, lo)) || glm::any (glm::greaterThan (x, hi)))
+		return glm::vec3 (mean); // Badly conditioned minimum, far away from the cluster
+	return glm::vec3 (x);
+}
+
+void OutOfCoreSimplifier::simplify (const std::string & inputFilename, const std::string & outputFilename,
+									unsigned int resolution, size_t memoryBudget)
+{
+	auto start = std::chrono::high_resolution_clock::now ();
+	std::cout << " > Out-of-core simplification of <" << inputFilename << "> with a resolution of " << resolution
+			  << " and a memory budget of " << memoryBudget / (1024 * 1024) << " MB" << std::endl;
+	if (resolution < 1)
+		throw std::runtime_error ("[Out Of Core Simplifier][simplify] The resolution must be positive");
+
+	// A sixteenth of the budget goes to the I/O buffers, the rest to the clusters and output triangles
+	size_t chunkBytes = std::min<size_t> (std::max<size_t> (memoryBudget / 16, 64 * 1024), 64 * 1024 * 1024);
+	size_t clusterBudget = memoryBudget - std::min (memoryBudget, 2 * chunkBytes);
+
+	std::unique_ptr<MeshStream> stream;
+	std::string extension = std::filesystem::path (inputFilename).extension ().string ();
+	if (extension == ".bmesh")
+		stream.reset (new BMeshStream (inputFilename, chunkBytes));
+	else
+		stream.reset (new OFFStream (inputFilename, chunkBytes));
+	size_t numVertices = stream->numVertices ();
+	size_t numTriangles = stream->numTriangles ();
+	if (numVertices == 0)
+		throw std::runtime_error ("[Out Of Core Simplifier][simplify] Empty mesh " + inputFilename);
+
+	// Pass 1: bounding box
+	glm::vec3 bbMin (std::numeric_limits<float>::max ());
+	glm::vec3 bbMax (-std::numeric_limits<float>::max ());
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		glm::vec3 p = stream->nextVertex ();
+		bbMin = glm::min (bbMin, p);
+		bbMax = glm::max (bbMax, p);
+	}
+	glm::vec3 extent = bbMax - bbMin;
+	float cellSize = std::max (std::max (extent.x, extent.y), std::max (extent.z, 1e-20f)) / resolution;
+	glm::ivec3 gridSize = glm::max (glm::ivec3 (glm::ceil (extent / cellSize)), glm::ivec3 (1));
+
+	// Pass 2: cluster of every vertex, spilled to a temporary file with the position
+	std::unordered_map<uint64_t, uint32_t> clusterIds;
+	std::vector<Cluster> clusters;
+	std::string recordFilename = outputFilename + ".ooc.tmp";
+	TemporaryFile recordFileGuard = { recordFilename };
+	{
+		std::ofstream records (recordFilename.c_str (), std::ios::binary | std::ios::trunc);
+		if (!records)
+			throw std::ios_base::failure ("[Out Of Core Simplifier][simplify] Cannot open " + recordFilename);
+		std::vector<VertexRecord> block;
+		block.reserve (std::max<size_t> (chunkBytes / sizeof (VertexRecord), 1));
+		stream->rewind ();
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			VertexRecord record;
+			record.position = stream->nextVertex ();
+			glm::ivec3 cell = glm::clamp (glm::ivec3 ((record.position - bbMin) / cellSize), glm::ivec3 (0), gridSize - 1);
+			uint64_t key = (uint64_t (cell.x) * gridSize.y + cell.y) * gridSize.z + cell.z;
+			auto inserted = clusterIds.emplace (key, static_cast<uint32_t> (clusters.size ()));
+			if (inserted.second)
+			{
+				if ((clusters.size () + 1) * CLUSTER_BYTES > clusterBudget)
+					throw std::runtime_error ("[Out Of Core Simplifier][simplify] The clusters exceed the memory budget, lower the resolution");
+				clusters.emplace_back ();
+				clusters.back ().cell = cell;
+			}
+			record.cluster = inserted.first->second;
+			Cluster & cluster = clusters[record.cluster];
+			cluster.positionSum += glm::dvec3 (record.position);
+			cluster.count++;
+			block.push_back (record);
+			if (block.size () == block.capacity ())
+			{
+				records.write (reinterpret_cast<const char *> (block.data ()), block.size () * sizeof (VertexRecord));
+				block.clear ();
+			}
+		}
+		records.write (reinterpret_cast<const char *> (block.data ()), block.size () * sizeof (VertexRecord));
+		if (!records)
+			throw std::ios_base::failure ("[Out Of Core Simplifier][simplify] Cannot write " + recordFilename);
+	}
+	clusterIds = std::unordered_map<uint64_t, uint32_t> (); // Release the key table, the ids are in the records now
+
+	// Pass 3: faces. Every triangle adds its plane quadric to the clusters of its corners and
+	// survives only if these clusters are pairwise distinct.
+	std::unordered_set<ClusterTriangle, ClusterTriangleHash> triangles;
+	size_t clusterBytes = clusters.size () * sizeof (Cluster);
+	{
+		MappedFile recordFile (recordFilename);
+		const VertexRecord * vertexRecords = reinterpret_cast<const VertexRecord *> (recordFile.data ());
+		for (size_t i = 0; i < numTriangles; i++)
+		{
+			glm::uvec3 t = stream->nextFace ();
+			if (t[0] >= numVertices || t[1] >= numVertices || t[2] >= numVertices)
+				throw std::ios_base::failure ("[Out Of Core Simplifier][simplify] Vertex index out of range in " + inputFilename);
+			const VertexRecord & r0 = vertexRecords[t[0]];
+			const VertexRecord & r1 = vertexRecords[t[1]];
+			const VertexRecord & r2 = vertexRecords[t[2]];
+
+			glm::dvec3 normal = glm::cross (glm::dvec3 (r1.position - r0.position), glm::dvec3 (r2.position - r0.position));
+			double area2 = glm::length (normal);
+			if (area2 > 0.0)
+			{
+				glm::dvec3 n = normal / area2;
+				double d = -glm::dot (n, glm::dvec3 (r0.position));
+				double w = 0.5 * area2;
+				for (const VertexRecord * r : { &r0, &r1, &r2 })
+				{
+					Cluster & q = clusters[r->cluster];
+					q.a00 += w * n.x * n.x; q.a01 += w * n.x * n.y; q.a02 += w * n.x * n.z;
+					q.a11 += w * n.y * n.y; q.a12 += w * n.y * n.z; q.a22 += w * n.z * n.z;
+					q.b0 += w * d * n.x; q.b1 += w * d * n.y; q.b2 += w * d * n.z;
+					q.c += w * d * d;
+				}
+			}
+
+			if (r0.cluster == r1.cluster || r1.cluster == r2.cluster || r0.cluster == r2.cluster)
+				continue;
+			// Rotate so that the smallest id comes first, keeping the orientation
+			ClusterTriangle ct = { { r0.cluster, r1.cluster, r2.cluster } };
+			std::rotate (ct.v, std::min_element (ct.v, ct.v + 3), ct.v + 3);
+			if (triangles.insert (ct).second && clusterBytes + triangles.size () * TRIANGLE_BYTES > clusterBudget)
+				throw std::runtime_error ("[Out Of Core Simplifier][simplify] The output triangles exceed the memory budget, lower the resolution");
+		}
+	}
+	// Output: one vertex per referenced cluster, placed at the minimizer of its quadric
+	uint32_t numOutputVertices = 0;
+	for (const ClusterTriangle & t : triangles)
+		for (uint32_t id : t.v)
+			if (clusters[id].count != 0 && clusters[id].outputIndex == 0)
+				clusters[id].outputIndex = ++numOutputVertices; // 1-based while numbering, 0 means unreferenced
+
+	std::vector<glm::vec3> outputPositions (numOutputVertices);
+	for (const Cluster & cluster : clusters)
+		if (cluster.outputIndex)
+			outputPositions[cluster.outputIndex - 1] = clusterRepresentative (cluster, bbMin, cellSize);
+	std::vector<glm::uvec3> outputTriangles;
+	outputTriangles.reserve (triangles.size ());
+	for (const ClusterTriangle & t : triangles)
+		outputTriangles.push_back (glm::uvec3 (clusters[t.v[0]].outputIndex - 1, clusters[t.v[1]].outputIndex - 1, clusters[t.v[2]].outputIndex - 1));
+	MeshLoader::saveOFF (outputFilename, outputPositions, outputTriangles); // Shortest round-trip coordinates, no precision lost
+
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	std::cout << " > Simplified <" << inputFilename << "> from " << numVertices << " vertices / " << numTriangles << " triangles to "
+			  << numOutputVertices << " vertices / " << triangles.size () << " triangles in " << seconds << " s, written to <"
+			  << outputFilename << ">" << std::endl;
+}
@@ -0,0 +1,20 @@
+#ifndef OUT_OF_CORE_SIMPLIFIER_H
+#define OUT_OF_CORE_SIMPLIFIER_H
+
+#include <string>
+#include <cstddef>
+
+namespace OutOfCoreSimplifier {
+
+/// Simplifies a mesh that does not need to fit in memory, using uniform-grid vertex clustering
+/// with per-cluster error quadrics (Lindstrom, "Out-of-Core Simplification of Large Polygonal
+/// Models", SIGGRAPH 2000). The input (.off or .bmesh) is streamed in bounded chunks and the
+/// simplified mesh is written to outputFilename as OFF. resolution is the number of cells along
+/// the longest side of the bounding box. Throws std::runtime_error if the clusters of the output
+/// do not fit within memoryBudget bytes.
+void simplify (const std::string & inputFilename, const std::string & outputFilename,
+			   unsigned int resolution, size_t memoryBudget);
+
+}
+
+#endif // OUT_OF_CORE_SIMPLIFIER_H
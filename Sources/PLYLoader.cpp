@@ -0,0 +1,401 @@
+#include "MeshLoader.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
+
+#include <iostream>
+#include <exception>
+#include <ios>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+/// ASCII records parsed between two progress reports
+const size_t PROGRESS_RECORDS = 65536;
+
+enum PLYFormat { PLY_ASCII, PLY_BINARY_LITTLE_ENDIAN, PLY_BINARY_BIG_ENDIAN };
+
+enum PLYType { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID };
+
+struct PLYProperty {
+	std::string name;
+	PLYType type = PLY_INVALID;
+	bool isList = false;
+	PLYType countType = PLY_INVALID;
+	size_t offset = 0; // In bytes from the start of the record, only meaningful for fixed-size records
+};
+
+struct PLYElement {
+	std::string name;
+	size_t count = 0;
+	std::vector<PLYProperty> properties;
+	bool fixedSize = true;
+	size_t stride = 0; // Record size in bytes when fixedSize
+};
+
+PLYType parsePLYType (const std::string & name)
+{
+	if (name == "char" || name == "int8") return PLY_INT8;
+	if (name == "uchar" || name == "uint8") return PLY_UINT8;
+	if (name == "short" || name == "int16") return PLY_INT16;
+	if (name == "ushort" || name == "uint16") return PLY_UINT16;
+	if (name == "int" || name == "int32") return PLY_INT32;
+	if (name == "uint" || name == "uint32") return PLY_UINT32;
+	if (name == "float" || name == "float32") return PLY_FLOAT32;
+	if (name == "double" || name == "float64") return PLY_FLOAT64;
+	return PLY_INVALID;
+}
+
+inline size_t plyTypeSize (PLYType type)
+{
+	static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+	return sizes[type];
+}
+
+inline bool isNativeLittleEndian ()
+{
+	const uint16_t one = 1;
+	return *reinterpret_cast<const unsigned char *> (&one) == 1;
+}
+
+/// Reads one binary scalar of the given type, swapping its bytes when the file endianness differs from ours
+template<typename T>
+inline T readBinary (const char * p, PLYType type, bool swap)
+{
+	unsigned char bytes[8];
+	size_t size = plyTypeSize (type);
+	std::memcpy (bytes, p, size);
+	if (swap)
+		std::reverse (bytes, bytes + size);
+	switch (type)
+	{
+	case PLY_INT8: { int8_t v; std::memcpy (&v, bytes, 1); return static_cast<T> (v); }
+	case PLY_UINT8: return static_cast<T> (bytes[0]);
+	case PLY_INT16: { int16_t v; std::memcpy (&v, bytes, 2); return static_cast<T> (v); }
+	case PLY_UINT16: { uint16_t v; std::memcpy (&v, bytes, 2); return static_cast<T> (v); }
+	case PLY_INT32: { int32_t v; std::memcpy (&v, bytes, 4); return static_cast<T> (v); }
+	case PLY_UINT32: { uint32_t v; std::memcpy (&v, bytes, 4); return static_cast<T> (v); }
+	case PLY_FLOAT32: { float v; std::memcpy (&v, bytes, 4); return static_cast<T> (v); }
+	case PLY_FLOAT64: { double v; std::memcpy (&v, bytes, 8); return static_cast<T> (v); }
+	default: return T (0);
+	}
+}
+
+template<typename T>
+inline T readASCII (TextScanner & in, PLYType type)
+{
+	if (type == PLY_FLOAT32 || type == PLY_FLOAT64)
+		return static_cast<T> (in.read<double> ());
+	return static_cast<T> (in.read<long long> ());
+}
+
+/// Throws unless count values of size bytes each lie between p and end, without computing any
+/// pointer past end: the counts come from the file and cannot be trusted
+inline void requireBytes (const char * p, const char * end, size_t count, size_t size, const std::string & filename)
+{
+	if (size != 0 && count > static_cast<size_t> (end - p) / size)
+		throw std::ios_base::failure ("[Mesh Loader][loadPLY] Unexpected end of file " + filename);
+}
+
+/// Smallest size of a record of the element, its lists being empty
+inline size_t minimumRecordSize (const PLYElement & element)
+{
+	size_t size = 0;
+	for (const PLYProperty & property : element.properties)
+		size += plyTypeSize (property.isList ? property.countType : property.type);
+	return size;
+}
+
+/// Returns a pointer right after the binary property of a record starting at p
+inline const char * skipBinaryProperty (const char * p, const char * end, const PLYProperty & property, bool swap, const std::string & filename)
+{
+	if (!property.isList)
+	{
+		requireBytes (p, end, 1, plyTypeSize (property.type), filename);
+		return p + plyTypeSize (property.type);
+	}
+	requireBytes (p, end, 1, plyTypeSize (property.countType), filename);
+	size_t count = readBinary<size_t> (p, property.countType, swap);
+	p += plyTypeSize (property.countType);
+	requireBytes (p, end, count, plyTypeSize (property.type), filename);
+	return p + count * plyTypeSize (property.type);
+}
+
+/// Returns a pointer right after a binary record of an element holding list properties
+inline const char * skipBinaryRecord (const char * p, const char * end, const PLYElement & element, bool swap, const std::string & filename)
+{
+	for (const PLYProperty & property : element.properties)
+		p = skipBinaryProperty (p, end, property, swap, filename);
+	return p;
+}
+
+/// Adds a polygon to T, fan-triangulated
+inline void addPolygon (std::vector<glm::uvec3> & T, const unsigned int * indices, size_t count)
+{
+	for (size_t i = 2; i < count; i++)
+		T.push_back (glm::uvec3 (indices[0], indices[i-1], indices[i]));
+}
+
+int findProperty (const PLYElement & element, const std::string & name)
+{
+	for (size_t i = 0; i < element.properties.size (); i++)
+		if (element.properties[i].name == name)
+			return static_cast<int> (i);
+	return -1;
+}
+
+}
+
+void MeshLoader::loadPLY (const std::string & filename, std::shared_ptr<Mesh> meshPtr)
+{
+	std::cout << " > Start loading mesh <" << filename << ">" << std::endl;
+	meshPtr->clear ();
+	auto start = std::chrono::high_resolution_clock::now ();
+
+	MappedFile file (filename);
+	TextScanner in (file.begin (), file.end ());
+
+	// Header
+	if (in.readString () != "ply")
+		throw std::ios_base::failure ("[Mesh Loader][loadPLY] Missing ply header in " + filename);
+	PLYFormat format = PLY_ASCII;
+	std::vector<PLYElement> elements;
+	while (true)
+	{
+		if (in.atEnd ())
+			throw std::ios_base::failure ("[Mesh Loader][loadPLY] Missing end_header in " + filename);
+		std::string keyword = in.readString ();
+		if (keyword == "end_header")
+		{
+			in.skipLine ();
+			break;
+		}
+		else if (keyword == "format")
+		{
+			std::string formatName = in.readString ();
+			if (formatName == "ascii")
+				format = PLY_ASCII;
+			else if (formatName == "binary_little_endian")
+				format = PLY_BINARY_LITTLE_ENDIAN;
+			else if (formatName == "binary_big_endian")
+				format = PLY_BINARY_BIG_ENDIAN;
+			else
+				throw std::ios_base::failure ("[Mesh Loader][loadPLY] Unknown format " + formatName + " in " + filename);
+		}
+		else if (keyword == "element")
+		{
+			PLYElement element;
+			element.name = in.readString ();
+			element.count = in.read<size_t> ();
+			elements.push_back (element);
+		}
+		else if (keyword == "property")
+		{
+			if (elements.empty ())
+				throw std::ios_base::failure ("[Mesh Loader][loadPLY] Property outside of an element in " + filename);
+			PLYElement & element = elements.back ();
+			PLYProperty property;
+			std::string typeName = in.readString ();
+			if (typeName == "list")
+			{
+				property.isList = true;
+				property.countType = parsePLYType (in.readString ());
+				property.type = parsePLYType (in.readString ());
+				element.fixedSize = false;
+			}
+			else
+				property.type = parsePLYType (typeName);
+			property.name = in.readString ();
+			if (property.type == PLY_INVALID || (property.isList && property.countType == PLY_INVALID))
+				throw std::ios_base::failure ("[Mesh Loader][loadPLY] Unknown type for property " + property.name + " in " + filename);
+			property.offset = element.stride;
+			element.stride += plyTypeSize (property.type);
+			element.properties.push_back (property);
+		}
+		// comment, obj_info and unknown keywords are ignored
+		if (!in.atEndOfLine ())
+			in.skipLine ();
+	}
+
+	auto & P = meshPtr->vertexPositions ();
+	auto & T = meshPtr->triangleIndices ();
+	bool swap = (format == PLY_BINARY_LITTLE_ENDIAN) != isNativeLittleEndian ();
+	const char * p = in.position ();
+	std::vector<unsigned int> polygon;
+
+	for (const PLYElement & element : elements)
+	{
+		reportProgress (float ((format == PLY_ASCII ? in.position () : p) - file.begin ()) / file.size ());
+		bool isVertex = (element.name == "vertex");
+		bool isFace = (element.name == "face");
+		int x = findProperty (element, "x"), y = findProperty (element, "y"), z = findProperty (element, "z");
+		int indices = findProperty (element, "vertex_indices");
+		if (indices < 0)
+			indices = findProperty (element, "vertex_index");
+		if (isVertex && (x < 0 || y < 0 || z < 0))
+			throw std::ios_base::failure ("[Mesh Loader][loadPLY] Missing vertex coordinates in " + filename);
+		if (isFace && (indices < 0 || !element.properties[indices].isList))
+			throw std::ios_base::failure ("[Mesh Loader][loadPLY] Missing face indices in " + filename);
+
+		if (format == PLY_ASCII)
+		{
+			// One record per line; unknown properties and elements are skipped along with the rest of the line
+			if (isVertex)
+				P.resize (element.count);
+			else if (isFace)
+				T.reserve (element.count);
+			for (size_t i = 0; i < element.count; i++)
+			{
+				if (i % PROGRESS_RECORDS == 0)
+					reportProgress (float (in.position () - file.begin ()) / file.size ());
+				if (isVertex)
+				{
+					glm::vec3 & v = P[i];
+					for (size_t k = 0; k < element.properties.size (); k++)
+					{
+						const PLYProperty & property = element.properties[k];
+						if (property.isList)
+						{
+							size_t count = readASCII<size_t> (in, property.countType);
+							for (size_t j = 0; j < count; j++)
+								readASCII<double> (in, property.type);
+						}
+						else if ((int) k == x) v[0] = readASCII<float> (in, property.type);
+						else if ((int) k == y) v[1] = readASCII<float> (in, property.type);
+						else if ((int) k == z) v[2] = readASCII<float> (in, property.type);
+						else if ((int) k > std::max (x, std::max (y, z)))
+							break; // Nothing of interest left on this line
+						else
+							readASCII<double> (in, property.type);
+					}
+				}
+				else if (isFace)
+				{
+					for (int k = 0; k < indices; k++)
+					{
+						const PLYProperty & property = element.properties[k];
+						size_t count = property.isList ? readASCII<size_t> (in, property.countType) : 1;
+						for (size_t j = 0; j < count; j++)
+							readASCII<double> (in, property.type);
+					}
+					const PLYProperty & property = element.properties[indices];
+					polygon.resize (readASCII<size_t> (in, property.countType));
+					for (unsigned int & index : polygon)
+						index = readASCII<unsigned int> (in, property.type);
+					addPolygon (T, polygon.data (), polygon.size ());
+				}
+				else
+					in.skipSpaces ();
+				in.skipLine ();
+			}
+			continue;
+		}
+
+		// Binary formats
+		const char * end = file.end ();
+		requireBytes (p, end, element.count, minimumRecordSize (element), filename); // Before any allocation sized by the header
+		if (isVertex)
+		{
+			P.resize (element.count);
+			const PLYProperty & px = element.properties[x];
+			const PLYProperty & py = element.properties[y];
+			const PLYProperty & pz = element.properties[z];
+			bool packedFloats = element.fixedSize && !swap && px.type == PLY_FLOAT32 && py.type == PLY_FLOAT32 && pz.type == PLY_FLOAT32
+								&& py.offset == px.offset + 4 && pz.offset == px.offset + 8;
+			if (packedFloats && element.stride == sizeof (glm::vec3))
+			{
+				// x y z only: the whole block is the vertex buffer
+				std::memcpy (P.data (), p, element.count * sizeof (glm::vec3));
+				p += element.count * sizeof (glm::vec3);
+			}
+			else if (packedFloats)
+			{
+				// Extra properties (normals, colors, confidence...): strided copy, they are never decoded
+				for (size_t i = 0; i < element.count; i++, p += element.stride)
+					std::memcpy (&P[i], p + px.offset, sizeof (glm::vec3));
+			}
+			else if (element.fixedSize)
+			{
+				for (size_t i = 0; i < element.count; i++, p += element.stride)
+					P[i] = glm::vec3 (readBinary<float> (p + px.offset, px.type, swap),
+									  readBinary<float> (p + py.offset, py.type, swap),
+									  readBinary<float> (p + pz.offset, pz.type, swap));
+			}
+			else
+			{
+				for (size_t i = 0; i < element.count; i++)
+				{
+					for (size_t k = 0; k < element.properties.size (); k++)
+					{
+						const PLYProperty & property = element.properties[k];
+						const char * next = skipBinaryProperty (p, end, property, swap, filename);
+						if ((int) k == x) P[i][0] = readBinary<float> (p, property.type, swap);
+						else if ((int) k == y) P[i][1] = readBinary<float> (p, property.type, swap);
+						else if ((int) k == z) P[i][2] = readBinary<float> (p, property.type, swap);
+						p = next;
+					}
+				}
+			}
+		}
+		else if (isFace)
+		{
+			T.reserve (element.count);
+			const PLYProperty & property = element.properties[indices];
+			bool triangleFastPath = element.properties.size () == 1 && !swap && property.countType == PLY_UINT8
+									&& (property.type == PLY_INT32 || property.type == PLY_UINT32);
+			for (size_t i = 0; i < element.count; i++)
+			{
+				if (triangleFastPath && end - p >= 13 && static_cast<unsigned char> (*p) == 3)
+				{
+					// The common "3 i j k" record with uchar count and 32-bit indices
+					glm::uvec3 t;
+					std::memcpy (&t, p + 1, sizeof (glm::uvec3));
+					T.push_back (t);
+					p += 13;
+					continue;
+				}
+				const char * record = p;
+				for (int k = 0; k < indices; k++)
+					record = skipBinaryProperty (record, end, element.properties[k], swap, filename);
+				requireBytes (record, end, 1, plyTypeSize (property.countType), filename);
+				size_t count = readBinary<size_t> (record, property.countType, swap);
+				record += plyTypeSize (property.countType);
+				requireBytes (record, end, count, plyTypeSize (property.type), filename);
+				polygon.resize (count);
+				for (unsigned int & index : polygon)
+				{
+					index = readBinary<unsigned int> (record, property.type, swap);
+					record += plyTypeSize (property.type);
+				}
+				addPolygon (T, polygon.data (), polygon.size ());
+				p = skipBinaryRecord (p, end, element, swap, filename);
+			}
+		}
+		else if (element.fixedSize)
+		{
+			p += element.count * element.stride; // Unknown elements are skipped as a whole
+		}
+		else
+			for (size_t i = 0; i < element.count; i++)
+				p = skipBinaryRecord (p, end, element, swap, filename);
+	}
+
+	for (const glm::uvec3 & t : T)
+		if (t[0] >= P.size () || t[1] >= P.size () || t[2] >= P.size ())
+			throw std::ios_base::failure ("[Mesh Loader][loadPLY] Vertex index out of range in " + filename);
+	reportProgress (1.f);
+
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	double megabytes = file.size () / (1024.0 * 1024.0);
+
+	meshPtr->vertexNormals ().resize (P.size (), glm::vec3 (0.f, 0.f, 1.f));
+	meshPtr->vertexTexCoords ().resize (P.size (), glm::vec2 (0.f, 0.f));
+	meshPtr->recomputePerVertexNormals (true);
+	std::cout << " > Mesh <" << filename << "> loaded: " << megabytes << " MB parsed in " << seconds * 1000.0
+			  << " ms (" << megabytes / seconds << " MB/s)" << std::endl;
+}
@@ -0,0 +1,221 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <ios>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t RING_CAPACITY = 1 << 16; // Zones kept per buffer, 2 MB
+
+struct Event {
+	const char * name;
+	uint64_t begin;
+	uint64_t end;
+	uint32_t thread; // Id of the thread which recorded it, the buffer being shared over time
+};
+
+/// Zones of a thread. Buffers outlive their threads, so that the zones of finished workers are
+/// still written, and are taken over by the next threads started: their number stays bounded by
+/// the number of threads running at once. The zones of a finished thread stay in the ring until
+/// overwritten, under its own id and name.
+struct ThreadBuffer {
+	std::mutex mutex; // Only contended while the trace is written or cleared
+	std::vector<Event> events; // Ring, allocated by the first zone
+	uint64_t count = 0;
+	uint32_t id = 0; // Of the thread using the buffer, guarded by the registry mutex
+	bool inUse = false; // Guarded by the registry mutex
+};
+
+std::atomic<bool> enabled (false);
+
+std::mutex registryMutex;
+
+uint32_t nextThreadId = 1; // Guarded by the registry mutex
+
+std::vector<std::shared_ptr<ThreadBuffer>> & registry ()
+{
+	static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	return buffers;
+}
+
+/// Given by setThreadName, guarded by the registry mutex
+std::map<uint32_t, std::string> & threadNames ()
+{
+	static std::map<uint32_t, std::string> names;
+	return names;
+}
+
+/// Gives the buffer back when its thread ends
+struct ThreadBufferHolder {
+	std::shared_ptr<ThreadBuffer> buffer;
+
+	~ThreadBufferHolder () {
+		if (buffer)
+		{
+			std::lock_guard<std::mutex> lock (registryMutex);
+			buffer->inUse = false;
+		}
+	}
+};
+
+ThreadBuffer & acquireThreadBuffer ()
+{
+	thread_local ThreadBufferHolder holder;
+	if (!holder.buffer)
+	{
+		std::lock_guard<std::mutex> lock (registryMutex);
+		auto & buffers = registry ();
+		auto it = std::find_if (buffers.begin (), buffers.end (), [] (const std::shared_ptr<ThreadBuffer> & buffer) { return !buffer->inUse; });
+		if (it != buffers.end ())
+			holder.buffer = *it;
+		else
+		{
+			holder.buffer = std::make_shared<ThreadBuffer> ();
+			buffers.push_back (holder.buffer);
+		}
+		holder.buffer->id = nextThreadId++; // The zones left by the previous thread keep its id
+		holder.buffer->inUse = true;
+	}
+	return *holder.buffer;
+}
+
+ThreadBuffer & threadBuffer ()
+{
+	thread_local ThreadBuffer * buffer = nullptr; // Trivial, unlike the holder: no initialization guard
+	if (!buffer)
+		buffer = &acquireThreadBuffer ();
+	return *buffer;
+}
+
+void writeJSONString (std::ostream & out, const std::string & text)
+{
+	out << '"';
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (static_cast<unsigned char> (c) < 0x20)
+			out << ' ';
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+}
+
+namespace Profiler {
+
+void setEnabled (bool isEnabled)
+{
+	enabled.store (isEnabled, std::memory_order_relaxed);
+}
+
+bool isEnabled ()
+{
+	return enabled.load (std::memory_order_relaxed);
+}
+
+uint64_t now ()
+{
+	return static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ());
+}
+
+void setThreadName (const std::string & name)
+{
+	ThreadBuffer & buffer = threadBuffer ();
+	std::lock_guard<std::mutex> lock (registryMutex);
+	threadNames ()[buffer.id] = name;
+}
+
+void record (const char * name, uint64_t beginNanoseconds, uint64_t endNanoseconds)
+{
+	ThreadBuffer & buffer = threadBuffer ();
+	std::lock_guard<std::mutex> lock (buffer.mutex);
+	if (buffer.events.empty ())
+		buffer.events.resize (RING_CAPACITY);
+	buffer.events[buffer.count % RING_CAPACITY] = { name, beginNanoseconds, endNanoseconds, buffer.id };
+	buffer.count++;
+}
+
+void writeChromeTrace (const std::string & filename)
+{
+	// Copied first, so that the threads are not held while the file is written
+	struct Thread {
+		std::string name;
+		std::vector<Event> events;
+	};
+	std::map<uint32_t, Thread> threads; // By id
+	{
+		std::lock_guard<std::mutex> lock (registryMutex);
+		for (const std::shared_ptr<ThreadBuffer> & buffer : registry ())
+		{
+			std::lock_guard<std::mutex> bufferLock (buffer->mutex);
+			if (buffer->inUse)
+				threads[buffer->id];
+			uint64_t first = buffer->count > RING_CAPACITY ? buffer->count - RING_CAPACITY : 0;
+			for (uint64_t i = first; i < buffer->count; i++)
+				threads[buffer->events[i % RING_CAPACITY].thread].events.push_back (buffer->events[i % RING_CAPACITY]);
+		}
+		for (auto & thread : threads)
+		{
+			auto name = threadNames ().find (thread.first);
+			thread.second.name = name != threadNames ().end () ? name->second : "Thread " + std::to_string (thread.first);
+		}
+	}
+	uint64_t origin = UINT64_MAX;
+	for (const auto & thread : threads)
+		for (const Event & event : thread.second.events)
+			origin = std::min (origin, event.begin);
+
+	std::ofstream out (filename.c_str (), std::ios::trunc);
+	if (!out)
+		throw std::ios_base::failure ("[Profiler][writeChromeTrace] Cannot open " + filename);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	out.setf (std::ios::fixed);
+	out.precision (3);
+	bool first = true;
+	for (const auto & thread : threads)
+	{
+		out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.first << ",\"args\":{\"name\":";
+		writeJSONString (out, thread.second.name);
+		out << "}}";
+		first = false;
+		for (const Event & event : thread.second.events) // Microseconds
+		{
+			out << ",\n{\"name\":";
+			writeJSONString (out, event.name);
+			out << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.first << ",\"ts\":" << (event.begin - origin) * 1e-3
+				<< ",\"dur\":" << (event.end - event.begin) * 1e-3 << "}";
+		}
+	}
+	out << "\n]}\n";
+	if (!out)
+		throw std::ios_base::failure ("[Profiler][writeChromeTrace] Cannot write " + filename);
+}
+
+void clear ()
+{
+	std::lock_guard<std::mutex> lock (registryMutex);
+	std::map<uint32_t, std::string> names; // Of the running threads, the others having no zone left
+	for (const std::shared_ptr<ThreadBuffer> & buffer : registry ())
+	{
+		std::lock_guard<std::mutex> bufferLock (buffer->mutex);
+		buffer->count = 0;
+		auto name = threadNames ().find (buffer->id);
+		if (buffer->inUse && name != threadNames ().end ())
+			names.insert (*name);
+	}
+	threadNames ().swap (names);
+}
+
+}
@@ -6,14 +6,28 @@
 
 #include <exception>
 #include <ios>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "Hash.h"
 
 using namespace std;
 
+GLuint ShaderProgram::s_activeProgram = 0;
+
+ShaderProgram::CallCounters ShaderProgram::s_callCounters;
+
 // Create a GPU program i.e., a graphics pipeline
 ShaderProgram::ShaderProgram () : m_id (glCreateProgram ()) {}
 
 
 ShaderProgram::~ShaderProgram () {
+	if (s_activeProgram == m_id) // Deleted once no longer active
+		stop ();
 	glDeleteProgram (m_id); 
 }
 
@@ -29,10 +43,28 @@ std::string ShaderProgram::file2String (const std::string & filename)
 	return buffer.str ();
 }
 
+std::string ShaderProgram::addDefines (const std::string & source, const std::string & defines)
+{
+	if (defines.empty ())
+		return source;
+	size_t versionBegin = source.find ("#version");
+	if (versionBegin == std::string::npos)
+		return defines + "#line 1\n" + source;
+	size_t versionEnd = source.find ('\n', versionBegin);
+	if (versionEnd == std::string::npos)
+		return source + "\n" + defines;
+	size_t line = 2 + std::count (source.begin (), source.begin () + versionBegin, '\n');
+	return source.substr (0, versionEnd + 1) + defines + "#line " + std::to_string (line) + "\n" + source.substr (versionEnd + 1);
+}
+
 void ShaderProgram::loadShader (GLenum type, const std::string & shaderFilename) 
+{
+	attachShader (type, file2String (shaderFilename)); // Loads the shader source from a file to a C++ string
+}
+
+void ShaderProgram::attachShader (GLenum type, const std::string & shaderSourceString)
 {
 	GLuint shader = glCreateShader (type); // Create the shader, e.g., a vertex shader to be applied to every single vertex of a mesh
-	std::string shaderSourceString = file2String (shaderFilename); // Loads the shader source from a file to a C++ string
 	const GLchar * shaderSource = (const GLchar *)shaderSourceString.c_str (); // Interface the C++ string through a C pointer
 	glShaderSource (shader, 1, &shaderSource, NULL); // Load the vertex shader source code
 	glCompileShader (shader);  // THe GPU driver compile the shader
@@ -40,6 +72,13 @@ void ShaderProgram::loadShader (GLenum type, const std::string & shaderFilename)
 	glDeleteShader (shader);
 }
 
+bool ShaderProgram::isLinked () const
+{
+	GLint status = GL_FALSE;
+	glGetProgramiv (m_id, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
 std::shared_ptr<ShaderProgram> ShaderProgram::genBasicShaderProgram (const std::string & vertexShaderFilename,
 															 	 	 const std::string & fragmentShaderFilename) 
 {
@@ -49,4 +88,204 @@ std::shared_ptr<ShaderProgram> ShaderProgram::genBasicShaderProgram (const std::
 	shaderProgramPtr->link ();
 	shaderProgramPtr->use ();
 	return shaderProgramPtr;
-}
\ No newline at end of file
+}
+
+void ShaderProgram::bind (GLuint id)
+{
+	if (s_activeProgram == id)
+	{
+		s_callCounters.elidedUseCalls++;
+		return;
+	}
+	glUseProgram (id);
+	s_activeProgram = id;
+	s_callCounters.useCalls++;
+}
+
+void ShaderProgram::listUniforms ()
+{
+	m_hasUniformList = true;
+	GLint numUniforms = 0, maxLength = 0;
+	glGetProgramiv (m_id, GL_ACTIVE_UNIFORMS, &numUniforms);
+	glGetProgramiv (m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<GLchar> name (std::max (maxLength, 1));
+	for (GLint i = 0; i < numUniforms; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type;
+		glGetActiveUniform (m_id, static_cast<GLuint> (i), static_cast<GLsizei> (name.size ()), &length, &size, &type, name.data ());
+		std::string uniformName (name.data (), length);
+		GLint location = glGetUniformLocation (m_id, uniformName.c_str ()); // -1 in uniform blocks
+		if (location < 0)
+			continue;
+		m_uniforms[uniformName].location = location;
+		if (uniformName.size () > 3 && uniformName.compare (uniformName.size () - 3, 3, "[0]") == 0) // Arrays are also set by their name
+			m_uniforms[uniformName.substr (0, uniformName.size () - 3)].location = location;
+	}
+}
+
+GLint ShaderProgram::getLocation (const std::string & name)
+{
+	if (!m_hasUniformList)
+		listUniforms ();
+	auto it = m_uniforms.find (name);
+	return it == m_uniforms.end () ? -1 : it->second.location;
+}
+
+void ShaderProgram::setUniform (const std::string & name, GLenum type, const void * value)
+{
+	if (!m_hasUniformList)
+		listUniforms ();
+	Uniform & uniform = m_uniforms[name]; // Not active: kept for copyUniformsFrom only
+	size_t size = (type == GL_FLOAT_MAT4 ? 16 : type == GL_FLOAT_VEC4 ? 4 : type == GL_FLOAT_VEC3 ? 3 : type == GL_FLOAT_VEC2 ? 2 : 1) * sizeof (GLfloat);
+	bool isUnchanged = (uniform.type == type && std::memcmp (uniform.value, value, size) == 0);
+	uniform.type = type;
+	std::memcpy (uniform.value, value, size);
+	if (isUnchanged || uniform.location < 0)
+	{
+		s_callCounters.elidedUniformCalls++;
+		return;
+	}
+	s_callCounters.uniformCalls++;
+	const GLfloat * floats = uniform.value;
+	switch (type)
+	{
+	case GL_INT: glProgramUniform1iv (m_id, uniform.location, 1, reinterpret_cast<const GLint *> (floats)); break;
+	case GL_FLOAT: glProgramUniform1fv (m_id, uniform.location, 1, floats); break;
+	case GL_FLOAT_VEC2: glProgramUniform2fv (m_id, uniform.location, 1, floats); break;
+	case GL_FLOAT_VEC3: glProgramUniform3fv (m_id, uniform.location, 1, floats); break;
+	case GL_FLOAT_VEC4: glProgramUniform4fv (m_id, uniform.location, 1, floats); break;
+	case GL_FLOAT_MAT4: glProgramUniformMatrix4fv (m_id, uniform.location, 1, GL_FALSE, floats); break;
+	}
+}
+
+void ShaderProgram::copyUniformsFrom (const ShaderProgram & other)
+{
+	for (const auto & [name, uniform] : other.m_uniforms)
+		if (uniform.type != GL_NONE)
+			setUniform (name, uniform.type, uniform.value);
+}
+
+namespace {
+
+const char PROGRAM_BINARY_MAGIC[8] = { 'G', 'L', 'P', 'R', 'O', 'G', 'B', '1' };
+
+/// Header of a program binary file, followed by the binary itself
+struct ProgramBinaryHeader {
+	char magic[8];
+	uint64_t key;
+	uint32_t binaryFormat;
+	uint32_t binarySize;
+};
+
+std::string glString (GLenum name)
+{
+	const GLubyte * value = glGetString (name);
+	return value ? reinterpret_cast<const char *> (value) : "";
+}
+
+}
+
+bool ShaderProgram::loadBinary (const std::string & filename, uint64_t key)
+{
+	std::ifstream input (filename.c_str (), std::ios::binary);
+	ProgramBinaryHeader header;
+	if (!input || !input.read (reinterpret_cast<char *> (&header), sizeof (header))
+		|| std::memcmp (header.magic, PROGRAM_BINARY_MAGIC, sizeof (header.magic)) != 0 || header.key != key)
+		return false;
+	std::vector<char> binary (header.binarySize);
+	if (!input.read (binary.data (), binary.size ()))
+		return false;
+	glProgramBinary (m_id, header.binaryFormat, binary.data (), static_cast<GLsizei> (binary.size ()));
+	resetUniforms ();
+	return isLinked ();
+}
+
+void ShaderProgram::saveBinary (const std::string & filename, uint64_t key)
+{
+	GLint binarySize = 0;
+	glGetProgramiv (m_id, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+	if (binarySize <= 0)
+		throw std::ios_base::failure ("[Shader Program][saveBinary] The driver provides no binary for " + filename);
+	ProgramBinaryHeader header;
+	std::memcpy (header.magic, PROGRAM_BINARY_MAGIC, sizeof (header.magic));
+	header.key = key;
+	std::vector<char> binary (binarySize);
+	GLenum binaryFormat;
+	glGetProgramBinary (m_id, binarySize, nullptr, &binaryFormat, binary.data ());
+	header.binaryFormat = binaryFormat;
+	header.binarySize = static_cast<uint32_t> (binarySize);
+
+	// Write to a temporary file first so that an interrupted write never leaves a truncated binary
+	std::string tmpFilename = filename + ".tmp";
+	{
+		std::ofstream out (tmpFilename.c_str (), std::ios::binary | std::ios::trunc);
+		if (!out)
+			throw std::ios_base::failure ("[Shader Program][saveBinary] Cannot open " + tmpFilename);
+		out.write (reinterpret_cast<const char *> (&header), sizeof (header));
+		out.write (binary.data (), binary.size ());
+		if (!out)
+			throw std::ios_base::failure ("[Shader Program][saveBinary] Cannot write " + tmpFilename);
+	}
+	std::error_code ec;
+	std::filesystem::rename (tmpFilename, filename, ec);
+	if (ec)
+	{
+		std::filesystem::remove (tmpFilename, ec);
+		throw std::ios_base::failure ("[Shader Program][saveBinary] Cannot write " + filename);
+	}
+}
+
+std::shared_ptr<ShaderProgram> ShaderProgram::genCachedShaderProgram (const std::string & vertexShaderFilename,
+																	  const std::string & fragmentShaderFilename,
+																	  const std::string & cacheDirectory,
+																	  const std::string & defines,
+																	  const std::string & variantName)
+{
+	auto start = std::chrono::high_resolution_clock::now ();
+	std::string vertexShaderSource = addDefines (file2String (vertexShaderFilename), defines);
+	std::string fragmentShaderSource = addDefines (file2String (fragmentShaderFilename), defines);
+
+	// One file per program, named after its shaders and variant, so that editing them replaces the binary instead of adding one
+	std::string name = std::filesystem::path (vertexShaderFilename).stem ().string () + "-" + std::filesystem::path (fragmentShaderFilename).stem ().string ();
+	if (!variantName.empty ())
+		name += "-" + variantName;
+	std::string binaryFilename = cacheDirectory + "/" + name + ".glbin";
+	uint64_t key = hashString (vertexShaderSource);
+	key = hashString (fragmentShaderSource, key);
+	key = hashString (glString (GL_VENDOR) + "\n" + glString (GL_RENDERER) + "\n" + glString (GL_VERSION), key);
+
+	GLint numBinaryFormats = 0;
+	glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+	std::shared_ptr<ShaderProgram> shaderProgramPtr = std::make_shared<ShaderProgram> ();
+	bool fromCache = numBinaryFormats > 0 && shaderProgramPtr->loadBinary (binaryFilename, key);
+	if (!fromCache)
+	{
+		// A rejected binary leaves the program unusable: start over from the sources
+		shaderProgramPtr = std::make_shared<ShaderProgram> ();
+		shaderProgramPtr->attachShader (GL_VERTEX_SHADER, vertexShaderSource);
+		shaderProgramPtr->attachShader (GL_FRAGMENT_SHADER, fragmentShaderSource);
+		glProgramParameteri (shaderProgramPtr->id (), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		shaderProgramPtr->link ();
+		if (numBinaryFormats > 0 && shaderProgramPtr->isLinked ()) // A program failing to link is never cached
+		{
+			try
+			{
+				std::error_code ec;
+				std::filesystem::create_directories (cacheDirectory, ec);
+				shaderProgramPtr->saveBinary (binaryFilename, key);
+			}
+			catch (std::exception & e) // Compiled again next time
+			{
+				std::cerr << "> [Error caching shader program]" << e.what () << std::endl;
+			}
+		}
+	}
+	shaderProgramPtr->use ();
+
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	std::cout << " > Shader program <" << name << "> " << (fromCache ? "loaded from its binary cache" : "compiled") << " in "
+			  << seconds * 1000.0 << " ms" << std::endl;
+	return shaderProgramPtr;
+}
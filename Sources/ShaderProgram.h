@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <string>
 #include <memory>
+#include <cstdint>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
@@ -18,40 +20,113 @@ public:
 	static std::shared_ptr<ShaderProgram> genBasicShaderProgram (const std::string & vertexShaderFilename,
 															 	 const std::string & fragmentShaderFilename);
 
+	/// Same as genBasicShaderProgram, the linked program being kept in cacheDirectory as a program binary
+	/// (glGetProgramBinary) keyed by the hash of the sources and of the GL vendor, renderer and version
+	/// strings. When the key matches, the binary is loaded back with glProgramBinary and nothing is
+	/// compiled: sources are only compiled when they changed, the driver was updated, or it rejects the
+	/// binary. The time taken and whether the cache was used are reported on the standard output.
+	/// defines are added to both shaders (see addDefines), and a variant built with them is cached
+	/// under its own variantName.
+	static std::shared_ptr<ShaderProgram> genCachedShaderProgram (const std::string & vertexShaderFilename,
+																  const std::string & fragmentShaderFilename,
+																  const std::string & cacheDirectory,
+																  const std::string & defines = "",
+																  const std::string & variantName = "");
+
 	/// OpenGL identifier of the program
 	inline GLuint id () { return m_id; }
 
 	/// Loads and compile a shader from a text file, before attaching it to a program
 	void loadShader (GLenum type, const std::string & shaderFilename);
 
-	/// The main GPU program is ready to be handle streams of polygons
-	inline void link () { glLinkProgram (m_id); }
+	/// The main GPU program is ready to be handle streams of polygons. The uniform locations and
+	/// values known to the program are reset.
+	inline void link () { glLinkProgram (m_id); resetUniforms (); }
+
+	/// True once the program is successfully linked, from sources or from a program binary
+	bool isLinked () const;
 
-	/// Activate the program
-	inline void use () { glUseProgram (m_id); }
+	/// Activate the program, unless it is active already
+	inline void use () { bind (m_id); }
 
 	/// Desactivate the current program
-	inline static void stop () { glUseProgram (0); }
+	inline static void stop () { bind (0); }
 
-	inline GLuint getLocation (const std::string & name) { return glGetUniformLocation (m_id, name.c_str ()); }
+	/// Location of a uniform, -1 if the program has no such active uniform. All the locations are
+	/// listed once, at the first call after linking, rather than queried by name at each call.
+	GLint getLocation (const std::string & name);
 
-	inline void set (const std::string & name, float value) { glUniform1f (getLocation (name.c_str ()), value); }
+	// Uniforms are set with glProgramUniform: the program does not need to be active. A value equal to
+	// the one the uniform already has is not sent to GL.
 
-	inline void set (const std::string & name, int value) { glUniform1i (getLocation (name.c_str ()), value); }
+	inline void set (const std::string & name, float value) { setUniform (name, GL_FLOAT, &value); }
 
-	inline void set (const std::string & name, const glm::vec2 & value) { glUniform2fv (getLocation (name.c_str ()), 1, glm::value_ptr(value)); }
+	inline void set (const std::string & name, int value) { setUniform (name, GL_INT, &value); }
 
-	inline void set (const std::string & name, const glm::vec3 & value) { glUniform3fv (getLocation (name.c_str ()), 1, glm::value_ptr(value)); }
+	inline void set (const std::string & name, const glm::vec2 & value) { setUniform (name, GL_FLOAT_VEC2, glm::value_ptr (value)); }
 
-	inline void set (const std::string & name, const glm::vec4 & value) { glUniform4fv (getLocation (name.c_str ()), 1, glm::value_ptr(value)); }
+	inline void set (const std::string & name, const glm::vec3 & value) { setUniform (name, GL_FLOAT_VEC3, glm::value_ptr (value)); }
 
-	inline void set (const std::string & name, const glm::mat4 & value) { glUniformMatrix4fv (getLocation (name.c_str ()), 1, GL_FALSE, glm::value_ptr(value)); }
+	inline void set (const std::string & name, const glm::vec4 & value) { setUniform (name, GL_FLOAT_VEC4, glm::value_ptr (value)); }
+
+	inline void set (const std::string & name, const glm::mat4 & value) { setUniform (name, GL_FLOAT_MAT4, glm::value_ptr (value)); }
+
+	/// Gives the program the last value set to each uniform of other, e.g. when a reloaded program
+	/// replaces other. Uniforms the program does not have are ignored.
+	void copyUniformsFrom (const ShaderProgram & other);
+
+	/// GL calls made by set and use, and calls skipped because they would not have changed anything,
+	/// over every program since the last resetCallCounters
+	struct CallCounters {
+		size_t uniformCalls = 0;
+		size_t elidedUniformCalls = 0;
+		size_t useCalls = 0;
+		size_t elidedUseCalls = 0;
+	};
+
+	static inline const CallCounters & callCounters () { return s_callCounters; }
+
+	static inline void resetCallCounters () { s_callCounters = CallCounters (); }
 
-private:
 	/// Loads the content of an ASCII file in a standard C++ string
-	std::string file2String (const std::string & filename);
+	static std::string file2String (const std::string & filename);
+
+	/// Inserts lines of #define right after the #version line of a shader source, which must stay
+	/// first. Line numbers in the compile errors remain those of the file.
+	static std::string addDefines (const std::string & source, const std::string & defines);
+
+private:
+	/// Compiles a shader from its source and attaches it to the program
+	void attachShader (GLenum type, const std::string & source);
+
+	/// Replaces the program by a binary written by saveBinary, returns false if the driver rejects it
+	bool loadBinary (const std::string & filename, uint64_t key);
+
+	/// Writes the linked program to filename, along with the key of its sources and driver
+	void saveBinary (const std::string & filename, uint64_t key);
+
+	/// Location of a uniform, and the last value given to it through set
+	struct Uniform {
+		GLint location = -1;
+		GLenum type = GL_NONE; // GL_FLOAT, GL_INT, GL_FLOAT_VEC2, GL_FLOAT_VEC3, GL_FLOAT_VEC4 or GL_FLOAT_MAT4 once set
+		GLfloat value[16]; // The bits of the value, whatever its type
+	};
+
+	/// Lists the active uniforms with their locations
+	void listUniforms ();
+
+	inline void resetUniforms () { m_uniforms.clear (); m_hasUniformList = false; }
+
+	void setUniform (const std::string & name, GLenum type, const void * value);
+
+	static void bind (GLuint id);
 
 	GLuint m_id = 0;
+	std::unordered_map<std::string, Uniform> m_uniforms; // Active uniforms, and uniforms set without being active
+	bool m_hasUniformList = false;
+
+	static GLuint s_activeProgram;
+	static CallCounters s_callCounters;
 };
 
 #endif // SHADER_PROGRAM_H
@@ -0,0 +1,284 @@
+#include "ShaderReloader.h"
+
+#include "Hash.h"
+
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Period of the modification time polling, when inotify is not available
+const auto POLL_PERIOD = std::chrono::milliseconds (250);
+
+int64_t writeTime (const std::string & filename)
+{
+	std::error_code ec;
+	auto time = fs::last_write_time (filename, ec);
+	return ec ? 0 : static_cast<int64_t> (time.time_since_epoch ().count ());
+}
+
+std::string shaderInfoLog (GLuint shader)
+{
+	GLint length = 0;
+	glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &length);
+	std::string log (std::max (length, 1), '\0');
+	glGetShaderInfoLog (shader, length, nullptr, &log[0]);
+	return log.c_str ();
+}
+
+std::string programInfoLog (GLuint program)
+{
+	GLint length = 0;
+	glGetProgramiv (program, GL_INFO_LOG_LENGTH, &length);
+	std::string log (std::max (length, 1), '\0');
+	glGetProgramInfoLog (program, length, nullptr, &log[0]);
+	return log.c_str ();
+}
+
+}
+
+ShaderReloader::ShaderReloader (const std::string & vertexShaderFilename, const std::string & fragmentShaderFilename)
+{
+	for (const auto & [type, filename] : { std::make_pair (GLenum (GL_VERTEX_SHADER), vertexShaderFilename),
+										   std::make_pair (GLenum (GL_FRAGMENT_SHADER), fragmentShaderFilename) })
+	{
+		Stage stage;
+		stage.type = type;
+		stage.filename = filename;
+		m_stages.push_back (stage);
+		m_writeTimes.push_back (writeTime (filename));
+	}
+
+	if (GLAD_GL_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR (0xFFFFFFFF); // As many as the driver sees fit
+		m_hasParallelCompile = true;
+	}
+	else if (GLAD_GL_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB (0xFFFFFFFF);
+		m_hasParallelCompile = true;
+	}
+
+#ifdef __linux__
+	// The directory is watched rather than the files: editors often replace a file by renaming a new one over it.
+	// Only complete writes count, not the intermediate steps of a save.
+	std::string directory = fs::path (vertexShaderFilename).parent_path ().string ();
+	m_inotifyFd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotifyFd >= 0 && inotify_add_watch (m_inotifyFd, directory.empty () ? "." : directory.c_str (), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		close (m_inotifyFd);
+		m_inotifyFd = -1;
+	}
+#endif
+	std::cout << " > Watching shaders for changes (" << (m_inotifyFd >= 0 ? "inotify" : "polling") << ", "
+			  << (m_hasParallelCompile ? "parallel" : "blocking") << " compilation)" << std::endl;
+}
+
+ShaderReloader::~ShaderReloader ()
+{
+#ifdef __linux__
+	if (m_inotifyFd >= 0)
+		close (m_inotifyFd);
+#endif
+	for (const Variant & variant : m_variants)
+		for (const CompiledStage & stage : variant.stages)
+			if (stage.shader != 0)
+				glDeleteShader (stage.shader);
+}
+
+void ShaderReloader::setVariants (const std::vector<std::string> & definesList)
+{
+	std::vector<Variant> variants;
+	for (const std::string & defines : definesList)
+	{
+		auto it = std::find_if (m_variants.begin (), m_variants.end (), [&] (const Variant & variant) { return variant.defines == defines; });
+		if (it != m_variants.end ())
+		{
+			variants.push_back (std::move (*it));
+			m_variants.erase (it);
+		}
+		else
+		{
+			Variant variant;
+			variant.defines = defines;
+			variant.stages.resize (m_stages.size ());
+			variants.push_back (std::move (variant));
+		}
+	}
+	for (const Variant & variant : m_variants) // No longer listed
+		for (const CompiledStage & stage : variant.stages)
+			if (stage.shader != 0)
+				glDeleteShader (stage.shader);
+	m_variants = std::move (variants);
+}
+
+bool ShaderReloader::pollChanges ()
+{
+	bool changed = false;
+#ifdef __linux__
+	if (m_inotifyFd >= 0)
+	{
+		alignas (inotify_event) char buffer[16 * (sizeof (inotify_event) + NAME_MAX + 1)];
+		for (ssize_t length; (length = read (m_inotifyFd, buffer, sizeof (buffer))) > 0; )
+			for (char * p = buffer; p < buffer + length; )
+			{
+				const inotify_event * event = reinterpret_cast<const inotify_event *> (p);
+				for (const Stage & stage : m_stages)
+					changed |= (event->len > 0 && fs::path (stage.filename).filename () == event->name);
+				p += sizeof (inotify_event) + event->len;
+			}
+		return changed;
+	}
+#endif
+	auto now = std::chrono::steady_clock::now ();
+	if (now - m_lastPoll < POLL_PERIOD)
+		return false;
+	m_lastPoll = now;
+	for (size_t i = 0; i < m_stages.size (); i++)
+	{
+		int64_t time = writeTime (m_stages[i].filename);
+		changed |= (time != m_writeTimes[i]);
+		m_writeTimes[i] = time;
+	}
+	return changed;
+}
+
+void ShaderReloader::startBuild ()
+{
+	m_buildStart = std::chrono::high_resolution_clock::now ();
+	m_isBuilding = false;
+	std::vector<std::string> sources;
+	for (const Stage & stage : m_stages)
+	{
+		try
+		{
+			sources.push_back (ShaderProgram::file2String (stage.filename));
+		}
+		catch (std::exception & e) // Being replaced: its next write triggers another build
+		{
+			std::cerr << "> [Error reloading shaders]" << e.what () << std::endl;
+			return;
+		}
+	}
+	for (Variant & variant : m_variants)
+	{
+		variant.pendingProgramPtr = std::make_shared<ShaderProgram> ();
+		for (size_t i = 0; i < m_stages.size (); i++)
+		{
+			CompiledStage & stage = variant.stages[i];
+			std::string source = ShaderProgram::addDefines (sources[i], variant.defines);
+			uint64_t sourceHash = hashString (source);
+			if (stage.shader == 0 || sourceHash != stage.sourceHash)
+			{
+				if (stage.shader != 0)
+					glDeleteShader (stage.shader);
+				stage.shader = glCreateShader (m_stages[i].type);
+				const GLchar * shaderSource = source.c_str ();
+				glShaderSource (stage.shader, 1, &shaderSource, NULL);
+				glCompileShader (stage.shader); // Returns at once with the parallel compile extension
+				stage.sourceHash = sourceHash;
+				stage.isPending = true;
+			}
+			glAttachShader (variant.pendingProgramPtr->id (), stage.shader);
+		}
+		variant.pendingProgramPtr->link ();
+	}
+	m_isBuilding = !m_variants.empty ();
+}
+
+bool ShaderReloader::isBuildCompleted ()
+{
+	if (!m_hasParallelCompile)
+		return true;
+	for (const Variant & variant : m_variants)
+	{
+		if (!variant.pendingProgramPtr)
+			continue;
+		GLint completed = GL_FALSE;
+		glGetProgramiv (variant.pendingProgramPtr->id (), GL_COMPLETION_STATUS_KHR, &completed);
+		if (completed != GL_TRUE)
+			return false;
+	}
+	return true;
+}
+
+ShaderReloader::Programs ShaderReloader::finishBuild ()
+{
+	m_isBuilding = false;
+	Programs programs;
+	int numCompiled = 0;
+	int numFailed = 0; // Variants usually fail the same way: only the errors of the first one are printed
+	for (Variant & variant : m_variants)
+	{
+		std::shared_ptr<ShaderProgram> programPtr;
+		programPtr.swap (variant.pendingProgramPtr);
+		if (!programPtr) // Added during the build
+			continue;
+		bool failed = false;
+		for (size_t i = 0; i < m_stages.size (); i++)
+		{
+			CompiledStage & stage = variant.stages[i];
+			if (!stage.isPending)
+				continue;
+			stage.isPending = false;
+			numCompiled++;
+			GLint status = GL_FALSE;
+			glGetShaderiv (stage.shader, GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE)
+			{
+				if (numFailed == 0)
+					std::cerr << "> [Error compiling " << m_stages[i].filename << "]" << std::endl << shaderInfoLog (stage.shader) << std::endl;
+				glDeleteShader (stage.shader); // Compiled again once the file is fixed
+				stage.shader = 0;
+				failed = true;
+			}
+		}
+		if (!failed && !programPtr->isLinked ())
+		{
+			if (numFailed == 0)
+				std::cerr << "> [Error linking shader program]" << std::endl << programInfoLog (programPtr->id ()) << std::endl;
+			failed = true;
+		}
+		if (failed)
+			numFailed++;
+		else
+			programs[variant.defines] = programPtr;
+	}
+	if (numFailed > 0)
+	{
+		std::cerr << "> [Error reloading shaders] " << numFailed << " variant(s) failed, the current programs stay in use" << std::endl;
+		return Programs ();
+	}
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - m_buildStart).count ();
+	std::cout << " > Shader programs reloaded: " << programs.size () << " variant(s), " << numCompiled << " shader(s) compiled in "
+			  << seconds * 1000.0 << " ms" << std::endl;
+	return programs;
+}
+
+ShaderReloader::Programs ShaderReloader::update ()
+{
+	if (pollChanges () || m_reloadRequested)
+	{
+		for (Variant & variant : m_variants) // Outdated, the stages they compiled are checked with the next build
+			variant.pendingProgramPtr.reset ();
+		m_reloadRequested = false;
+		startBuild ();
+	}
+	if (!m_isBuilding || !isBuildCompleted ())
+		return Programs ();
+	return finishBuild ();
+}
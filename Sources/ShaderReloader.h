@@ -0,0 +1,88 @@
+#ifndef SHADER_RELOADER_H
+#define SHADER_RELOADER_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+
+#include "ShaderProgram.h"
+
+/// Rebuilds a shader program in the background whenever its source files change on disk. The shader
+/// directory is watched with inotify on Linux (modification times are polled elsewhere), only the
+/// stages whose source actually changed are recompiled, and with GL_KHR_parallel_shader_compile
+/// (or its ARB version) compiling and linking run on driver threads while frames keep being drawn.
+/// Without it they happen within a single update. Every variant set with setVariants (see
+/// ShaderVariants) is rebuilt, from the same sources with its own defines, and they are all returned
+/// together. Must be used from the thread owning the GL context.
+class ShaderReloader {
+public:
+	ShaderReloader (const std::string & vertexShaderFilename, const std::string & fragmentShaderFilename);
+
+	virtual ~ShaderReloader ();
+
+	ShaderReloader (const ShaderReloader &) = delete;
+	ShaderReloader & operator= (const ShaderReloader &) = delete;
+
+	/// Rebuilt programs, by the defines of their variant
+	using Programs = std::unordered_map<std::string, std::shared_ptr<ShaderProgram>>;
+
+	/// Variants to rebuild, given by their defines (ShaderVariantKey::defines). Those no longer
+	/// listed are forgotten, the ones added are compiled at the next rebuild.
+	void setVariants (const std::vector<std::string> & definesList);
+
+	/// Rebuilds the programs at the next update, even if no file changed
+	inline void requestReload () { m_reloadRequested = true; }
+
+	/// Called once per frame: returns the rebuilt programs once they are all linked, nothing otherwise
+	/// (no change, still compiling, or failed, in which case the errors are printed and the current
+	/// programs should stay in use)
+	Programs update ();
+
+private:
+	struct Stage {
+		GLenum type;
+		std::string filename;
+	};
+
+	/// Shader of a stage compiled for a variant
+	struct CompiledStage {
+		uint64_t sourceHash = 0; // Of the source with the defines
+		GLuint shader = 0; // Compiled from the source hashed, 0 until the first rebuild
+		bool isPending = false; // Compiled for the program being linked
+	};
+
+	struct Variant {
+		std::string defines;
+		std::vector<CompiledStage> stages; // Same order as m_stages
+		std::shared_ptr<ShaderProgram> pendingProgramPtr;
+	};
+
+	/// True if a watched file was written since the last call
+	bool pollChanges ();
+
+	/// Compiles, for every variant, the stages whose source changed or that were never compiled, and starts linking
+	void startBuild ();
+
+	/// True once the driver completed every pending program
+	bool isBuildCompleted ();
+
+	/// Checks the build once the driver completed it: returns the programs if they all linked
+	Programs finishBuild ();
+
+	std::vector<Stage> m_stages;
+	std::vector<Variant> m_variants;
+	bool m_isBuilding = false;
+	std::chrono::high_resolution_clock::time_point m_buildStart;
+	bool m_reloadRequested = false;
+	bool m_hasParallelCompile = false;
+	int m_inotifyFd = -1;
+	std::chrono::steady_clock::time_point m_lastPoll;
+	std::vector<int64_t> m_writeTimes; // Polled when inotify is not available
+};
+
+#endif // SHADER_RELOADER_H
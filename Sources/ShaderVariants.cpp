@@ -0,0 +1,60 @@
+#include "ShaderVariants.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+std::string ShaderVariantKey::defines () const
+{
+	return "#define SHADER_MODE " + std::to_string (shaderMode) + "\n"
+		 + "#define NUMBER_LIGHT_USED " + std::to_string (numberLightUsed) + "\n"
+		 + "#define TEXTURE_USING " + std::to_string (textureUsing) + "\n"
+		 + "#define NORMAL_MAP_USED " + std::to_string (normalMapUsed) + "\n"
+		 + "#define SUBSURFACE_SCATTERING " + std::to_string (subsurfaceScattering) + "\n"
+		 + "#define REFERENCE_SHADING " + std::to_string (referenceShading) + "\n";
+}
+
+std::string ShaderVariantKey::name () const
+{
+	return "m" + std::to_string (shaderMode) + "-l" + std::to_string (numberLightUsed) + "-t" + std::to_string (textureUsing)
+		 + "-n" + std::to_string (normalMapUsed) + "-s" + std::to_string (subsurfaceScattering) + (referenceShading ? "-r" : "");
+}
+
+ShaderVariants::ShaderVariants (const std::string & vertexShaderFilename, const std::string & fragmentShaderFilename, const std::string & cacheDirectory) :
+	m_vertexShaderFilename (vertexShaderFilename),
+	m_fragmentShaderFilename (fragmentShaderFilename),
+	m_cacheDirectory (cacheDirectory) {}
+
+std::shared_ptr<ShaderProgram> ShaderVariants::get (const ShaderVariantKey & key)
+{
+	std::string defines = key.defines ();
+	auto it = m_programs.find (defines);
+	if (it != m_programs.end ())
+		return it->second;
+	std::shared_ptr<ShaderProgram> programPtr = ShaderProgram::genCachedShaderProgram (m_vertexShaderFilename, m_fragmentShaderFilename,
+																					   m_cacheDirectory, defines, key.name ());
+	if (!programPtr->isLinked ())
+	{
+		GLint length = 0;
+		glGetProgramiv (programPtr->id (), GL_INFO_LOG_LENGTH, &length);
+		std::string log (std::max (length, 1), '\0');
+		glGetProgramInfoLog (programPtr->id (), length, nullptr, &log[0]);
+		throw std::runtime_error ("[Shader Variants][get] Cannot link variant " + key.name () + "\n" + log.c_str ());
+	}
+	m_programs[defines] = programPtr;
+	return programPtr;
+}
+
+void ShaderVariants::replace (const std::string & defines, const std::shared_ptr<ShaderProgram> & programPtr)
+{
+	m_programs[defines] = programPtr;
+}
+
+std::vector<std::string> ShaderVariants::definesList () const
+{
+	std::vector<std::string> definesList;
+	for (const auto & [defines, programPtr] : m_programs)
+		definesList.push_back (defines);
+	return definesList;
+}
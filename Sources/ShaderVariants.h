@@ -0,0 +1,54 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "ShaderProgram.h"
+
+/// Rendering options compiled into a shader program, as #defines tested by FragmentShader.glsl,
+/// instead of uniforms branched on for every fragment
+struct ShaderVariantKey {
+	int shaderMode = 0; // SHADER_MODE, one of the GLSL_SHADER_* values
+	int numberLightUsed = 1; // NUMBER_LIGHT_USED, 1 to 3
+	int textureUsing = 0; // TEXTURE_USING, 0 or 1
+	int normalMapUsed = 0; // NORMAL_MAP_USED, 0 or 1
+	int subsurfaceScattering = 0; // SUBSURFACE_SCATTERING, 0, 1 (added) or 2 (alone)
+	int referenceShading = 0; // REFERENCE_SHADING, 1 to shade the PBR mode as before its fast path, for comparison only
+
+	/// Lines of #define given to the shaders
+	std::string defines () const;
+
+	/// Short name of the variant, used for its program binary, e.g. "m0-l3-t1-n0-s0", with "-r" at the end for the reference shading
+	std::string name () const;
+};
+
+/// Programs built from the same pair of shader files with different options. Each variant is
+/// compiled, or loaded from its program binary (see ShaderProgram::genCachedShaderProgram), the
+/// first time it is asked for, and kept: switching between options already used compiles nothing.
+class ShaderVariants {
+public:
+	ShaderVariants (const std::string & vertexShaderFilename, const std::string & fragmentShaderFilename, const std::string & cacheDirectory);
+
+	virtual ~ShaderVariants () = default;
+
+	/// Program of a variant, built if needed. Throws std::runtime_error if it does not link, leaving
+	/// the other variants untouched.
+	std::shared_ptr<ShaderProgram> get (const ShaderVariantKey & key);
+
+	/// Replaces the program of the variant built with defines, e.g. by ShaderReloader
+	void replace (const std::string & defines, const std::shared_ptr<ShaderProgram> & programPtr);
+
+	/// Defines of every variant built so far
+	std::vector<std::string> definesList () const;
+
+private:
+	std::string m_vertexShaderFilename;
+	std::string m_fragmentShaderFilename;
+	std::string m_cacheDirectory;
+	std::unordered_map<std::string, std::shared_ptr<ShaderProgram>> m_programs; // By defines
+};
+
+#endif // SHADER_VARIANTS_H
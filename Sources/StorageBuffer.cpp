@@ -0,0 +1,50 @@
+#include "StorageBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+size_t StorageBuffer::s_uploadCounter = 0;
+
+namespace {
+
+/// Never empty: a buffer bound to a storage block must have a data store
+const size_t MIN_CAPACITY = 256;
+
+}
+
+StorageBuffer::StorageBuffer (GLuint binding) : m_binding (binding)
+{
+	m_capacity = MIN_CAPACITY;
+	glCreateBuffers (1, &m_id);
+	std::vector<uint8_t> zeros (m_capacity, 0);
+	glNamedBufferData (m_id, static_cast<GLsizeiptr> (m_capacity), zeros.data (), GL_DYNAMIC_DRAW);
+}
+
+StorageBuffer::~StorageBuffer ()
+{
+	glDeleteBuffers (1, &m_id);
+}
+
+void StorageBuffer::setData (const void * data, size_t size)
+{
+	if (size == m_data.size () && std::memcmp (m_data.data (), data, size) == 0)
+		return;
+	m_data.assign (static_cast<const uint8_t *> (data), static_cast<const uint8_t *> (data) + size);
+	if (size > m_capacity)
+	{
+		// Grown geometrically so that a slowly increasing size does not reallocate every frame. The
+		// buffer keeps its name, and its binding.
+		m_capacity = std::max (size, 2 * m_capacity);
+		glNamedBufferData (m_id, static_cast<GLsizeiptr> (m_capacity), nullptr, GL_DYNAMIC_DRAW);
+	}
+	if (size > 0)
+		glNamedBufferSubData (m_id, 0, static_cast<GLsizeiptr> (size), m_data.data ());
+	s_uploadCounter++;
+}
+
+void StorageBuffer::bind ()
+{
+	glBindBufferBase (GL_SHADER_STORAGE_BUFFER, m_binding, m_id);
+}
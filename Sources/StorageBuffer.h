@@ -0,0 +1,50 @@
+#ifndef STORAGE_BUFFER_H
+#define STORAGE_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+/// GL shader storage buffer holding an array whose size changes over time, e.g. the lights or their
+/// clusters, bound to the binding point the shaders declare for it (see UniformBlocks.h). As for
+/// UniformBuffer, contents equal to the previous ones are not uploaded. The buffer only grows.
+/// Must be used from the thread owning the GL context.
+class StorageBuffer {
+public:
+	StorageBuffer (GLuint binding);
+
+	virtual ~StorageBuffer ();
+
+	StorageBuffer (const StorageBuffer &) = delete;
+	StorageBuffer & operator= (const StorageBuffer &) = delete;
+
+	/// Replaces the contents of the buffer, uploaded at once if they changed
+	template<typename Element>
+	inline void set (const std::vector<Element> & elements) {
+		static_assert (std::is_trivially_copyable<Element>::value, "Storage buffers are copied as bytes");
+		setData (elements.data (), elements.size () * sizeof (Element));
+	}
+
+	/// Binds the buffer to its binding point
+	void bind ();
+
+	/// Number of uploads made by every storage buffer since the last resetUploadCounter
+	static inline size_t uploadCounter () { return s_uploadCounter; }
+
+	static inline void resetUploadCounter () { s_uploadCounter = 0; }
+
+private:
+	void setData (const void * data, size_t size);
+
+	GLuint m_id = 0;
+	GLuint m_binding;
+	size_t m_capacity = 0;
+	std::vector<uint8_t> m_data;
+
+	static size_t s_uploadCounter;
+};
+
+#endif // STORAGE_BUFFER_H
@@ -0,0 +1,96 @@
+#ifndef TEXT_SCANNER_H
+#define TEXT_SCANNER_H
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <exception>
+#include <ios>
+#include <system_error>
+
+/// Allocation-free tokenizer over an in-memory ASCII buffer (typically a MappedFile).
+/// Numbers are decoded in place with std::from_chars, so there is no stream state
+/// and no temporary string per token. Lines starting with '#' are treated as comments.
+class TextScanner {
+public:
+	TextScanner (const char * begin, const char * end) : m_begin (begin), m_cur (begin), m_end (end) {}
+
+	inline const char * position () const { return m_cur; }
+	inline void setPosition (const char * p) { m_cur = p; }
+	inline const char * end () const { return m_end; }
+
+	/// Skips blanks, line breaks and comments up to the next token
+	inline void skipSpaces () {
+		while (m_cur < m_end) {
+			char c = *m_cur;
+			if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v')
+				++m_cur;
+			else if (c == '#')
+				skipLine ();
+			else
+				break;
+		}
+	}
+
+	/// Skips blanks but stops at line breaks
+	inline void skipBlanks () {
+		while (m_cur < m_end && (*m_cur == ' ' || *m_cur == '\t' || *m_cur == '\r'))
+			++m_cur;
+	}
+
+	/// Moves the cursor right after the next line break
+	inline void skipLine () {
+		while (m_cur < m_end && *m_cur != '\n')
+			++m_cur;
+		if (m_cur < m_end)
+			++m_cur;
+	}
+
+	inline bool atEnd () { skipSpaces (); return m_cur >= m_end; }
+
+	/// True when only blanks remain before the end of the current line
+	inline bool atEndOfLine () { skipBlanks (); return m_cur >= m_end || *m_cur == '\n' || *m_cur == '#'; }
+
+	/// Returns a pointer to the next whitespace-separated token and its length, without copying it
+	inline const char * readWord (size_t & length) {
+		skipSpaces ();
+		const char * start = m_cur;
+		while (m_cur < m_end && !isSpace (*m_cur))
+			++m_cur;
+		length = static_cast<size_t> (m_cur - start);
+		return start;
+	}
+
+	inline std::string readString () {
+		size_t length;
+		const char * word = readWord (length);
+		return std::string (word, length);
+	}
+
+	template<typename T>
+	inline T read () {
+		skipSpaces ();
+		T value;
+		const char * start = m_cur;
+		if (start < m_end && *start == '+') // from_chars does not accept an explicit positive sign
+			++start;
+		std::from_chars_result result = std::from_chars (start, m_end, value);
+		if (result.ec != std::errc ())
+			throw std::ios_base::failure ("[Text Scanner][read] Malformed number near offset " + std::to_string (m_cur - m_begin));
+		m_cur = result.ptr;
+		return value;
+	}
+
+	inline float readFloat () { return read<float> (); }
+	inline unsigned int readUInt () { return read<unsigned int> (); }
+	inline int readInt () { return read<int> (); }
+
+private:
+	static inline bool isSpace (char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+
+	const char * m_begin;
+	const char * m_cur;
+	const char * m_end;
+};
+
+#endif // TEXT_SCANNER_H
@@ -0,0 +1,169 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+/// Creates a texture from the blocks of a compressed image, mip levels included
+GLuint uploadCompressedTexture (const TextureImage & image, size_t & bytes)
+{
+	const TextureCompressor::CompressedTexture & compressed = image.compressed ();
+	GLuint id;
+	glGenTextures (1, &id);
+	glBindTexture (GL_TEXTURE_2D, id);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint> (compressed.levels.size ()) - 1);
+	for (size_t level = 0; level < compressed.levels.size (); level++)
+		glCompressedTexImage2D (GL_TEXTURE_2D, static_cast<GLint> (level), compressed.format,
+								std::max (1, compressed.width >> level), std::max (1, compressed.height >> level), 0,
+								static_cast<GLsizei> (compressed.levels[level].size ()), compressed.levels[level].data ());
+	glBindTexture (GL_TEXTURE_2D, 0);
+	bytes = compressed.bytes ();
+	return id;
+}
+
+/// Creates a texture from an image decoded on the CPU and returns its name along with its size in video memory.
+/// Mip levels come with the image (see loadNormalMap), or are generated by the driver.
+GLuint uploadTexture (const TextureImage & image, bool isNormalMap, size_t & bytes)
+{
+	static const GLenum formats[5] = { GL_RGB, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	// Indexed by channels, then by bytes per channel; alpha is not used by the shaders
+	static const GLint internalFormats[5][3] = { { GL_RGB8, GL_RGB16, GL_RGB32F }, { GL_R8, GL_R16, GL_R32F }, { GL_RG8, GL_RG16, GL_RG32F },
+												 { GL_RGB8, GL_RGB16, GL_RGB32F }, { GL_RGB8, GL_RGB16, GL_RGB32F } };
+	static const GLenum types[3] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_FLOAT };
+	static const unsigned char defaultTexel[4] = { 255, 255, 255, 255 };
+	static const unsigned char defaultNormalTexel[2] = { 128, 128 };
+
+	// A missing map is replaced by a single neutral texel: white, or a flat normal
+	int width = image.isEmpty () ? 1 : image.width ();
+	int height = image.isEmpty () ? 1 : image.height ();
+	int numComponents = image.isEmpty () ? (isNormalMap ? 2 : 4) : image.numComponents ();
+	int typeIndex = image.isEmpty () ? 0 : image.bytesPerChannel () / 2;
+	int numLevels = image.isEmpty () ? 1 : image.numLevels ();
+	GLint internalFormat = internalFormats[numComponents][typeIndex];
+	size_t texelBytes = size_t (numComponents == 1 || numComponents == 2 ? numComponents : 4) << typeIndex; // Drivers pad RGB to 4 channels
+
+	GLuint id;
+	glGenTextures (1, &id);
+	glBindTexture (GL_TEXTURE_2D, id);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glPixelStorei (GL_UNPACK_ALIGNMENT, 1); // Rows of RG8 or RGB8 levels are not padded to 4 bytes
+	bytes = 0;
+	for (int level = 0, w = width, h = height; level < numLevels; level++, w = std::max (1, w / 2), h = std::max (1, h / 2))
+	{
+		const void * data = image.isEmpty () ? (isNormalMap ? defaultNormalTexel : defaultTexel) : image.levelData (level);
+		glTexImage2D (GL_TEXTURE_2D, level, internalFormat, w, h, 0, formats[numComponents], types[typeIndex], data);
+		bytes += size_t (w) * size_t (h) * texelBytes;
+	}
+	glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+	if (numLevels == 1)
+	{
+		glGenerateMipmap (GL_TEXTURE_2D);
+		for (int w = width, h = height; w > 1 || h > 1; )
+		{
+			w = std::max (1, w / 2), h = std::max (1, h / 2);
+			bytes += size_t (w) * size_t (h) * texelBytes;
+		}
+	}
+	else
+		glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	glBindTexture (GL_TEXTURE_2D, 0);
+	return id;
+}
+
+}
+
+TextureCache::TextureCache (size_t budgetBytes) : m_budget (budgetBytes) {}
+
+TextureCache::~TextureCache ()
+{
+	clear ();
+}
+
+std::string TextureCache::makeKey (const std::string & filename, bool isNormalMap)
+{
+	return filename + (isNormalMap ? "#normal" : "#color");
+}
+
+std::shared_ptr<Texture> TextureCache::find (const std::string & filename, bool isNormalMap)
+{
+	auto it = m_index.find (makeKey (filename, isNormalMap));
+	if (it == m_index.end ())
+	{
+		m_misses++;
+		return nullptr;
+	}
+	m_hits++;
+	m_entries.splice (m_entries.begin (), m_entries, it->second);
+	return it->second->texture;
+}
+
+bool TextureCache::contains (const std::string & filename, bool isNormalMap) const
+{
+	return m_index.count (makeKey (filename, isNormalMap)) > 0;
+}
+
+std::shared_ptr<Texture> TextureCache::insert (const TextureImage & image, bool isNormalMap)
+{
+	std::string key = makeKey (image.filename (), isNormalMap);
+	auto it = m_index.find (key);
+	if (it != m_index.end ()) // Replaced, e.g. after the file changed
+	{
+		m_bytes -= it->second->texture->bytes ();
+		m_entries.erase (it->second);
+		m_index.erase (it);
+	}
+
+	size_t bytes;
+	GLuint id = image.isCompressed () ? uploadCompressedTexture (image, bytes) : uploadTexture (image, isNormalMap, bytes);
+	auto texture = std::make_shared<Texture> (id, bytes);
+	m_entries.push_front (Entry { key, texture });
+	m_index[key] = m_entries.begin ();
+	m_bytes += bytes;
+	evict (m_budget);
+	return texture;
+}
+
+std::shared_ptr<Texture> TextureCache::get (const std::string & filename, bool isNormalMap)
+{
+	std::shared_ptr<Texture> texture = find (filename, isNormalMap);
+	if (!texture)
+	{
+		std::unique_ptr<TextureImage> image = isNormalMap ? loadNormalMap (filename) : std::make_unique<TextureImage> (filename, false);
+		texture = insert (*image, isNormalMap);
+	}
+	return texture;
+}
+
+void TextureCache::setBudget (size_t budgetBytes)
+{
+	m_budget = budgetBytes;
+	evict (m_budget);
+}
+
+void TextureCache::clear ()
+{
+	evict (0);
+}
+
+void TextureCache::evict (size_t budgetBytes)
+{
+	for (auto it = m_entries.end (); m_bytes > budgetBytes && it != m_entries.begin (); )
+	{
+		--it;
+		if (it->texture.use_count () > 1) // In use: skipped, its bytes stay accounted for
+			continue;
+		m_bytes -= it->texture->bytes ();
+		m_index.erase (it->key);
+		it = m_entries.erase (it);
+		m_evictions++;
+	}
+}
@@ -0,0 +1,91 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <memory>
+#include <list>
+#include <unordered_map>
+
+#include "TextureLoader.h"
+
+/// GL texture owned through shared handles, deleted with its last handle
+class Texture {
+public:
+	Texture (GLuint id, size_t bytes) : m_id (id), m_bytes (bytes) {}
+
+	virtual ~Texture () { glDeleteTextures (1, &m_id); }
+
+	Texture (const Texture &) = delete;
+	Texture & operator= (const Texture &) = delete;
+
+	inline GLuint id () const { return m_id; }
+
+	/// Estimated video memory of the texture, mip levels included
+	inline size_t bytes () const { return m_bytes; }
+
+private:
+	GLuint m_id;
+	size_t m_bytes;
+};
+
+/// Textures already uploaded to the GPU, keyed by file name and load flags. Once the textures
+/// held by the cache exceed its video memory budget, the least recently used ones are evicted;
+/// a texture still referenced outside of the cache is never evicted. Must be used from the thread
+/// owning the GL context.
+class TextureCache {
+public:
+	TextureCache (size_t budgetBytes);
+
+	virtual ~TextureCache ();
+
+	TextureCache (const TextureCache &) = delete;
+	TextureCache & operator= (const TextureCache &) = delete;
+
+	/// Returns the texture of filename loaded with these flags, or nullptr if it is not cached (counted as a miss)
+	std::shared_ptr<Texture> find (const std::string & filename, bool isNormalMap);
+
+	/// True if the texture is cached. Neither counted nor marked as used: meant to plan decoding ahead.
+	bool contains (const std::string & filename, bool isNormalMap) const;
+
+	/// Uploads an image decoded with TextureImage, or loadNormalMap for normal maps, and caches it
+	std::shared_ptr<Texture> insert (const TextureImage & image, bool isNormalMap);
+
+	/// find, or decode and insert on the calling thread on a miss
+	std::shared_ptr<Texture> get (const std::string & filename, bool isNormalMap);
+
+	/// Changes the budget, evicting textures if it is exceeded
+	void setBudget (size_t budgetBytes);
+
+	/// Evicts every texture not referenced outside of the cache
+	void clear ();
+
+	inline size_t budget () const { return m_budget; }
+	inline size_t bytes () const { return m_bytes; }
+	inline size_t size () const { return m_index.size (); }
+	inline size_t hits () const { return m_hits; }
+	inline size_t misses () const { return m_misses; }
+	inline size_t evictions () const { return m_evictions; }
+
+private:
+	struct Entry {
+		std::string key;
+		std::shared_ptr<Texture> texture;
+	};
+
+	static std::string makeKey (const std::string & filename, bool isNormalMap);
+
+	/// Evicts least recently used textures until the budget is met or only textures in use remain
+	void evict (size_t budgetBytes);
+
+	size_t m_budget;
+	size_t m_bytes = 0;
+	size_t m_hits = 0;
+	size_t m_misses = 0;
+	size_t m_evictions = 0;
+	std::list<Entry> m_entries; // Most recently used first
+	std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+};
+
+#endif // TEXTURE_CACHE_H
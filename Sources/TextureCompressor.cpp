@@ -0,0 +1,604 @@
+#include "TextureCompressor.h"
+
+#include <fstream>
+#include <exception>
+#include <stdexcept>
+#include <ios>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+using namespace std;
+
+using namespace TextureCompressor;
+
+namespace {
+
+const uint8_t KTX_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+/// Header of a KTX 1.1 file, following its identifier
+struct KTXHeader {
+	uint32_t endianness;
+	uint32_t glType;
+	uint32_t glTypeSize;
+	uint32_t glFormat;
+	uint32_t glInternalFormat;
+	uint32_t glBaseInternalFormat;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t numberOfArrayElements;
+	uint32_t numberOfFaces;
+	uint32_t numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+inline size_t blockBytes (Format format)
+{
+	return (format == BC1 || format == BC4) ? 8 : 16;
+}
+
+inline size_t levelBytes (Format format, int width, int height)
+{
+	return size_t ((width + 3) / 4) * size_t ((height + 3) / 4) * blockBytes (format);
+}
+
+uint32_t baseInternalFormat (Format format)
+{
+	switch (format)
+	{
+	case BC1: return 0x1907; // GL_RGB
+	case BC4: return 0x1903; // GL_RED
+	case BC5: return 0x8227; // GL_RG
+	default: return 0x1908; // GL_RGBA
+	}
+}
+
+/// Texels of a 4x4 block in RGBA, missing channels read as the GL does for an uncompressed image: 0, and 255 for alpha
+struct Block {
+	float texels[16][4];
+};
+
+void loadBlock (const std::vector<uint8_t> & pixels, int width, int height, int numComponents, int bx, int by, Block & block)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		// Blocks crossing the border of the image repeat its last row and column
+		int x = std::min (4 * bx + i % 4, width - 1);
+		int y = std::min (4 * by + i / 4, height - 1);
+		const uint8_t * texel = &pixels[(size_t (y) * width + x) * numComponents];
+		for (int c = 0; c < 4; c++)
+			block.texels[i][c] = c < numComponents ? texel[c] : (c == 3 ? 255.f : 0.f);
+	}
+}
+
+/// Halves an image with a box filter, the last row or column being repeated when the size is odd
+std::vector<uint8_t> downsample (const std::vector<uint8_t> & pixels, int & width, int & height, int numComponents)
+{
+	int halfWidth = std::max (1, width / 2);
+	int halfHeight = std::max (1, height / 2);
+	std::vector<uint8_t> half (size_t (halfWidth) * halfHeight * numComponents);
+	for (int y = 0; y < halfHeight; y++)
+		for (int x = 0; x < halfWidth; x++)
+		{
+			int x0 = std::min (2 * x, width - 1), x1 = std::min (2 * x + 1, width - 1);
+			int y0 = std::min (2 * y, height - 1), y1 = std::min (2 * y + 1, height - 1);
+			for (int c = 0; c < numComponents; c++)
+			{
+				unsigned int sum = pixels[(size_t (y0) * width + x0) * numComponents + c] + pixels[(size_t (y0) * width + x1) * numComponents + c]
+								 + pixels[(size_t (y1) * width + x0) * numComponents + c] + pixels[(size_t (y1) * width + x1) * numComponents + c];
+				half[(size_t (y) * halfWidth + x) * numComponents + c] = static_cast<uint8_t> ((sum + 2) / 4);
+			}
+		}
+	width = halfWidth;
+	height = halfHeight;
+	return half;
+}
+
+/// Mean and principal axis (power iteration on the covariance) of the first dims channels of the texels.
+/// The axis is null when the texels are all equal.
+void principalAxis (const Block & block, int dims, float mean[4], float axis[4])
+{
+	float covariance[4][4] = {};
+	for (int c = 0; c < dims; c++)
+	{
+		mean[c] = 0.f;
+		for (int i = 0; i < 16; i++)
+			mean[c] += block.texels[i][c];
+		mean[c] /= 16.f;
+	}
+	for (int i = 0; i < 16; i++)
+		for (int a = 0; a < dims; a++)
+			for (int b = 0; b < dims; b++)
+				covariance[a][b] += (block.texels[i][a] - mean[a]) * (block.texels[i][b] - mean[b]);
+	for (int c = 0; c < dims; c++)
+		axis[c] = 1.f;
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float norm = 0.f;
+		for (int a = 0; a < dims; a++)
+		{
+			for (int b = 0; b < dims; b++)
+				next[a] += covariance[a][b] * axis[b];
+			norm += next[a] * next[a];
+		}
+		norm = std::sqrt (norm);
+		for (int c = 0; c < dims; c++)
+			axis[c] = norm > 1e-6f ? next[c] / norm : 0.f;
+	}
+}
+
+/// Endpoints spanning the projections of the texels on their principal axis, low then high
+void fitEndpoints (const Block & block, int dims, float low[4], float high[4])
+{
+	float mean[4], axis[4];
+	principalAxis (block, dims, mean, axis);
+	float tMin = 0.f, tMax = 0.f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.f;
+		for (int c = 0; c < dims; c++)
+			t += (block.texels[i][c] - mean[c]) * axis[c];
+		tMin = std::min (tMin, t);
+		tMax = std::max (tMax, t);
+	}
+	for (int c = 0; c < dims; c++)
+	{
+		low[c] = std::clamp (mean[c] + tMin * axis[c], 0.f, 255.f);
+		high[c] = std::clamp (mean[c] + tMax * axis[c], 0.f, 255.f);
+	}
+}
+
+/// Least squares endpoints for given interpolation weights (0 on low, 1 on high) of the texels.
+/// Returns false when the weights are degenerate, e.g. all equal.
+bool refitEndpoints (const Block & block, int dims, const float weights[16], float low[4], float high[4])
+{
+	float aa = 0.f, bb = 0.f, ab = 0.f, ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float a = 1.f - weights[i], b = weights[i];
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for (int c = 0; c < dims; c++)
+		{
+			ax[c] += a * block.texels[i][c];
+			bx[c] += b * block.texels[i][c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs (determinant) < 1e-6f)
+		return false;
+	for (int c = 0; c < dims; c++)
+	{
+		low[c] = std::clamp ((ax[c] * bb - bx[c] * ab) / determinant, 0.f, 255.f);
+		high[c] = std::clamp ((bx[c] * aa - ax[c] * ab) / determinant, 0.f, 255.f);
+	}
+	return true;
+}
+
+/// Writes fields in increasing bit order, as in BC7 blocks. The output must be zeroed.
+class BitWriter {
+public:
+	BitWriter (uint8_t * out) : m_out (out) {}
+
+	inline void write (uint32_t value, int bits)
+	{
+		for (int i = 0; i < bits; i++, m_position++)
+			if ((value >> i) & 1)
+				m_out[m_position >> 3] |= uint8_t (1 << (m_position & 7));
+	}
+
+private:
+	uint8_t * m_out;
+	int m_position = 0;
+};
+
+// BC1
+
+inline uint16_t packRGB565 (const float color[4])
+{
+	int r = static_cast<int> (std::lround (color[0] * 31.f / 255.f));
+	int g = static_cast<int> (std::lround (color[1] * 63.f / 255.f));
+	int b = static_cast<int> (std::lround (color[2] * 31.f / 255.f));
+	return static_cast<uint16_t> ((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRGB565 (uint16_t packed, float color[3])
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = float ((r << 3) | (r >> 2));
+	color[1] = float ((g << 2) | (g >> 4));
+	color[2] = float ((b << 3) | (b >> 2));
+}
+
+/// Position of the 4 colors of a BC1 palette between the first and the second endpoint
+const float BC1_WEIGHTS[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+/// Encodes a BC1 block with the given endpoints in its 4 color mode. Returns the squared error,
+/// and the weight of every texel for a refit.
+float encodeBC1With (const Block & block, const float low[4], const float high[4], uint8_t * out, float weights[16])
+{
+	uint16_t c0 = packRGB565 (high), c1 = packRGB565 (low);
+	bool swapped = (c0 < c1);
+	if (swapped)
+		std::swap (c0, c1); // c0 > c1 selects the 4 color mode
+	float palette[4][3];
+	unpackRGB565 (c0, palette[0]);
+	unpackRGB565 (c1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+		palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+	}
+	int numColors = (c0 == c1) ? 1 : 4; // Equal endpoints: 3 color mode, only the first entry is used
+	uint32_t indices = 0;
+	float error = 0.f;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		float bestDistance = 1e30f;
+		for (int k = 0; k < numColors; k++)
+		{
+			float distance = 0.f;
+			for (int c = 0; c < 3; c++)
+				distance += (block.texels[i][c] - palette[k][c]) * (block.texels[i][c] - palette[k][c]);
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = k;
+			}
+		}
+		indices |= uint32_t (best) << (2 * i);
+		error += bestDistance;
+		weights[i] = swapped ? BC1_WEIGHTS[best] : 1.f - BC1_WEIGHTS[best]; // From low to high
+	}
+	std::memcpy (out, &c0, 2);
+	std::memcpy (out + 2, &c1, 2);
+	std::memcpy (out + 4, &indices, 4);
+	return error;
+}
+
+void encodeBC1 (const Block & block, uint8_t * out)
+{
+	float low[4], high[4], weights[16];
+	fitEndpoints (block, 3, low, high);
+	float error = encodeBC1With (block, low, high, out, weights);
+	uint8_t refined[8];
+	if (error > 0.f && refitEndpoints (block, 3, weights, low, high) && encodeBC1With (block, low, high, refined, weights) < error)
+		std::memcpy (out, refined, 8);
+}
+
+// BC4 and BC5
+
+void encodeBC4 (const Block & block, int channel, uint8_t * out)
+{
+	float low = 255.f, high = 0.f;
+	for (int i = 0; i < 16; i++)
+	{
+		low = std::min (low, block.texels[i][channel]);
+		high = std::max (high, block.texels[i][channel]);
+	}
+	uint8_t e0 = static_cast<uint8_t> (std::lround (high));
+	uint8_t e1 = static_cast<uint8_t> (std::lround (low));
+	out[0] = e0;
+	out[1] = e1;
+	uint64_t indices = 0;
+	if (e0 > e1) // 8 value mode: index 0 is e0, 1 is e1, 2 to 7 interpolate from e0 to e1
+		for (int i = 0; i < 16; i++)
+		{
+			int k = static_cast<int> (std::lround ((block.texels[i][channel] - e1) * 7.f / (e0 - e1)));
+			k = std::clamp (k, 0, 7);
+			uint64_t index = (k == 7) ? 0 : (k == 0 ? 1 : 8 - k);
+			indices |= index << (3 * i);
+		}
+	for (int b = 0; b < 6; b++)
+		out[2 + b] = static_cast<uint8_t> (indices >> (8 * b));
+}
+
+// BC7, mode 6 only: a single subset with RGBA endpoints of 7 bits plus a p-bit each, and 16 interpolation steps
+
+const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/// Quantizes an endpoint to 7 bit channels and the p-bit, shared as their lowest bit, with the lowest error
+void quantizeBC7Endpoint (const float endpoint[4], uint8_t quantized[4], uint8_t & pBit)
+{
+	float bestError = 1e30f;
+	for (uint8_t p = 0; p < 2; p++)
+	{
+		uint8_t q[4];
+		float error = 0.f;
+		for (int c = 0; c < 4; c++)
+		{
+			q[c] = static_cast<uint8_t> (std::clamp (static_cast<int> (std::lround ((endpoint[c] - p) / 2.f)), 0, 127));
+			float value = float ((q[c] << 1) | p);
+			error += (value - endpoint[c]) * (value - endpoint[c]);
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			pBit = p;
+			std::memcpy (quantized, q, 4);
+		}
+	}
+}
+
+float encodeBC7With (const Block & block, const float low[4], const float high[4], uint8_t * out, float weights[16])
+{
+	uint8_t q[2][4], p[2];
+	quantizeBC7Endpoint (low, q[0], p[0]);
+	quantizeBC7Endpoint (high, q[1], p[1]);
+	int e[2][4];
+	for (int k = 0; k < 2; k++)
+		for (int c = 0; c < 4; c++)
+			e[k][c] = (q[k][c] << 1) | p[k];
+	float palette[16][4];
+	for (int s = 0; s < 16; s++)
+		for (int c = 0; c < 4; c++)
+			palette[s][c] = float (((64 - BC7_WEIGHTS4[s]) * e[0][c] + BC7_WEIGHTS4[s] * e[1][c] + 32) >> 6);
+
+	uint8_t indices[16];
+	float error = 0.f;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		float bestDistance = 1e30f;
+		for (int s = 0; s < 16; s++)
+		{
+			float distance = 0.f;
+			for (int c = 0; c < 4; c++)
+				distance += (block.texels[i][c] - palette[s][c]) * (block.texels[i][c] - palette[s][c]);
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = s;
+			}
+		}
+		indices[i] = static_cast<uint8_t> (best);
+		weights[i] = BC7_WEIGHTS4[best] / 64.f;
+		error += bestDistance;
+	}
+
+	// The highest bit of the first index is implicit and zero: swap the endpoints if needed
+	int first = 0;
+	if (indices[0] & 8)
+	{
+		first = 1;
+		for (int i = 0; i < 16; i++)
+			indices[i] = static_cast<uint8_t> (15 - indices[i]);
+	}
+	std::memset (out, 0, 16);
+	BitWriter writer (out);
+	writer.write (1 << 6, 7); // Mode 6
+	for (int c = 0; c < 4; c++)
+	{
+		writer.write (q[first][c], 7);
+		writer.write (q[1 - first][c], 7);
+	}
+	writer.write (p[first], 1);
+	writer.write (p[1 - first], 1);
+	writer.write (indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writer.write (indices[i], 4);
+	return error;
+}
+
+void encodeBC7 (const Block & block, uint8_t * out)
+{
+	float low[4], high[4], weights[16];
+	fitEndpoints (block, 4, low, high);
+	float error = encodeBC7With (block, low, high, out, weights);
+	uint8_t refined[16];
+	if (error > 0.f && refitEndpoints (block, 4, weights, low, high) && encodeBC7With (block, low, high, refined, weights) < error)
+		std::memcpy (out, refined, 16);
+}
+
+/// Compresses one level, rows of blocks being distributed among the threads
+std::vector<uint8_t> encodeLevel (const std::vector<uint8_t> & pixels, int width, int height, int numComponents, Format format, unsigned int numThreads)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t size = blockBytes (format);
+	std::vector<uint8_t> blocks (levelBytes (format, width, height));
+	std::atomic<int> nextRow (0);
+	auto worker = [&] () {
+		Block block;
+		for (int by = nextRow++; by < blocksY; by = nextRow++)
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				loadBlock (pixels, width, height, numComponents, bx, by, block);
+				uint8_t * out = &blocks[(size_t (by) * blocksX + bx) * size];
+				switch (format)
+				{
+				case BC1: encodeBC1 (block, out); break;
+				case BC4: encodeBC4 (block, 0, out); break;
+				case BC5: encodeBC4 (block, 0, out); encodeBC4 (block, 1, out + 8); break;
+				case BC7: encodeBC7 (block, out); break;
+				}
+			}
+	};
+	numThreads = std::max (1u, std::min (numThreads, static_cast<unsigned int> (blocksY)));
+	std::vector<std::thread> threads;
+	for (unsigned int k = 1; k < numThreads; k++)
+		threads.emplace_back (worker);
+	worker ();
+	for (auto & thread : threads)
+		thread.join ();
+	return blocks;
+}
+
+}
+
+size_t CompressedTexture::bytes () const
+{
+	size_t total = 0;
+	for (const auto & level : levels)
+		total += level.size ();
+	return total;
+}
+
+Format TextureCompressor::chooseFormat (int numComponents, bool preferBC1)
+{
+	if (numComponents == 1)
+		return BC4;
+	if (numComponents == 2)
+		return BC5;
+	return preferBC1 ? BC1 : BC7;
+}
+
+CompressedTexture TextureCompressor::compress (const uint8_t * pixels, int width, int height, int numComponents, Format format, unsigned int numThreads)
+{
+	if (pixels == nullptr || width <= 0 || height <= 0 || numComponents < 1 || numComponents > 4)
+		throw std::runtime_error ("[Texture Compressor][compress] Invalid image");
+	if (numThreads == 0)
+		numThreads = std::max (std::thread::hardware_concurrency (), 1u);
+
+	CompressedTexture texture;
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	std::vector<uint8_t> level (pixels, pixels + size_t (width) * height * numComponents);
+	for (int levelWidth = width, levelHeight = height; ; )
+	{
+		texture.levels.push_back (encodeLevel (level, levelWidth, levelHeight, numComponents, format, numThreads));
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		level = downsample (level, levelWidth, levelHeight, numComponents);
+	}
+	return texture;
+}
+
+CompressedTexture TextureCompressor::compress (const std::vector<std::vector<uint8_t>> & levels, int width, int height, int numComponents,
+											  Format format, unsigned int numThreads)
+{
+	if (levels.empty () || width <= 0 || height <= 0 || numComponents < 1 || numComponents > 4)
+		throw std::runtime_error ("[Texture Compressor][compress] Invalid image");
+	if (numThreads == 0)
+		numThreads = std::max (std::thread::hardware_concurrency (), 1u);
+
+	CompressedTexture texture;
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	for (int levelWidth = width, levelHeight = height; ; levelWidth = std::max (1, levelWidth / 2), levelHeight = std::max (1, levelHeight / 2))
+	{
+		size_t level = texture.levels.size ();
+		if (level == levels.size () || levels[level].size () != size_t (levelWidth) * levelHeight * numComponents)
+			throw std::runtime_error ("[Texture Compressor][compress] Invalid mip level " + std::to_string (level));
+		texture.levels.push_back (encodeLevel (levels[level], levelWidth, levelHeight, numComponents, format, numThreads));
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+	}
+	return texture;
+}
+
+void TextureCompressor::save (const std::string & filename, const CompressedTexture & texture)
+{
+	KTXHeader header = {};
+	header.endianness = KTX_ENDIANNESS;
+	header.glTypeSize = 1;
+	header.glInternalFormat = texture.format;
+	header.glBaseInternalFormat = baseInternalFormat (texture.format);
+	header.pixelWidth = static_cast<uint32_t> (texture.width);
+	header.pixelHeight = static_cast<uint32_t> (texture.height);
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = static_cast<uint32_t> (texture.levels.size ());
+
+	// Written to a temporary file first so that a crash never leaves a truncated texture behind.
+	// Block sizes are multiples of 4 bytes: the levels need no padding.
+	std::string tmpFilename = filename + ".tmp";
+	{
+		std::ofstream out (tmpFilename, std::ios::binary | std::ios::trunc);
+		if (!out)
+			throw std::ios_base::failure ("[Texture Compressor][save] Cannot open " + tmpFilename);
+		out.write (reinterpret_cast<const char *> (KTX_IDENTIFIER), sizeof (KTX_IDENTIFIER));
+		out.write (reinterpret_cast<const char *> (&header), sizeof (KTXHeader));
+		for (const auto & level : texture.levels)
+		{
+			uint32_t imageSize = static_cast<uint32_t> (level.size ());
+			out.write (reinterpret_cast<const char *> (&imageSize), sizeof (uint32_t));
+			out.write (reinterpret_cast<const char *> (level.data ()), level.size ());
+		}
+		if (!out)
+		{
+			out.close ();
+			std::remove (tmpFilename.c_str ());
+			throw std::ios_base::failure ("[Texture Compressor][save] Cannot write " + tmpFilename);
+		}
+	}
+	if (std::rename (tmpFilename.c_str (), filename.c_str ()) != 0)
+	{
+		std::remove (tmpFilename.c_str ());
+		throw std::ios_base::failure ("[Texture Compressor][save] Cannot rename " + tmpFilename + " to " + filename);
+	}
+}
+
+CompressedTexture TextureCompressor::load (const std::string & filename)
+{
+	std::ifstream in (filename, std::ios::binary);
+	if (!in)
+		throw std::ios_base::failure ("[Texture Compressor][load] Cannot open " + filename);
+	uint8_t identifier[sizeof (KTX_IDENTIFIER)];
+	KTXHeader header;
+	in.read (reinterpret_cast<char *> (identifier), sizeof (identifier));
+	in.read (reinterpret_cast<char *> (&header), sizeof (KTXHeader));
+	if (!in || std::memcmp (identifier, KTX_IDENTIFIER, sizeof (KTX_IDENTIFIER)) != 0)
+		throw std::ios_base::failure ("[Texture Compressor][load] Not a KTX 1.1 file: " + filename);
+	Format format = static_cast<Format> (header.glInternalFormat);
+	if (header.endianness != KTX_ENDIANNESS || header.glType != 0
+		|| (format != BC1 && format != BC4 && format != BC5 && format != BC7)
+		|| header.pixelWidth == 0 || header.pixelWidth > 65536 || header.pixelHeight == 0 || header.pixelHeight > 65536
+		|| header.pixelDepth != 0 || header.numberOfArrayElements != 0 || header.numberOfFaces != 1
+		|| header.numberOfMipmapLevels == 0 || header.numberOfMipmapLevels > 17)
+		throw std::ios_base::failure ("[Texture Compressor][load] Unsupported KTX texture in " + filename);
+	in.seekg (header.bytesOfKeyValueData, std::ios::cur);
+
+	CompressedTexture texture;
+	texture.format = format;
+	texture.width = static_cast<int> (header.pixelWidth);
+	texture.height = static_cast<int> (header.pixelHeight);
+	texture.levels.resize (header.numberOfMipmapLevels);
+	for (uint32_t l = 0; l < header.numberOfMipmapLevels; l++)
+	{
+		uint32_t imageSize = 0;
+		in.read (reinterpret_cast<char *> (&imageSize), sizeof (uint32_t));
+		int levelWidth = std::max (1, texture.width >> l), levelHeight = std::max (1, texture.height >> l);
+		if (!in || imageSize != levelBytes (format, levelWidth, levelHeight))
+			throw std::ios_base::failure ("[Texture Compressor][load] Corrupted level in " + filename);
+		texture.levels[l].resize (imageSize);
+		in.read (reinterpret_cast<char *> (texture.levels[l].data ()), imageSize);
+		if (!in)
+			throw std::ios_base::failure ("[Texture Compressor][load] Truncated level in " + filename);
+	}
+	return texture;
+}
+
+std::string TextureCompressor::compressedFilename (const std::string & imageFilename)
+{
+	return std::filesystem::path (imageFilename).replace_extension (".ktx").string ();
+}
+
+bool TextureCompressor::hasUpToDateCompressedVersion (const std::string & imageFilename, const std::vector<std::string> & sourceFilenames)
+{
+	std::error_code error;
+	auto compressedTime = std::filesystem::last_write_time (compressedFilename (imageFilename), error);
+	if (error)
+		return false;
+	// Compressed textures also work without their source
+	auto imageTime = std::filesystem::last_write_time (imageFilename, error);
+	if (!error && imageTime > compressedTime)
+		return false;
+	for (const std::string & source : sourceFilenames)
+	{
+		auto sourceTime = std::filesystem::last_write_time (source, error);
+		if (!error && sourceTime > compressedTime)
+			return false;
+	}
+	return true;
+}
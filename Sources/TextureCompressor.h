@@ -0,0 +1,60 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/// Offline block compression of 8 bit images (BC1, BC4, BC5 and BC7), with their whole mip chain,
+/// stored in KTX 1.1 files. The GPU samples these formats directly: a compressed texture is
+/// uploaded as is, without decoding nor glGenerateMipmap, and takes 4 to 8 times less video memory.
+namespace TextureCompressor {
+
+/// Block formats, valued with their GL internal format
+enum Format : uint32_t {
+	BC1 = 0x83F0, ///< GL_COMPRESSED_RGB_S3TC_DXT1_EXT: RGB, 4 bits per texel
+	BC4 = 0x8DBB, ///< GL_COMPRESSED_RED_RGTC1: one channel, 4 bits per texel
+	BC5 = 0x8DBD, ///< GL_COMPRESSED_RG_RGTC2: two channels, 8 bits per texel
+	BC7 = 0x8E8C  ///< GL_COMPRESSED_RGBA_BPTC_UNORM: RGBA, 8 bits per texel
+};
+
+/// Compressed texture: one array of 4x4 blocks per mip level, from the full resolution down to 1x1
+struct CompressedTexture {
+	Format format = BC7;
+	int width = 0;
+	int height = 0;
+	std::vector<std::vector<uint8_t>> levels;
+
+	/// Total size of the levels in bytes
+	size_t bytes () const;
+};
+
+/// Format matching the channels of an image: BC4 for one, BC5 for two, and BC7 for more, or BC1
+/// when preferBC1 is set (half the size of BC7, no alpha and a lower quality)
+Format chooseFormat (int numComponents, bool preferBC1 = false);
+
+/// Builds the mip chain of the image (8 bits per channel, numComponents interleaved channels) and
+/// compresses every level, with numThreads threads (0 means one per core)
+CompressedTexture compress (const uint8_t * pixels, int width, int height, int numComponents, Format format, unsigned int numThreads = 0);
+
+/// Same with a mip chain computed by the caller, levels[l] holding the 8 bit pixels of level l down to
+/// 1x1, e.g. the renormalized levels of a normal map (see loadNormalMap)
+CompressedTexture compress (const std::vector<std::vector<uint8_t>> & levels, int width, int height, int numComponents, Format format,
+							unsigned int numThreads = 0);
+
+/// Writes a KTX 1.1 file
+void save (const std::string & filename, const CompressedTexture & texture);
+
+/// Reads a KTX 1.1 file written by save
+CompressedTexture load (const std::string & filename);
+
+/// Name of the compressed version of an image file: the same name with a .ktx extension
+std::string compressedFilename (const std::string & imageFilename);
+
+/// True if the compressed version of imageFilename exists and is not older than the image, nor
+/// than any of the sources the image is made from, if any
+bool hasUpToDateCompressedVersion (const std::string & imageFilename, const std::vector<std::string> & sourceFilenames = {});
+
+}
+
+#endif // TEXTURE_COMPRESSOR_H
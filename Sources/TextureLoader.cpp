@@ -0,0 +1,304 @@
+#include "TextureLoader.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+
+TextureImage::TextureImage (const std::string & filename, bool asFloat, bool useCompressed)
+	: m_filename (filename), m_isFloat (asFloat)
+{
+	if (useCompressed && TextureCompressor::hasUpToDateCompressedVersion (filename))
+	{
+		try
+		{
+			m_compressed = TextureCompressor::load (TextureCompressor::compressedFilename (filename));
+			m_width = m_compressed.width;
+			m_height = m_compressed.height;
+			return;
+		}
+		catch (std::exception & e) // The image itself is still there
+		{
+			std::cerr << "> [Error loading texture]" << e.what () << std::endl;
+		}
+	}
+
+	// Besides its flags, left untouched here, stb_image only keeps a global failure string that is never read:
+	// decoding runs concurrently
+	if (asFloat)
+		m_data = stbi_loadf (filename.c_str (), &m_width, &m_height, &m_numComponents, 0);
+	else
+		m_data = stbi_load (filename.c_str (), &m_width, &m_height, &m_numComponents, 0);
+	if (m_data == nullptr)
+	{
+		m_width = m_height = m_numComponents = 0;
+		std::cerr << "> [Error loading texture] " << filename << " could not be decoded" << std::endl;
+	}
+}
+
+TextureImage::TextureImage (const std::string & filename, int width, int height, int numComponents, std::vector<uint8_t> && pixels)
+	: m_filename (filename), m_width (width), m_height (height), m_numComponents (numComponents)
+{
+	if (pixels.size () != size_t (width) * height * numComponents || pixels.empty ())
+		throw std::runtime_error ("[Texture Loader][TextureImage] Pixels do not match the size of " + filename);
+	m_levels.push_back (std::move (pixels));
+}
+
+TextureImage::TextureImage (const std::string & filename, int width, int height, int numComponents, int bytesPerChannel,
+							std::vector<std::vector<uint8_t>> && levels)
+	: m_filename (filename), m_width (width), m_height (height), m_numComponents (numComponents), m_bytesPerChannel (bytesPerChannel),
+	  m_levels (std::move (levels))
+{
+	bool isValid = !m_levels.empty () && (bytesPerChannel == 1 || bytesPerChannel == 2);
+	for (int level = 0, w = width, h = height; isValid && level < static_cast<int> (m_levels.size ()); level++, w = std::max (1, w / 2), h = std::max (1, h / 2))
+		isValid = m_levels[level].size () == size_t (w) * h * numComponents * bytesPerChannel
+				  && ((level + 1 == static_cast<int> (m_levels.size ())) == (w == 1 && h == 1));
+	if (!isValid)
+		throw std::runtime_error ("[Texture Loader][TextureImage] Mip levels do not match the size of " + filename);
+}
+
+TextureImage::TextureImage (const std::string & filename, TextureCompressor::CompressedTexture && compressed)
+	: m_filename (filename), m_width (compressed.width), m_height (compressed.height), m_compressed (std::move (compressed))
+{
+	if (m_compressed.levels.empty ())
+		throw std::runtime_error ("[Texture Loader][TextureImage] No mip level in the compressed version of " + filename);
+}
+
+TextureImage::TextureImage (const std::string & filename) : m_filename (filename) {}
+
+TextureImage::~TextureImage ()
+{
+	if (m_data != nullptr)
+		stbi_image_free (m_data);
+}
+
+std::unique_ptr<TextureImage> packChannels (const std::string & filename, const std::vector<std::string> & sources,
+											const std::vector<uint8_t> & defaults, bool useCompressed)
+{
+	if (sources.empty () || sources.size () > 4 || defaults.size () != sources.size ())
+		throw std::runtime_error ("[Texture Loader][packChannels] Invalid channels for " + filename);
+	if (useCompressed && TextureCompressor::hasUpToDateCompressedVersion (filename, sources))
+	{
+		// Read directly: the packed image only exists as its compressed version, there is no file to fall back on
+		try
+		{
+			return std::make_unique<TextureImage> (filename, TextureCompressor::load (TextureCompressor::compressedFilename (filename)));
+		}
+		catch (std::exception & e) // Packed again from the sources
+		{
+			std::cerr << "> [Error loading texture]" << e.what () << std::endl;
+		}
+	}
+
+	std::vector<std::unique_ptr<TextureImage>> channels;
+	int width = 1, height = 1;
+	for (const std::string & source : sources)
+	{
+		std::error_code error;
+		channels.push_back (std::filesystem::exists (source, error) ? std::make_unique<TextureImage> (source, false, false) : nullptr);
+		if (channels.back () && !channels.back ()->isEmpty ())
+		{
+			width = std::max (width, channels.back ()->width ());
+			height = std::max (height, channels.back ()->height ());
+		}
+	}
+
+	size_t numChannels = sources.size ();
+	std::vector<uint8_t> pixels (size_t (width) * height * numChannels);
+	for (size_t c = 0; c < numChannels; c++)
+	{
+		const TextureImage * channel = channels[c].get ();
+		if (channel == nullptr || channel->isEmpty ())
+		{
+			for (size_t i = c; i < pixels.size (); i += numChannels)
+				pixels[i] = defaults[c];
+			continue;
+		}
+		const uint8_t * data = static_cast<const uint8_t *> (channel->data ());
+		for (int y = 0; y < height; y++)
+		{
+			int sy = int (int64_t (y) * channel->height () / height);
+			for (int x = 0; x < width; x++)
+			{
+				int sx = int (int64_t (x) * channel->width () / width); // Nearest texel
+				pixels[(size_t (y) * width + x) * numChannels + c] = data[(size_t (sy) * channel->width () + sx) * channel->numComponents ()];
+			}
+		}
+	}
+	return std::make_unique<TextureImage> (filename, width, height, static_cast<int> (numChannels), std::move (pixels));
+}
+
+namespace {
+
+/// Unit normals of a normal map level, 3 floats per texel
+typedef std::vector<float> NormalLevel;
+
+/// Normals encoded as unsigned normalized values in the first two channels of the texels, Z being rebuilt
+template<typename T>
+NormalLevel decodeNormals (const T * texels, int width, int height, int numComponents)
+{
+	const float maxValue = float (std::numeric_limits<T>::max ());
+	NormalLevel normals (size_t (width) * height * 3);
+	for (size_t i = 0; i < size_t (width) * height; i++)
+	{
+		float x = 2.f * texels[i * numComponents] / maxValue - 1.f;
+		float y = 2.f * texels[i * numComponents + 1] / maxValue - 1.f;
+		float z = std::sqrt (std::max (0.f, 1.f - x * x - y * y));
+		float length = std::sqrt (x * x + y * y + z * z); // Above 1 when x^2 + y^2 > 1
+		normals[3 * i] = x / length;
+		normals[3 * i + 1] = y / length;
+		normals[3 * i + 2] = z / length;
+	}
+	return normals;
+}
+
+/// Halves a level with a box filter on the normals, the last row or column being repeated when the size is odd,
+/// and renormalizes them. Opposite normals cancel out to a flat one.
+NormalLevel downsampleNormals (const NormalLevel & normals, int & width, int & height)
+{
+	int halfWidth = std::max (1, width / 2);
+	int halfHeight = std::max (1, height / 2);
+	NormalLevel half (size_t (halfWidth) * halfHeight * 3);
+	for (int y = 0; y < halfHeight; y++)
+		for (int x = 0; x < halfWidth; x++)
+		{
+			int x0 = std::min (2 * x, width - 1), x1 = std::min (2 * x + 1, width - 1);
+			int y0 = std::min (2 * y, height - 1), y1 = std::min (2 * y + 1, height - 1);
+			float sum[3];
+			for (int c = 0; c < 3; c++)
+				sum[c] = normals[(size_t (y0) * width + x0) * 3 + c] + normals[(size_t (y0) * width + x1) * 3 + c]
+					   + normals[(size_t (y1) * width + x0) * 3 + c] + normals[(size_t (y1) * width + x1) * 3 + c];
+			float length = std::sqrt (sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+			float * normal = &half[(size_t (y) * halfWidth + x) * 3];
+			if (length < 1e-6f)
+				normal[0] = normal[1] = 0.f, normal[2] = 1.f;
+			else
+				for (int c = 0; c < 3; c++)
+					normal[c] = sum[c] / length;
+		}
+	width = halfWidth;
+	height = halfHeight;
+	return half;
+}
+
+/// X and Y of the normals as unsigned normalized T, in the byte order of the machine as GL expects
+template<typename T>
+std::vector<uint8_t> encodeNormals (const NormalLevel & normals)
+{
+	const float maxValue = float (std::numeric_limits<T>::max ());
+	size_t numTexels = normals.size () / 3;
+	std::vector<uint8_t> level (numTexels * 2 * sizeof (T));
+	T * texels = reinterpret_cast<T *> (level.data ());
+	for (size_t i = 0; i < numTexels; i++)
+		for (int c = 0; c < 2; c++)
+			texels[2 * i + c] = static_cast<T> (std::lround ((normals[3 * i + c] * 0.5f + 0.5f) * maxValue));
+	return level;
+}
+
+template<typename T>
+std::vector<std::vector<uint8_t>> normalMipChain (const T * texels, int width, int height, int numComponents)
+{
+	std::vector<std::vector<uint8_t>> levels;
+	NormalLevel normals = decodeNormals (texels, width, height, numComponents);
+	for (int w = width, h = height; ; )
+	{
+		levels.push_back (encodeNormals<T> (normals));
+		if (w == 1 && h == 1)
+			break;
+		normals = downsampleNormals (normals, w, h);
+	}
+	return levels;
+}
+
+}
+
+std::unique_ptr<TextureImage> loadNormalMap (const std::string & filename, bool useCompressed)
+{
+	if (useCompressed && TextureCompressor::hasUpToDateCompressedVersion (filename))
+	{
+		auto compressed = std::make_unique<TextureImage> (filename, false);
+		if (compressed->isCompressed ())
+			return compressed;
+	}
+
+	int width, height, numComponents;
+	bool is16Bit = stbi_is_16_bit (filename.c_str ()) != 0;
+	void * data = is16Bit ? static_cast<void *> (stbi_load_16 (filename.c_str (), &width, &height, &numComponents, 0))
+						  : static_cast<void *> (stbi_load (filename.c_str (), &width, &height, &numComponents, 0));
+	if (data == nullptr || numComponents < 3) // Grey levels, with or without alpha, are no normals
+	{
+		if (data != nullptr)
+			stbi_image_free (data);
+		std::cerr << "> [Error loading texture] " << filename << " could not be decoded as a normal map" << std::endl;
+		return std::make_unique<TextureImage> (filename);
+	}
+	std::vector<std::vector<uint8_t>> levels = is16Bit ? normalMipChain (static_cast<const uint16_t *> (data), width, height, numComponents)
+													   : normalMipChain (static_cast<const uint8_t *> (data), width, height, numComponents);
+	stbi_image_free (data);
+	return std::make_unique<TextureImage> (filename, width, height, 2, is16Bit ? 2 : 1, std::move (levels));
+}
+
+std::unique_ptr<TextureImage> AsyncTextureLoader::load (const Request & request)
+{
+	if (!request.channelSources.empty ())
+		return packChannels (request.filename, request.channelSources, request.defaults);
+	std::unique_ptr<TextureImage> image = request.isNormalMap ? loadNormalMap (request.filename)
+															  : std::make_unique<TextureImage> (request.filename, false);
+	if (image->isEmpty () && !request.defaults.empty ())
+		image = std::make_unique<TextureImage> (request.filename, 1, 1, static_cast<int> (request.defaults.size ()),
+												std::vector<uint8_t> (request.defaults));
+	return image;
+}
+
+AsyncTextureLoader::AsyncTextureLoader (const std::vector<Request> & requests, unsigned int numThreads)
+	: m_requests (requests), m_images (requests.size ()), m_errors (requests.size ()), m_next (0), m_numDone (0)
+{
+	if (numThreads == 0)
+		numThreads = std::max (1u, std::thread::hardware_concurrency ());
+	numThreads = static_cast<unsigned int> (std::min<size_t> (numThreads, m_requests.size ()));
+	// Files are handed out one at a time: their decoding times differ by orders of magnitude
+	for (unsigned int t = 0; t < numThreads; t++)
+		m_threads.emplace_back ([this] () {
+			for (size_t i = m_next++; i < m_requests.size (); i = m_next++)
+			{
+				try
+				{
+					m_images[i] = load (m_requests[i]);
+				}
+				catch (...)
+				{
+					m_errors[i] = std::current_exception ();
+				}
+				m_numDone.fetch_add (1, std::memory_order_release);
+			}
+		});
+}
+
+AsyncTextureLoader::~AsyncTextureLoader ()
+{
+	join ();
+}
+
+void AsyncTextureLoader::join ()
+{
+	for (std::thread & thread : m_threads)
+		if (thread.joinable ())
+			thread.join ();
+}
+
+std::vector<std::unique_ptr<TextureImage>> AsyncTextureLoader::takeImages ()
+{
+	join ();
+	for (const std::exception_ptr & error : m_errors)
+		if (error)
+			std::rethrow_exception (error);
+	return std::move (m_images);
+}
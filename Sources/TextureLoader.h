@@ -0,0 +1,135 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+
+#include "TextureCompressor.h"
+
+/// Pixels of an image file decoded on the CPU, kept until they are uploaded to the GPU.
+/// Decoding touches no GL state, so it can run on any thread.
+class TextureImage {
+public:
+	/// Decodes filename, as 32 bit floats if asFloat, else as 8 bit channels. If useCompressed and an
+	/// up to date compressed version of the file exists (see TextureCompressor), its blocks are read
+	/// instead. A file that cannot be decoded leaves the image empty (see isEmpty) rather than
+	/// throwing: materials miss some maps.
+	TextureImage (const std::string & filename, bool asFloat, bool useCompressed = true);
+
+	/// Image made of the given 8 bit pixels, named filename without being read from it
+	TextureImage (const std::string & filename, int width, int height, int numComponents, std::vector<uint8_t> && pixels);
+
+	/// Image made of its whole mip chain, levels[l] holding the interleaved channels of level l, of
+	/// bytesPerChannel bytes each (1 or 2, unsigned normalized), down to 1x1
+	TextureImage (const std::string & filename, int width, int height, int numComponents, int bytesPerChannel,
+				  std::vector<std::vector<uint8_t>> && levels);
+
+	/// Image holding the blocks of a compressed texture, named filename without decoding it
+	TextureImage (const std::string & filename, TextureCompressor::CompressedTexture && compressed);
+
+	/// Empty image named filename
+	explicit TextureImage (const std::string & filename);
+
+	virtual ~TextureImage ();
+
+	TextureImage (const TextureImage &) = delete;
+	TextureImage & operator= (const TextureImage &) = delete;
+
+	inline const std::string & filename () const { return m_filename; }
+	inline bool isEmpty () const { return m_data == nullptr && m_levels.empty () && !isCompressed (); }
+	inline bool isCompressed () const { return !m_compressed.levels.empty (); }
+	inline bool isFloat () const { return m_isFloat; }
+	inline int width () const { return m_width; }
+	inline int height () const { return m_height; }
+	inline int numComponents () const { return m_numComponents; }
+	inline int bytesPerChannel () const { return m_isFloat ? 4 : m_bytesPerChannel; }
+	inline const void * data () const { return m_levels.empty () ? m_data : m_levels[0].data (); }
+
+	/// Number of mip levels held by the image: 1 unless they were given to the constructor,
+	/// the others being left to glGenerateMipmap
+	inline int numLevels () const { return m_levels.empty () ? 1 : static_cast<int> (m_levels.size ()); }
+
+	/// Pixels of a mip level, level 0 being data ()
+	inline const void * levelData (int level) const { return level == 0 ? data () : m_levels[level].data (); }
+
+	/// Blocks and mip levels of the compressed version, only valid if isCompressed
+	inline const TextureCompressor::CompressedTexture & compressed () const { return m_compressed; }
+
+private:
+	std::string m_filename;
+	bool m_isFloat = false;
+	int m_width = 0;
+	int m_height = 0;
+	int m_numComponents = 0;
+	int m_bytesPerChannel = 1;
+	void * m_data = nullptr; // Decoded by stb_image
+	std::vector<std::vector<uint8_t>> m_levels; // Given to the constructor
+	TextureCompressor::CompressedTexture m_compressed;
+};
+
+/// Packs the first channel of each source file in a channel of an 8 bit image named filename,
+/// e.g. the occlusion, roughness and metallic maps of a material in a single texture fetched once.
+/// A missing source fills its channel with its default value, and sources smaller than the largest
+/// one are resampled. The packed image has no file of its own, but if useCompressed and its
+/// compressed version (written by BaseGLTool) is newer than the sources, it is read instead.
+std::unique_ptr<TextureImage> packChannels (const std::string & filename, const std::vector<std::string> & sources,
+											const std::vector<uint8_t> & defaults, bool useCompressed = true);
+
+/// Loads a tangent-space normal map as a two channel image, X and Y in R and G, Z being rebuilt by
+/// the shader as sqrt (1 - x^2 - y^2): 2 bytes per texel (RG8), or 4 (RG16) when the file has 16 bit
+/// channels, instead of 16 for RGBA32F. The whole mip chain is computed here, each level averaging
+/// the unit normals of the previous one and renormalizing them: averaging the encoded values, as
+/// glGenerateMipmap does, shortens the normals and flattens the relief in the distance. If
+/// useCompressed and an up to date compressed version (BC5, written by BaseGLTool) exists, it is read
+/// instead. A file that cannot be decoded, or with less than three channels, gives an empty image.
+std::unique_ptr<TextureImage> loadNormalMap (const std::string & filename, bool useCompressed = true);
+
+/// Decodes a set of image files concurrently on a pool of worker threads, typically all the maps
+/// of a material. The GL upload of the resulting images is left to the thread owning the context.
+class AsyncTextureLoader {
+public:
+	struct Request {
+		std::string filename;
+		/// Loaded with loadNormalMap
+		bool isNormalMap = false;
+		/// When not empty, the image is packed from these files (see packChannels)
+		std::vector<std::string> channelSources;
+		/// Values of the channels of missing sources, or of a 1x1 image replacing a file that cannot be decoded
+		std::vector<uint8_t> defaults;
+	};
+
+	/// Decodes a request on the calling thread, as the workers do
+	static std::unique_ptr<TextureImage> load (const Request & request);
+
+	/// Starts decoding the requested files with numThreads workers (0 means one per core, at most one per file)
+	AsyncTextureLoader (const std::vector<Request> & requests, unsigned int numThreads = 0);
+
+	/// Waits for the workers, the images are discarded if they were not taken
+	virtual ~AsyncTextureLoader ();
+
+	AsyncTextureLoader (const AsyncTextureLoader &) = delete;
+	AsyncTextureLoader & operator= (const AsyncTextureLoader &) = delete;
+
+	/// True once every file is decoded
+	inline bool isReady () const { return m_numDone.load (std::memory_order_acquire) == m_requests.size (); }
+
+	/// Waits for the workers and returns the images in the order of the requests, or rethrows the first error
+	std::vector<std::unique_ptr<TextureImage>> takeImages ();
+
+private:
+	void join ();
+
+	std::vector<Request> m_requests;
+	std::vector<std::unique_ptr<TextureImage>> m_images;
+	std::vector<std::exception_ptr> m_errors;
+	std::atomic<size_t> m_next;
+	std::atomic<size_t> m_numDone;
+	std::vector<std::thread> m_threads;
+};
+
+#endif // TEXTURE_LOADER_H
@@ -0,0 +1,421 @@
+// Command line front end of the geometry core: runs chains of processing operations on mesh files
+// without any window or GL context, one mesh per core when given a directory. Also compresses
+// material textures offline.
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <ios>
+#include <filesystem>
+#include <limits>
+
+#include "Mesh.h"
+#include "MeshLoader.h"
+#include "MeshArchive.h"
+#include "OutOfCoreSimplifier.h"
+#include "TextureLoader.h"
+#include "TextureCompressor.h"
+#include "Material.h"
+#include "Profiler.h"
+#include "CommandLine.h"
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+/// A processing step of the chain, with its numeric parameter when it takes one
+struct Operation {
+	enum Type { NORMALS, LAPLACIAN, SIMPLIFY, ADAPTIVE_SIMPLIFY, SUBDIVIDE } type;
+	float parameter = 0.f;
+};
+
+/// Quantization of the .qmesh outputs (see MeshArchive::save)
+struct ArchiveBits {
+	unsigned int position = 16;
+	unsigned int normal = 12;
+};
+
+void usage (const char * command)
+{
+	std::cerr << "Usage : " << command << " [--threads <n>] [--format off|qmesh] [--position-bits <n>] [--normal-bits <n>] [--trace <trace.json>]" << std::endl
+			  << "       " << std::string (std::string (command).size (), ' ') << " <input> <output> [<operation> ...]" << std::endl
+			  << "  <input>  mesh file (.off, .ply, .obj, .qmesh) or directory of mesh files" << std::endl
+			  << "  <output> mesh file (.off, .qmesh), or directory when <input> is a directory" << std::endl
+			  << "  --position-bits and --normal-bits quantize the .qmesh outputs: bits per coordinate (1 to 24, 16 by default)" << std::endl
+			  << "  and per octahedral normal component (2 to 16, 12 by default)" << std::endl
+			  << "  --trace writes the CPU time of the loading, the operations and the saving of each file as a Chrome trace" << std::endl
+			  << "Operations, applied in order:" << std::endl
+			  << "  normals               recompute the angle-weighted normals and the tangent frames" << std::endl
+			  << "  laplacian[:<alpha>]   Laplacian filter with cotangent weights (alpha 0.5 by default)" << std::endl
+			  << "  simplify:<resolution> vertex clustering on a uniform grid" << std::endl
+			  << "  adaptive:<vertices>   vertex clustering on an octree, at most <vertices> per leaf" << std::endl
+			  << "  subdivide             one step of midpoint subdivision" << std::endl
+			  << "       " << command << " --simplify-out-of-core <input.off|input.bmesh> <output.off> [<resolution> [<memory MB>]]" << std::endl
+			  << "  Simplifies a mesh too large for memory by streaming it through a grid of <resolution> cells along its" << std::endl
+			  << "  longest side (256 by default), within <memory MB> of buffers and cluster tables (512 by default)." << std::endl
+			  << "       " << command << " --compress-textures [--threads <n>] [--bc1] [--force] <image or directory> ..." << std::endl
+			  << "  Writes the block-compressed version (.ktx, with mipmaps) of every image next to it, used instead" << std::endl
+			  << "  of the image at runtime: BC4 for one channel, BC5 for two, BC7 for more (BC1 with --bc1)." << std::endl
+			  << "  Directories are searched recursively, up to date .ktx files are skipped unless --force." << std::endl
+			  << "  Occlusion, roughness and metallic maps get no .ktx of their own: they are packed in RGB into the ORM.ktx" << std::endl
+			  << "  of their material directory, the only one read at runtime." << std::endl
+			  << "  Normal maps (Normal.png) keep X and Y only, in BC5, with renormalized mipmaps." << std::endl;
+	std::exit (EXIT_FAILURE);
+}
+
+/// Value of a numeric option, printing the usage when it is not a positive integer up to max
+unsigned int parseOption (const std::string & argument, const std::string & name, unsigned long long max, const char * command)
+{
+	try
+	{
+		return static_cast<unsigned int> (parsePositive (argument, name, max));
+	}
+	catch (std::invalid_argument & e)
+	{
+		std::cerr << "> [Error]" << e.what () << std::endl;
+		usage (command);
+		return 0;
+	}
+}
+
+/// Value of --threads
+unsigned int parseThreads (const std::string & argument, const char * command)
+{
+	return parseOption (argument, "number of threads", std::numeric_limits<int>::max (), command);
+}
+
+Operation parseOperation (const std::string & argument)
+{
+	size_t colon = argument.find (':');
+	std::string name = argument.substr (0, colon);
+	bool hasParameter = (colon != std::string::npos);
+	Operation operation;
+	if (hasParameter)
+		operation.parameter = std::stof (argument.substr (colon + 1));
+	if (name == "normals" && !hasParameter)
+		operation.type = Operation::NORMALS;
+	else if (name == "laplacian")
+	{
+		operation.type = Operation::LAPLACIAN;
+		if (!hasParameter)
+			operation.parameter = 0.5f;
+	}
+	else if (name == "simplify" && hasParameter && operation.parameter >= 1.f)
+		operation.type = Operation::SIMPLIFY;
+	else if (name == "adaptive" && hasParameter && operation.parameter >= 1.f)
+		operation.type = Operation::ADAPTIVE_SIMPLIFY;
+	else if (name == "subdivide" && !hasParameter)
+		operation.type = Operation::SUBDIVIDE;
+	else
+		throw std::invalid_argument ("Invalid operation " + argument);
+	return operation;
+}
+
+void applyOperation (const Operation & operation, std::shared_ptr<Mesh> meshPtr)
+{
+	switch (operation.type)
+	{
+	case Operation::NORMALS: meshPtr->recomputePerVertexNormals (true); break;
+	case Operation::LAPLACIAN: meshPtr->laplacianFilter (operation.parameter, true); break;
+	case Operation::SIMPLIFY: meshPtr->simplify (static_cast<unsigned int> (operation.parameter)); break;
+	case Operation::ADAPTIVE_SIMPLIFY: meshPtr->adaptiveSimplify (static_cast<unsigned int> (operation.parameter)); break;
+	case Operation::SUBDIVIDE: meshPtr->subdivide (); break;
+	}
+}
+
+/// Loads input, runs the chain and writes output. numThreads is left to the parallel loaders.
+void processFile (const std::string & input, const std::string & output, const std::vector<Operation> & operations,
+				  const ArchiveBits & archiveBits, unsigned int numThreads)
+{
+	PROFILE_ZONE ("processFile");
+	auto meshPtr = std::make_shared<Mesh> ();
+	MeshLoader::load (input, meshPtr, numThreads);
+	for (const Operation & operation : operations)
+		applyOperation (operation, meshPtr);
+	PROFILE_ZONE ("MeshLoader::save");
+	std::string extension = fs::path (output).extension ().string ();
+	std::transform (extension.begin (), extension.end (), extension.begin (), [] (unsigned char c) { return std::tolower (c); });
+	if (extension == ".qmesh")
+		MeshArchive::save (output, meshPtr, archiveBits.position, archiveBits.normal);
+	else
+		MeshLoader::save (output, meshPtr);
+}
+
+bool isMeshFile (const fs::path & path)
+{
+	std::string extension = path.extension ().string ();
+	std::transform (extension.begin (), extension.end (), extension.begin (), [] (unsigned char c) { return std::tolower (c); });
+	return extension == ".off" || extension == ".ply" || extension == ".obj" || extension == ".qmesh";
+}
+
+/// Processes every mesh file of inputDirectory into outputDirectory, one mesh per thread.
+/// Returns the number of files which failed.
+size_t processDirectory (const fs::path & inputDirectory, const fs::path & outputDirectory, const std::string & format,
+						 const std::vector<Operation> & operations, const ArchiveBits & archiveBits, unsigned int numThreads)
+{
+	std::vector<fs::path> inputs;
+	for (const auto & entry : fs::directory_iterator (inputDirectory))
+		if (entry.is_regular_file () && isMeshFile (entry.path ()))
+			inputs.push_back (entry.path ());
+	std::sort (inputs.begin (), inputs.end ());
+	fs::create_directories (outputDirectory);
+
+	std::atomic<size_t> nextInput (0);
+	std::atomic<size_t> numFailures (0);
+	std::mutex logMutex;
+	auto worker = [&] () {
+		for (size_t i = nextInput++; i < inputs.size (); i = nextInput++)
+		{
+			fs::path output = outputDirectory / inputs[i].stem ();
+			output += "." + format;
+			try
+			{
+				processFile (inputs[i].string (), output.string (), operations, archiveBits, 1); // Parallelism is across files
+			}
+			catch (std::exception & e)
+			{
+				std::lock_guard<std::mutex> lock (logMutex);
+				std::cerr << "> [Error processing " << inputs[i].string () << "]" << e.what () << std::endl;
+				numFailures++;
+			}
+		}
+	};
+	numThreads = std::max (1u, std::min (numThreads, static_cast<unsigned int> (inputs.size ())));
+	std::vector<std::thread> threads;
+	for (unsigned int k = 0; k < numThreads; k++)
+		threads.emplace_back (worker);
+	for (auto & thread : threads)
+		thread.join ();
+	std::cout << " > " << inputs.size () - numFailures << " of " << inputs.size () << " mesh files processed with " << numThreads << " thread(s)" << std::endl;
+	return numFailures;
+}
+
+bool isImageFile (const fs::path & path)
+{
+	std::string extension = path.extension ().string ();
+	std::transform (extension.begin (), extension.end (), extension.begin (), [] (unsigned char c) { return std::tolower (c); });
+	return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+/// Writes the compressed version of an image, blocks being compressed with numThreads threads
+void compressTexture (const TextureImage & image, bool preferBC1, unsigned int numThreads)
+{
+	auto start = std::chrono::high_resolution_clock::now ();
+	if (image.isEmpty ())
+		throw std::ios_base::failure ("[Tool][compressTexture] Cannot decode " + image.filename ());
+	TextureCompressor::Format format = TextureCompressor::chooseFormat (image.numComponents (), preferBC1);
+	TextureCompressor::CompressedTexture texture;
+	if (image.numLevels () == 1)
+		texture = TextureCompressor::compress (static_cast<const uint8_t *> (image.data ()), image.width (), image.height (),
+											   image.numComponents (), format, numThreads);
+	else // Mip chain of its own, e.g. renormalized normals, quantized to 8 bits as the blocks are
+	{
+		std::vector<std::vector<uint8_t>> levels (image.numLevels ());
+		for (int level = 0, w = image.width (), h = image.height (); level < image.numLevels (); level++, w = std::max (1, w / 2), h = std::max (1, h / 2))
+		{
+			size_t numValues = size_t (w) * h * image.numComponents ();
+			if (image.bytesPerChannel () == 1)
+			{
+				const uint8_t * values = static_cast<const uint8_t *> (image.levelData (level));
+				levels[level].assign (values, values + numValues);
+			}
+			else
+			{
+				const uint16_t * values = static_cast<const uint16_t *> (image.levelData (level));
+				levels[level].resize (numValues);
+				for (size_t i = 0; i < numValues; i++)
+					levels[level][i] = static_cast<uint8_t> ((uint32_t (values[i]) * 255 + 32767) / 65535);
+			}
+		}
+		texture = TextureCompressor::compress (levels, image.width (), image.height (), image.numComponents (), format, numThreads);
+	}
+	std::string output = TextureCompressor::compressedFilename (image.filename ());
+	TextureCompressor::save (output, texture);
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	static const char * formatNames[] = { "BC1", "BC4", "BC5", "BC7" };
+	const char * formatName = formatNames[format == TextureCompressor::BC1 ? 0 : format == TextureCompressor::BC4 ? 1 : format == TextureCompressor::BC5 ? 2 : 3];
+	size_t rawBytes = size_t (image.width ()) * image.height () * 4 * 4 / 3; // RGBA8 with mipmaps
+	std::cout << " > Texture <" << output << "> written: " << image.width () << "x" << image.height () << " " << formatName << ", "
+			  << texture.levels.size () << " levels, " << texture.bytes () / 1024.0 << " KB in " << seconds * 1000.0 << " ms ("
+			  << double (rawBytes) / texture.bytes () << "x smaller than RGBA8)" << std::endl;
+}
+
+int compressTextures (int argc, char ** argv)
+{
+	unsigned int numThreads = std::max (std::thread::hardware_concurrency (), 1u);
+	bool preferBC1 = false;
+	bool force = false;
+	std::vector<fs::path> inputs;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--threads" && i + 1 < argc)
+			numThreads = parseThreads (argv[++i], argv[0]);
+		else if (argument == "--bc1")
+			preferBC1 = true;
+		else if (argument == "--force")
+			force = true;
+		else if (fs::is_directory (argument))
+		{
+			for (const auto & entry : fs::recursive_directory_iterator (argument))
+				if (entry.is_regular_file () && isImageFile (entry.path ()))
+					inputs.push_back (entry.path ());
+		}
+		else
+			inputs.push_back (argument);
+	}
+	if (inputs.empty ())
+		usage (argv[0]);
+	std::sort (inputs.begin (), inputs.end ());
+
+	// The occlusion, roughness and metallic maps of a material directory are packed into one texture
+	// instead of being compressed each: the runtime only reads the packed one
+	auto isORMSource = [] (const fs::path & input) {
+		for (const std::string & source : ormSources (input.parent_path ().string () + "/"))
+			if (fs::path (source).filename () == input.filename ())
+				return true;
+		return false;
+	};
+	std::vector<std::string> materialDirectories;
+	for (const fs::path & input : inputs)
+	{
+		std::string directory = input.parent_path ().string () + "/";
+		if (isORMSource (input) && std::find (materialDirectories.begin (), materialDirectories.end (), directory) == materialDirectories.end ())
+			materialDirectories.push_back (directory);
+	}
+	inputs.erase (std::remove_if (inputs.begin (), inputs.end (), isORMSource), inputs.end ());
+	size_t numImages = inputs.size ();
+	for (const std::string & directory : materialDirectories)
+		inputs.push_back (ormFilename (directory));
+
+	auto start = std::chrono::high_resolution_clock::now ();
+	size_t numFailures = 0, numSkipped = 0;
+	for (size_t i = 0; i < inputs.size (); i++)
+	{
+		const fs::path & input = inputs[i];
+		bool isPacked = (i >= numImages);
+		std::vector<std::string> sources = isPacked ? ormSources (materialDirectories[i - numImages]) : std::vector<std::string> ();
+		if (!force && TextureCompressor::hasUpToDateCompressedVersion (input.string (), sources))
+		{
+			numSkipped++;
+			continue;
+		}
+		try
+		{
+			if (isPacked)
+				compressTexture (*packChannels (input.string (), sources, ormDefaults (), false), preferBC1, numThreads);
+			else if (input.filename () == fs::path (normalMapFilename ("")).filename ())
+				compressTexture (*loadNormalMap (input.string (), false), preferBC1, numThreads);
+			else
+				compressTexture (TextureImage (input.string (), false, false), preferBC1, numThreads);
+		}
+		catch (std::exception & e)
+		{
+			std::cerr << "> [Error compressing " << input.string () << "]" << e.what () << std::endl;
+			numFailures++;
+		}
+	}
+	double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+	std::cout << " > " << inputs.size () - numSkipped - numFailures << " texture(s) compressed, " << numSkipped << " up to date, "
+			  << numFailures << " failed, in " << seconds << " s" << std::endl;
+	return numFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/// Runs the out-of-core simplification, the mesh never being loaded as a whole
+int simplifyOutOfCore (int argc, char ** argv)
+{
+	if (argc < 4 || argc > 6)
+		usage (argv[0]);
+	try
+	{
+		unsigned int resolution = static_cast<unsigned int> (argc > 4 ? parsePositive (argv[4], "resolution") : 256);
+		size_t memoryBudget = size_t (argc > 5 ? parsePositive (argv[5], "memory budget") : 512) * 1024 * 1024;
+		OutOfCoreSimplifier::simplify (argv[2], argv[3], resolution, memoryBudget);
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "> [Critical error]" << e.what () << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+int main (int argc, char ** argv)
+{
+	if (argc > 1 && std::string (argv[1]) == "--compress-textures")
+		return compressTextures (argc, argv);
+	if (argc > 1 && std::string (argv[1]) == "--simplify-out-of-core")
+		return simplifyOutOfCore (argc, argv);
+
+	unsigned int numThreads = std::max (std::thread::hardware_concurrency (), 1u);
+	std::string format = "off";
+	std::string traceFilename;
+	ArchiveBits archiveBits;
+	std::vector<std::string> arguments;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--threads" && i + 1 < argc)
+			numThreads = parseThreads (argv[++i], argv[0]);
+		else if (argument == "--format" && i + 1 < argc)
+			format = argv[++i];
+		else if (argument == "--position-bits" && i + 1 < argc)
+			archiveBits.position = parseOption (argv[++i], "number of position bits", 24, argv[0]);
+		else if (argument == "--normal-bits" && i + 1 < argc)
+			archiveBits.normal = parseOption (argv[++i], "number of normal bits", 16, argv[0]);
+		else if (argument == "--trace" && i + 1 < argc)
+			traceFilename = argv[++i];
+		else
+			arguments.push_back (argument);
+	}
+	if (arguments.size () < 2 || (format != "off" && format != "qmesh"))
+		usage (argv[0]);
+
+	int status = EXIT_FAILURE;
+	try
+	{
+		std::vector<Operation> operations;
+		for (size_t i = 2; i < arguments.size (); i++)
+			operations.push_back (parseOperation (arguments[i]));
+
+		Profiler::setThreadName ("Main");
+		Profiler::setEnabled (!traceFilename.empty ());
+		auto start = std::chrono::high_resolution_clock::now ();
+		size_t numFailures = 0;
+		if (fs::is_directory (arguments[0]))
+			numFailures = processDirectory (arguments[0], arguments[1], format, operations, archiveBits, numThreads);
+		else
+			processFile (arguments[0], arguments[1], operations, archiveBits, numThreads);
+		double seconds = std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+		std::cout << " > Done in " << seconds << " s" << std::endl;
+		status = numFailures ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "> [Critical error]" << e.what () << std::endl;
+	}
+
+	if (!traceFilename.empty ()) // Also after a failure, to see where the time went until then
+	{
+		try
+		{
+			Profiler::writeChromeTrace (traceFilename);
+			std::cout << " > CPU trace written to " << traceFilename << std::endl;
+		}
+		catch (std::exception & e)
+		{
+			std::cerr << "> [Error writing trace]" << e.what () << std::endl;
+			status = EXIT_FAILURE;
+		}
+	}
+	return status;
+}
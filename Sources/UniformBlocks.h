@@ -0,0 +1,78 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/// C++ mirrors of the std140 uniform blocks and std430 storage buffers declared in the shaders, along
+/// with their binding points. Any change here must be made to the declarations in VertexShader.glsl
+/// and FragmentShader.glsl.
+namespace UniformBlocks {
+
+/// Binding points, from the layout (std140, binding = ...) qualifiers of the blocks
+enum Binding : unsigned int {
+	FRAME_BINDING = 0,
+	MATERIAL_BINDING = 1
+};
+
+/// Binding points of the storage buffers, from their layout (std430, binding = ...) qualifiers
+enum StorageBinding : unsigned int {
+	LIGHTS_BINDING = 0,
+	CLUSTERS_BINDING = 1,
+	CLUSTER_LIGHT_INDICES_BINDING = 2,
+	LIGHT_POSITIONS_BINDING = 3
+};
+
+/// Matrices and camera of a render pass: block Frame
+struct FrameBlock {
+	glm::mat4 projectionMat;
+	glm::mat4 modelViewMat;
+	glm::mat4 normalMat;
+	glm::mat4 modelViewMatFromLight;
+	glm::mat4 normalMatFromLight;
+	glm::vec4 meshCenterFromLight;
+	glm::vec3 meshCenter;
+	float fov;
+	float aspectRatio;
+	float clusterDepthScale; // See LightClusters::depthScale
+	float clusterDepthBias;
+	float padding0;
+	glm::uvec4 clusterCount; // Tiles along X and Y, then slices
+	glm::vec2 viewportSize; // In pixels
+	float padding1[2];
+	glm::vec3 environmentRadiance;
+	float padding2;
+};
+
+/// Element of storage buffer Lights, the LightSource struct of the shaders. Every vec3 is followed by
+/// a float filling its 16 byte slot.
+struct Light {
+	glm::vec3 color;
+	float intensity;
+	glm::vec3 distanceAttenuation;
+	float coneAngle;
+	glm::vec3 position; // In world space
+	float radialAttenuation;
+};
+
+/// Block MaterialBlock, named material in the shaders
+struct MaterialBlock {
+	glm::vec3 albedo;
+	float kd;
+	float metallic;
+	float roughness;
+	float padding[2];
+};
+
+// std140 and std430 offsets, checked against the layout the shaders expect
+static_assert (sizeof (glm::vec3) == 12 && sizeof (glm::mat4) == 64, "glm types must be tightly packed");
+static_assert (offsetof (FrameBlock, meshCenterFromLight) == 320 && offsetof (FrameBlock, fov) == 348
+			   && offsetof (FrameBlock, clusterCount) == 368 && offsetof (FrameBlock, viewportSize) == 384 && offsetof (FrameBlock, environmentRadiance) == 400 && sizeof (FrameBlock) == 416,
+			   "FrameBlock does not match the std140 layout of block Frame");
+static_assert (offsetof (Light, position) == 32 && sizeof (Light) == 48, "Light does not match the std430 layout of LightSource");
+static_assert (offsetof (MaterialBlock, roughness) == 20 && sizeof (MaterialBlock) == 32,
+			   "MaterialBlock does not match the std140 layout of block MaterialBlock");
+
+}
+
+#endif // UNIFORM_BLOCKS_H
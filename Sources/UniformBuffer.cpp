@@ -0,0 +1,57 @@
+#include "UniformBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+size_t UniformBuffer::s_uploadCounter = 0;
+
+UniformBuffer::UniformBuffer (GLuint binding, size_t blockSize, int numInstances) : m_binding (binding), m_blockSize (blockSize)
+{
+	GLint alignment = 256;
+	glGetIntegerv (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_stride = (blockSize + alignment - 1) / alignment * alignment;
+	m_data.assign (m_stride * numInstances, 0);
+	m_dirtyBegin = 0; // Uploaded at the first flush, zeros included
+	m_dirtyEnd = m_data.size ();
+	glCreateBuffers (1, &m_id);
+	glNamedBufferStorage (m_id, static_cast<GLsizeiptr> (m_data.size ()), m_data.data (), GL_DYNAMIC_STORAGE_BIT);
+}
+
+UniformBuffer::~UniformBuffer ()
+{
+	glDeleteBuffers (1, &m_id);
+}
+
+void UniformBuffer::setInstance (const void * data, size_t size, int instance)
+{
+	if (size != m_blockSize || instance < 0 || size_t (instance) * m_stride >= m_data.size ())
+		throw std::runtime_error ("[Uniform Buffer][set] Invalid block or instance");
+	uint8_t * contents = &m_data[size_t (instance) * m_stride];
+	if (std::memcmp (contents, data, size) == 0)
+		return;
+	std::memcpy (contents, data, size);
+	size_t begin = size_t (instance) * m_stride;
+	m_dirtyBegin = std::min (m_dirtyBegin, begin);
+	m_dirtyEnd = std::max (m_dirtyEnd, begin + size);
+}
+
+void UniformBuffer::flush ()
+{
+	if (m_dirtyBegin >= m_dirtyEnd)
+		return;
+	glNamedBufferSubData (m_id, static_cast<GLintptr> (m_dirtyBegin), static_cast<GLsizeiptr> (m_dirtyEnd - m_dirtyBegin), &m_data[m_dirtyBegin]);
+	s_uploadCounter++;
+	m_dirtyBegin = m_data.size ();
+	m_dirtyEnd = 0;
+}
+
+void UniformBuffer::bind (int instance)
+{
+	if (instance == m_boundInstance)
+		return;
+	glBindBufferRange (GL_UNIFORM_BUFFER, m_binding, m_id, static_cast<GLintptr> (size_t (instance) * m_stride), static_cast<GLsizeiptr> (m_blockSize));
+	m_boundInstance = instance;
+}
@@ -0,0 +1,59 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+/// GL buffer backing a std140 uniform block (see UniformBlocks.h). It is bound to the binding point
+/// the shaders declare for the block, so every program declaring the block reads the same data and
+/// switching programs uploads nothing. The buffer may hold several instances of the block, e.g. one
+/// per render pass, bound in turn. Instances are compared with their previous contents on the CPU:
+/// only the ones that changed are uploaded, with a single glNamedBufferSubData per flush. Must be used
+/// from the thread owning the GL context.
+class UniformBuffer {
+public:
+	UniformBuffer (GLuint binding, size_t blockSize, int numInstances = 1);
+
+	virtual ~UniformBuffer ();
+
+	UniformBuffer (const UniformBuffer &) = delete;
+	UniformBuffer & operator= (const UniformBuffer &) = delete;
+
+	/// Replaces the contents of an instance on the CPU, marking it dirty if they differ
+	template<typename Block>
+	inline void set (const Block & block, int instance = 0) {
+		static_assert (std::is_trivially_copyable<Block>::value, "Uniform blocks are copied as bytes");
+		setInstance (&block, sizeof (Block), instance);
+	}
+
+	/// Uploads the dirty instances, if any
+	void flush ();
+
+	/// Binds an instance to the binding point of the block
+	void bind (int instance = 0);
+
+	/// Number of glNamedBufferSubData issued by every uniform buffer since the last resetUploadCounter
+	static inline size_t uploadCounter () { return s_uploadCounter; }
+
+	static inline void resetUploadCounter () { s_uploadCounter = 0; }
+
+private:
+	void setInstance (const void * data, size_t size, int instance);
+
+	GLuint m_id = 0;
+	GLuint m_binding;
+	size_t m_blockSize;
+	size_t m_stride; // Block size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	std::vector<uint8_t> m_data;
+	size_t m_dirtyBegin;
+	size_t m_dirtyEnd;
+	int m_boundInstance = -1;
+
+	static size_t s_uploadCounter;
+};
+
+#endif // UNIFORM_BUFFER_H